@@ -0,0 +1,98 @@
+// Throughput benchmark for BeatClassifier.
+//
+// Runs simulated ECG (see EcgSimulator) through the front-end filter and the
+// QRS detector to collect beat windows, then times their classification.
+// Reports beats per second and how many real-time streams one core could
+// classify at the scenario's heart rate. The class counts are printed too,
+// so a speed-up that breaks classification does not go unnoticed: the "pvc"
+// scenario has about one ventricular beat in nine, "normal" has none.
+//
+// Usage: beatclassifier_benchmark [seconds-of-signal] [sample-rate] [repetitions]
+
+#include "beatclassifier.h"
+#include "ecgfilter.h"
+#include "ecgsimulator.h"
+#include "qrsdetector.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+std::vector<BeatWindow> collectBeats(EcgSimulator::Rhythm rhythm, double seconds, double sampleRate)
+{
+    constexpr std::size_t BLOCK_SIZE = 256;
+
+    EcgSimulator simulator(sampleRate);
+    simulator.setRhythm(rhythm);
+    simulator.reset(0);
+    EcgFrontEndFilter filter(sampleRate);
+    QrsDetector detector(sampleRate);
+    BeatWindowExtractor extractor(sampleRate);
+
+    std::vector<BeatWindow> windows;
+    std::vector<EcgSample> samples(BLOCK_SIZE);
+    std::vector<double> block(BLOCK_SIZE);
+    std::vector<QrsDetector::Beat> beats(BLOCK_SIZE);
+    double lastBeatMs = -1.0;
+
+    const auto total = std::size_t(seconds * sampleRate);
+    for (std::size_t offset = 0; offset < total; offset += BLOCK_SIZE) {
+        const std::size_t count = std::min(BLOCK_SIZE, total - offset);
+        simulator.generate(samples.data(), count);
+        for (std::size_t i = 0; i < count; ++i) {
+            block[i] = samples[i].voltage;
+        }
+        filter.process(block.data(), count);
+        extractor.append(block.data(), count);
+
+        const std::size_t found = detector.processBlock(block.data(), count, beats.data(), beats.size());
+        for (std::size_t b = 0; b < found; ++b) {
+            const double timeMs = double(beats[b].sampleIndex) * 1000.0 / sampleRate;
+            extractor.addBeat(beats[b].sampleIndex, timeMs, lastBeatMs >= 0.0 ? timeMs - lastBeatMs : 0.0);
+            lastBeatMs = timeMs;
+        }
+        extractor.takeReady([&windows](const BeatWindow &window) { windows.push_back(window); });
+    }
+    return windows;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    const double seconds = argc > 1 ? std::atof(argv[1]) : 600.0;
+    const double sampleRate = argc > 2 ? std::atof(argv[2]) : 250.0;
+    const int repetitions = argc > 3 ? std::atoi(argv[3]) : 20;
+    const EcgSimulator::Rhythm rhythms[] = {EcgSimulator::NormalSinus, EcgSimulator::Pvc};
+
+    std::printf("signal:       %.0f s at %.0f Hz per scenario, best of %d\n", seconds, sampleRate, repetitions);
+    for (EcgSimulator::Rhythm rhythm : rhythms) {
+        const std::vector<BeatWindow> windows = collectBeats(rhythm, seconds, sampleRate);
+
+        BeatClassifier classifier;
+        double best = 0.0;
+        for (int rep = 0; rep < repetitions; ++rep) {
+            classifier.reset();
+            auto start = std::chrono::steady_clock::now();
+            for (const BeatWindow &window : windows) {
+                classifier.classify(window);
+            }
+            auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            best = std::max(best, double(windows.size()) / elapsed);
+        }
+
+        const BeatClassifier::Counts &counts = classifier.counts();
+        const double beatsPerSecond = double(windows.size()) / seconds;
+        std::printf("\nscenario:     %s (%zu beats)\n", EcgSimulator::rhythmName(rhythm), windows.size());
+        std::printf("throughput:   %.2f Mbeats/s\n", best / 1e6);
+        std::printf("streams:      %.0f real-time streams per core\n", best / std::max(beatsPerSecond, 1e-9));
+        std::printf("classes:      %llu normal, %llu PVC, %llu PAC, %llu unclassified, %d templates\n",
+                    static_cast<unsigned long long>(counts.normal), static_cast<unsigned long long>(counts.pvc),
+                    static_cast<unsigned long long>(counts.pac),
+                    static_cast<unsigned long long>(counts.beats - counts.normal - counts.pvc - counts.pac),
+                    classifier.templateCount());
+    }
+    return 0;
+}
@@ -0,0 +1,556 @@
+// Microbenchmarks for the per-sample hot paths, with machine-readable output.
+//
+// Each case runs realistic synthetic ECG (see syntheticecg.h) through one
+// stage and reports, as JSON, the mean cost per operation, heap allocations
+// per operation made on the measuring thread, and latency percentiles of
+// the per-block cost. Compare the output of two builds to catch regressions.
+//
+// Usage: hotpath_benchmark [seconds-of-signal] [sample-rate] [output.json]
+//
+// The database-backed cases use a throw-away database under Qt's test-mode
+// data location, never the application's own. A 1000 Hz stream is also
+// stored and read back; the exit status is 1 if it does not round-trip.
+
+#include "arrhythmiadetector.h"
+#include "beatdetector.h"
+#include "bluetoothmanager.h"
+#include "ecgdatamodel.h"
+#include "ecgexporter.h"
+#include "ecgframeparser.h"
+#include "ecgsegment.h"
+#include "ecgstoragewriter.h"
+#include "hmcontroller.h"
+#include "qrsdetector.h"
+#include "syntheticecg.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QThread>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// Allocation counting. On glibc malloc itself is interposed, which also
+// covers Qt containers (they bypass operator new); elsewhere only operator
+// new is counted. Counts are per thread so background workers do not leak
+// into a case's numbers.
+namespace {
+thread_local std::uint64_t t_allocations = 0;
+}
+
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *pointer, std::size_t size);
+
+void *malloc(std::size_t size)
+{
+    ++t_allocations;
+    return __libc_malloc(size);
+}
+
+void *calloc(std::size_t count, std::size_t size)
+{
+    ++t_allocations;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, std::size_t size)
+{
+    ++t_allocations;
+    return __libc_realloc(pointer, size);
+}
+}
+#else
+void *operator new(std::size_t size)
+{
+    ++t_allocations;
+    if (void *pointer = std::malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+#endif
+
+namespace {
+constexpr qsizetype BLOCK_SIZE = 256; // Samples per timed block, as drained from the ring
+constexpr int EXPORT_REPETITIONS = 5;
+volatile double s_sink; // Keeps results of otherwise unused work observable
+
+using Clock = std::chrono::steady_clock;
+
+// Collects the per-block cost of one case
+class CaseRecorder
+{
+public:
+    CaseRecorder(const char *name, const char *unit)
+        : m_name(name)
+        , m_unit(unit)
+        , m_operations(0)
+        , m_totalNs(0.0)
+        , m_startAllocations(t_allocations)
+        , m_ownAllocations(0)
+    {
+    }
+
+    template <typename Work>
+    void time(std::uint64_t operations, Work &&work)
+    {
+        auto start = Clock::now();
+        work();
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        record(operations, ns);
+    }
+
+    void record(std::uint64_t operations, double ns)
+    {
+        if (operations == 0) {
+            return;
+        }
+        m_operations += operations;
+        m_totalNs += ns;
+
+        // Our own bookkeeping is not the measured code's allocation
+        const std::uint64_t before = t_allocations;
+        m_perOperationNs.push_back(ns / double(operations));
+        m_ownAllocations += t_allocations - before;
+    }
+
+    QJsonObject finish()
+    {
+        const std::uint64_t allocations = t_allocations - m_startAllocations - m_ownAllocations;
+        std::sort(m_perOperationNs.begin(), m_perOperationNs.end());
+        auto percentile = [this](double p) {
+            if (m_perOperationNs.empty()) {
+                return 0.0;
+            }
+            std::size_t index = std::size_t(p * double(m_perOperationNs.size() - 1) + 0.5);
+            return m_perOperationNs[index];
+        };
+
+        QJsonObject result;
+        result["name"] = m_name;
+        result["unit"] = m_unit;
+        result["operations"] = double(m_operations);
+        result["nsPerOp"] = m_operations > 0 ? m_totalNs / double(m_operations) : 0.0;
+        result["allocationsPerOp"] = m_operations > 0 ? double(allocations) / double(m_operations) : 0.0;
+        result["p50Ns"] = percentile(0.50);
+        result["p90Ns"] = percentile(0.90);
+        result["p99Ns"] = percentile(0.99);
+        result["maxNs"] = percentile(1.0);
+
+        std::fprintf(stderr, "%-28s %10.1f ns/%-6s %8.3f allocs/%s\n", m_name, result["nsPerOp"].toDouble(),
+                     m_unit, result["allocationsPerOp"].toDouble(), m_unit);
+        return result;
+    }
+
+private:
+    const char *m_name;
+    const char *m_unit;
+    std::uint64_t m_operations;
+    double m_totalNs;
+    std::uint64_t m_startAllocations;
+    std::uint64_t m_ownAllocations;
+    std::vector<double> m_perOperationNs;
+};
+
+// Splits the signal into ring-sized blocks on a regular sample clock
+struct BlockSource {
+    const std::vector<double> &samples;
+    double startTime;
+    double samplePeriod;
+
+    template <typename Process>
+    void forEach(Process &&process) const
+    {
+        for (std::size_t offset = 0; offset < samples.size(); offset += BLOCK_SIZE) {
+            EcgSampleBlock block;
+            block.samples = samples.data() + offset;
+            block.count = qsizetype(std::min<std::size_t>(BLOCK_SIZE, samples.size() - offset));
+            block.startTime = startTime + double(offset) * samplePeriod;
+            block.samplePeriod = samplePeriod;
+            process(block);
+        }
+    }
+};
+
+QJsonObject benchmarkParse(const std::vector<double> &samples)
+{
+    // Device text protocol, one reading per line
+    std::vector<QByteArray> lines;
+    lines.reserve(samples.size());
+    for (double sample : samples) {
+        lines.push_back("ECG:" + QByteArray::number(sample, 'f', 4));
+    }
+
+    CaseRecorder recorder("parse_ecg_value", "sample");
+    double checksum = 0.0;
+    for (std::size_t offset = 0; offset < lines.size(); offset += BLOCK_SIZE) {
+        std::size_t end = std::min<std::size_t>(offset + BLOCK_SIZE, lines.size());
+        recorder.time(end - offset, [&] {
+            for (std::size_t i = offset; i < end; ++i) {
+                checksum += BluetoothManager::parseEcgValue(lines[i]);
+            }
+        });
+    }
+    s_sink = checksum;
+    return recorder.finish();
+}
+
+QJsonObject benchmarkTextStream(const std::vector<double> &samples)
+{
+    // The same lines as one received byte stream, parsed in place
+    QByteArray stream;
+    for (double sample : samples) {
+        stream += "ECG:" + QByteArray::number(sample, 'f', 4) + '\n';
+    }
+
+    EcgTextParser parser;
+    CaseRecorder recorder("parse_text_stream", "sample");
+    double checksum = 0.0;
+    const std::size_t chunk = std::size_t(stream.size()) / std::max<std::size_t>(1, samples.size() / std::size_t(BLOCK_SIZE));
+    for (std::size_t offset = 0; offset < std::size_t(stream.size()); offset += chunk) {
+        std::size_t size = std::min<std::size_t>(chunk, std::size_t(stream.size()) - offset);
+        std::size_t lines = 0;
+        auto start = std::chrono::steady_clock::now();
+        parser.feed(stream.constData() + offset, size, [&](const double *values, std::size_t) {
+            checksum += values[0];
+            ++lines;
+        });
+        recorder.record(lines, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+    }
+    s_sink = checksum;
+    return recorder.finish();
+}
+
+QJsonObject benchmarkBinaryFrames(const std::vector<double> &samples)
+{
+    // 3-lead int24 frames of 32 samples
+    constexpr std::size_t LEADS = 3;
+    constexpr std::size_t FRAME_SAMPLES = 32;
+    std::vector<std::uint8_t> stream;
+    std::vector<std::int32_t> frame(FRAME_SAMPLES * LEADS);
+    std::uint16_t sequence = 0;
+    for (std::size_t offset = 0; offset + FRAME_SAMPLES <= samples.size(); offset += FRAME_SAMPLES) {
+        for (std::size_t i = 0; i < FRAME_SAMPLES; ++i) {
+            for (std::size_t lead = 0; lead < LEADS; ++lead) {
+                frame[i * LEADS + lead] = std::int32_t(samples[offset + i] * 1e6 / double(lead + 1));
+            }
+        }
+        EcgFrameParser::encode(stream, sequence++, EcgFrame::Int24, LEADS, 1e-6f, frame.data(), FRAME_SAMPLES);
+    }
+
+    EcgFrameParser parser;
+    CaseRecorder recorder("parse_binary_frames", "sample");
+    double checksum = 0.0;
+    const std::size_t frameBytes = EcgFrameParser::HEADER_SIZE + FRAME_SAMPLES * LEADS * 3 + EcgFrameParser::CRC_SIZE;
+    // Reads that do not line up with frame boundaries, as from a socket
+    const std::size_t chunk = frameBytes * (std::size_t(BLOCK_SIZE) / FRAME_SAMPLES) + 7;
+    for (std::size_t offset = 0; offset < stream.size(); offset += chunk) {
+        std::size_t size = std::min(chunk, stream.size() - offset);
+        std::size_t parsed = 0;
+        auto start = std::chrono::steady_clock::now();
+        parser.feed(stream.data() + offset, size, [&](const EcgFrame &f) {
+            for (std::size_t i = 0; i < f.sampleCount; ++i) {
+                checksum += f.voltage(i, 0);
+            }
+            parsed += f.sampleCount;
+        });
+        recorder.record(parsed, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+    }
+    s_sink = checksum;
+    return recorder.finish();
+}
+
+QJsonObject benchmarkQrsDetector(const std::vector<double> &samples, double sampleRate)
+{
+    QrsDetector detector(sampleRate);
+    std::vector<QrsDetector::Beat> beats(BLOCK_SIZE);
+
+    CaseRecorder recorder("qrs_detector", "sample");
+    for (std::size_t offset = 0; offset < samples.size(); offset += BLOCK_SIZE) {
+        std::size_t count = std::min<std::size_t>(BLOCK_SIZE, samples.size() - offset);
+        recorder.time(count, [&] {
+            detector.processBlock(samples.data() + offset, count, beats.data(), beats.size());
+        });
+    }
+    return recorder.finish();
+}
+
+QJsonObject benchmarkBeatDetector(const BlockSource &source, double sampleRate, std::vector<BeatEvent> &beats)
+{
+    BeatDetector detector;
+    detector.setSampleRate(sampleRate);
+    QObject::connect(&detector, &BeatDetector::beatDetected,
+                     [&beats](const BeatEvent &beat) { beats.push_back(beat); });
+    beats.reserve(std::size_t(source.samples.size() / sampleRate * 4.0));
+
+    CaseRecorder recorder("beat_detector", "sample");
+    source.forEach([&](const EcgSampleBlock &block) {
+        recorder.time(std::uint64_t(block.count), [&] { detector.processBlock(block); });
+    });
+    return recorder.finish();
+}
+
+QJsonObject benchmarkArrhythmia(const std::vector<BeatEvent> &beats)
+{
+    // The analysis itself, as run on the detector's worker thread
+    ArrhythmiaWorker worker;
+
+    CaseRecorder recorder("arrhythmia_process_beat", "beat");
+    for (const BeatEvent &beat : beats) {
+        recorder.time(1, [&] { worker.addBeat(beat); });
+    }
+    return recorder.finish();
+}
+
+QJsonObject benchmarkArrhythmiaQueue(const BlockSource &source)
+{
+    // What a block costs the GUI thread: handing a copy to the worker
+    ArrhythmiaDetector detector;
+    detector.startMonitoring();
+
+    CaseRecorder recorder("arrhythmia_queue_block", "sample");
+    source.forEach([&](const EcgSampleBlock &block) {
+        recorder.time(std::uint64_t(block.count), [&] { detector.processBlock(block); });
+    });
+    QJsonObject result = recorder.finish();
+    detector.stopMonitoring();
+    return result;
+}
+
+QJsonObject benchmarkDataModel(const BlockSource &source)
+{
+    EcgDataModel model;
+
+    CaseRecorder recorder("data_model_add_readings", "sample");
+    source.forEach([&](const EcgSampleBlock &block) {
+        recorder.time(std::uint64_t(block.count), [&] { model.addReadings(block, 72); });
+    });
+    return recorder.finish();
+}
+
+QJsonObject benchmarkControllerBlock(HMController &controller, const BlockSource &source)
+{
+    CaseRecorder recorder("controller_process_block", "sample");
+    source.forEach([&](const EcgSampleBlock &block) {
+        recorder.time(std::uint64_t(block.count), [&] { controller.processBlock(block); });
+    });
+    return recorder.finish();
+}
+
+// Producer cost of saving samples, then the writer's end-to-end commit rate
+void benchmarkStorage(const QString &databasePath, const BlockSource &source, QJsonArray &results)
+{
+    QThread thread;
+    auto *writer = new EcgStorageWriter(databasePath);
+    writer->setQueueCapacity(int(source.samples.size()) + 1); // Measure cost, not drops
+    writer->moveToThread(&thread);
+    QObject::connect(&thread, &QThread::started, writer, &EcgStorageWriter::open);
+    QObject::connect(&thread, &QThread::finished, writer, &QObject::deleteLater);
+    thread.start();
+    QMetaObject::invokeMethod(writer, [] {}, Qt::BlockingQueuedConnection); // Wait for open()
+
+    CaseRecorder enqueue("storage_enqueue_block", "sample");
+    auto start = Clock::now();
+    source.forEach([&](const EcgSampleBlock &block) {
+        enqueue.time(std::uint64_t(block.count), [&] { writer->enqueueBlock(block, 1000.0 / source.samplePeriod, 72); });
+    });
+    results.append(enqueue.finish());
+
+    CaseRecorder commit("storage_commit", "sample");
+    QMetaObject::invokeMethod(writer, &EcgStorageWriter::close, Qt::BlockingQueuedConnection);
+    commit.record(writer->writtenSamples(), std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+    results.append(commit.finish());
+
+    thread.quit();
+    thread.wait();
+}
+
+// Not timed: a stream at another rate than the segment default must come
+// back from storage at its own rate, in whole one-second segments
+bool checkStorageRoundTrip(const QString &databasePath)
+{
+    constexpr double RATE = 1000.0;
+    constexpr qint64 SESSION_ID = 1000000;
+    constexpr double START_TIME = 1.8e12;
+    const SyntheticEcg ecg = generateEcg(10.0, RATE, 1.0);
+    const BlockSource source{ecg.samples, START_TIME, 1000.0 / RATE};
+
+    QThread thread;
+    auto *writer = new EcgStorageWriter(databasePath);
+    writer->setQueueCapacity(int(ecg.samples.size()) + 1);
+    writer->moveToThread(&thread);
+    QObject::connect(&thread, &QThread::started, writer, &EcgStorageWriter::open);
+    QObject::connect(&thread, &QThread::finished, writer, &QObject::deleteLater);
+    thread.start();
+    source.forEach([&](const EcgSampleBlock &block) { writer->enqueueBlock(block, RATE, 72, SESSION_ID); });
+    QMetaObject::invokeMethod(writer, &EcgStorageWriter::close, Qt::BlockingQueuedConnection);
+    thread.quit();
+    thread.wait();
+
+    bool ok = true;
+    {
+        QSqlDatabase database = QSqlDatabase::addDatabase("QSQLITE", "round_trip_check");
+        database.setDatabaseName(databasePath);
+        QSqlQuery query(database);
+        query.prepare(QString("SELECT %1 FROM ecg_segments WHERE session_id = ? ORDER BY start_time")
+                      .arg(EcgSegment::SELECT_COLUMNS));
+        query.addBindValue(SESSION_ID);
+
+        std::size_t position = 0;
+        int segments = 0;
+        double maxError = 0.0;
+        ok = database.open() && query.exec();
+        while (ok && query.next()) {
+            const EcgSegment segment = EcgSegment::fromQuery(query);
+            ok = segment.sampleRate == RATE
+                 && segment.startTime == quint64(qRound64(START_TIME + double(position) * 1000.0 / RATE))
+                 && position + std::size_t(segment.samples.size()) <= ecg.samples.size();
+            for (qsizetype i = 0; ok && i < segment.samples.size(); ++i) {
+                maxError = std::max(maxError, std::abs(segment.voltageAt(i) - ecg.samples[position + std::size_t(i)]));
+            }
+            position += std::size_t(segment.samples.size());
+            ++segments;
+        }
+        ok = ok && position == ecg.samples.size() && segments == 10
+             && maxError <= EcgSegmentBuilder::DEFAULT_SCALE / 2.0 + 1e-12;
+        if (!ok) {
+            std::fprintf(stderr, "storage round trip at %.0f Hz failed: %zu samples in %d segments, max error %g V\n",
+                         RATE, position, segments, maxError);
+        }
+    }
+    QSqlDatabase::removeDatabase("round_trip_check");
+    return ok;
+}
+
+void benchmarkExport(const QString &databasePath, std::uint64_t samples, QJsonArray &results)
+{
+    QTemporaryDir directory;
+    const char *formats[][2] = {
+        {"export_csv", "export.csv"},
+        {"export_edf", "export.edf"},
+        {"export_hmraw", "export.hmraw"},
+    };
+
+    for (const auto &format : formats) {
+        CaseRecorder recorder(format[0], "sample");
+        for (int rep = 0; rep < EXPORT_REPETITIONS; ++rep) {
+            EcgExportRequest request;
+            request.filePath = directory.filePath(format[1]);
+            request.databasePath = databasePath;
+
+            EcgExporter exporter(request);
+            bool success = false;
+            QObject::connect(&exporter, &EcgExporter::finished, [&success](bool ok, const QString &) { success = ok; });
+            recorder.time(samples, [&] { exporter.run(); });
+            if (!success) {
+                std::fprintf(stderr, "%s failed\n", format[0]);
+                break;
+            }
+        }
+        results.append(recorder.finish());
+    }
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("HeartMonitorBenchmark");
+    app.setOrganizationName("DevOnline");
+    QStandardPaths::setTestModeEnabled(true);
+
+    const QStringList arguments = app.arguments();
+    const double seconds = arguments.size() > 1 ? arguments.at(1).toDouble() : 600.0;
+    const double sampleRate = arguments.size() > 2 ? arguments.at(2).toDouble() : 250.0;
+    const QString outputPath = arguments.size() > 3 ? arguments.at(3) : QString();
+
+    // Start from an empty throw-away database
+    const QString dataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir(dataPath).removeRecursively();
+    const QString databasePath = dataPath + "/heartmonitor.db";
+
+    const SyntheticEcg ecg = generateEcg(seconds, sampleRate, 1.0);
+    const BlockSource source{ecg.samples, 1.7e12, 1000.0 / sampleRate};
+
+    QJsonArray results;
+    std::vector<BeatEvent> beats;
+    results.append(benchmarkParse(ecg.samples));
+    results.append(benchmarkTextStream(ecg.samples));
+    results.append(benchmarkBinaryFrames(ecg.samples));
+    results.append(benchmarkQrsDetector(ecg.samples, sampleRate));
+    results.append(benchmarkBeatDetector(source, sampleRate, beats));
+    results.append(benchmarkArrhythmia(beats));
+    results.append(benchmarkArrhythmiaQueue(source));
+    results.append(benchmarkDataModel(source));
+    {
+        // Creates the schema; its own device stays disconnected
+        HMController controller;
+        results.append(benchmarkControllerBlock(controller, source));
+    }
+    benchmarkStorage(databasePath, source, results);
+    benchmarkExport(databasePath, ecg.samples.size(), results);
+    const bool roundTripOk = checkStorageRoundTrip(databasePath);
+
+    QJsonObject report;
+    report["benchmark"] = "hotpaths";
+    report["qtVersion"] = qVersion();
+    report["sampleRate"] = sampleRate;
+    report["signalSeconds"] = seconds;
+    report["blockSize"] = double(BLOCK_SIZE);
+    report["results"] = results;
+    const QByteArray json = QJsonDocument(report).toJson();
+
+    if (outputPath.isEmpty()) {
+        std::fwrite(json.constData(), 1, std::size_t(json.size()), stdout);
+    } else {
+        QFile file(outputPath);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size()) {
+            std::fprintf(stderr, "Cannot write %s\n", qPrintable(outputPath));
+            return 1;
+        }
+    }
+
+    QDir(dataPath).removeRecursively();
+    return roundTripOk ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+// Scaling benchmark for EcgPipeline + PipelineScheduler.
+//
+// For 1, 2, 4, ... up to the requested number of streams, producer threads
+// push synthetic ECG into each stream's ring as fast as the rings accept it
+// and the scheduler's work-stealing pool processes them. Reports aggregate
+// throughput, per-stream scheduling latency (scheduled to run finished) and
+// the number of steals.
+//
+// Usage: pipeline_scaling_benchmark [max-streams] [seconds-per-stream] [worker-threads]
+
+#include "ecgpipeline.h"
+#include "pipelinescheduler.h"
+#include "syntheticecg.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr double SAMPLE_RATE = 250.0;
+constexpr std::size_t PUSH_CHUNK = 50;    // Samples per push burst (200 ms of signal)
+constexpr std::size_t SIGNAL_VARIANTS = 4;
+constexpr quint64 START_TIME_MS = 1700000000000ULL;
+
+struct RunResult {
+    double seconds = 0.0;
+    std::uint64_t samples = 0;
+    std::uint64_t beats = 0;
+    double meanLatencyUs = 0.0;
+    double maxLatencyUs = 0.0;
+    std::uint64_t steals = 0;
+};
+
+RunResult runStreams(int streamCount, const std::vector<SyntheticEcg> &signals, unsigned workerThreads)
+{
+    PipelineScheduler scheduler(workerThreads);
+    std::vector<std::unique_ptr<EcgPipeline>> pipelines;
+    for (int i = 0; i < streamCount; ++i) {
+        pipelines.push_back(std::make_unique<EcgPipeline>(i, SAMPLE_RATE));
+    }
+
+    const int producerCount = std::min(streamCount, 4);
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < producerCount; ++p) {
+        producers.emplace_back([&, p] {
+            std::vector<std::size_t> positions(pipelines.size(), 0);
+            bool remaining = true;
+            while (remaining) {
+                remaining = false;
+                for (std::size_t s = std::size_t(p); s < pipelines.size(); s += std::size_t(producerCount)) {
+                    const std::vector<double> &samples = signals[s % signals.size()].samples;
+                    std::size_t &position = positions[s];
+                    std::size_t end = std::min(position + PUSH_CHUNK, samples.size());
+                    EcgSampleRing &ring = pipelines[s]->ring();
+                    while (position < end) {
+                        EcgSample sample{samples[position], START_TIME_MS + position * 4, 0, position};
+                        if (!ring.push(sample)) {
+                            break; // Full: come back after the other streams
+                        }
+                        ++position;
+                    }
+                    scheduler.notify(pipelines[s].get());
+                    remaining = remaining || position < samples.size();
+                }
+            }
+        });
+    }
+    for (std::thread &producer : producers) {
+        producer.join();
+    }
+
+    // A full ring drops nothing here (the producer retries), so every
+    // sample has been pushed; wait until the pool has processed them
+    for (;;) {
+        scheduler.waitForIdle();
+        bool drained = true;
+        for (const auto &pipeline : pipelines) {
+            if (pipeline->ring().size() > 0) {
+                scheduler.schedule(pipeline.get());
+                drained = false;
+            }
+        }
+        if (drained) {
+            break;
+        }
+    }
+
+    RunResult result;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (const auto &pipeline : pipelines) {
+        EcgPipeline::Statistics stats = pipeline->statistics();
+        result.samples += stats.samples;
+        result.beats += stats.beats;
+        result.meanLatencyUs += stats.meanLatencyUs / streamCount;
+        result.maxLatencyUs = std::max(result.maxLatencyUs, stats.maxLatencyUs);
+    }
+    result.steals = scheduler.stealCount();
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const int maxStreams = argc > 1 ? std::atoi(argv[1]) : 64;
+    const double seconds = argc > 2 ? std::atof(argv[2]) : 120.0;
+    const unsigned workerThreads = argc > 3 ? unsigned(std::atoi(argv[3])) : 0;
+
+    std::vector<SyntheticEcg> signals;
+    for (std::size_t i = 0; i < SIGNAL_VARIANTS; ++i) {
+        signals.push_back(generateEcg(seconds, SAMPLE_RATE, 1.0, unsigned(42 + i)));
+    }
+
+    unsigned threads = workerThreads > 0 ? workerThreads : std::max(1u, std::thread::hardware_concurrency());
+    std::printf("%u worker threads, %.0f s of %.0f Hz signal per stream\n\n", threads, seconds, SAMPLE_RATE);
+    std::printf("%8s %14s %12s %14s %14s %10s %8s\n",
+                "streams", "Msamples/s", "realtime", "mean lat us", "max lat us", "beats", "steals");
+
+    for (int streams = 1; streams <= maxStreams; streams *= 2) {
+        RunResult result = runStreams(streams, signals, workerThreads);
+        double throughput = result.samples / result.seconds;
+        std::printf("%8d %14.2f %11.0fx %14.1f %14.1f %10llu %8llu\n",
+                    streams, throughput / 1e6, throughput / (SAMPLE_RATE * streams),
+                    result.meanLatencyUs, result.maxLatencyUs,
+                    (unsigned long long)result.beats, (unsigned long long)result.steals);
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+// Throughput benchmark for QrsDetector.
+//
+// Runs a synthetic ECG (see syntheticecg.h) through the detector several
+// times and reports samples per second. Detection against the known R peaks
+// is reported too so a speed-up that breaks the detector does not go unnoticed.
+//
+// Usage: qrsdetector_benchmark [seconds-of-signal] [sample-rate] [repetitions]
+
+#include "qrsdetector.h"
+#include "syntheticecg.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+int main(int argc, char *argv[])
+{
+    const double seconds = argc > 1 ? std::atof(argv[1]) : 600.0;
+    const double sampleRate = argc > 2 ? std::atof(argv[2]) : 250.0;
+    const int repetitions = argc > 3 ? std::atoi(argv[3]) : 20;
+    constexpr std::size_t BLOCK_SIZE = 256;
+
+    // Low-amplitude lead (0.2 mV R waves) to exercise the adaptive thresholds
+    const SyntheticEcg ecg = generateEcg(seconds, sampleRate, 0.2);
+
+    QrsDetector detector(sampleRate);
+    std::vector<QrsDetector::Beat> beats(BLOCK_SIZE);
+    std::vector<std::uint64_t> detected;
+    double best = 0.0;
+
+    for (int rep = 0; rep < repetitions; ++rep) {
+        detector.reset(sampleRate);
+        detected.clear();
+
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t offset = 0; offset < ecg.samples.size(); offset += BLOCK_SIZE) {
+            std::size_t count = std::min(BLOCK_SIZE, ecg.samples.size() - offset);
+            std::size_t found = detector.processBlock(ecg.samples.data() + offset, count, beats.data(), beats.size());
+            for (std::size_t i = 0; i < found; ++i) {
+                detected.push_back(beats[i].sampleIndex);
+            }
+        }
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::max(best, ecg.samples.size() / elapsed);
+    }
+
+    // Match detections to reference beats within 50 ms, ignoring the learning phase
+    const auto tolerance = std::uint64_t(0.05 * sampleRate);
+    const auto learning = std::uint64_t(2.5 * sampleRate);
+    std::size_t truePositives = 0;
+    std::size_t reference = 0;
+    std::size_t d = 0;
+    double offsetSum = 0.0;
+    for (std::uint64_t r : ecg.rPeaks) {
+        if (r < learning) {
+            continue;
+        }
+        ++reference;
+        while (d < detected.size() && detected[d] + tolerance < r) {
+            ++d;
+        }
+        if (d < detected.size() && detected[d] <= r + tolerance) {
+            offsetSum += double(detected[d]) - double(r);
+            ++truePositives;
+            ++d;
+        }
+    }
+    std::size_t detectedAfterLearning = 0;
+    for (std::uint64_t index : detected) {
+        detectedAfterLearning += index >= learning - tolerance ? 1 : 0;
+    }
+
+    std::printf("signal:       %.0f s at %.0f Hz (%zu samples)\n", seconds, sampleRate, ecg.samples.size());
+    std::printf("throughput:   %.1f Msamples/s (best of %d)\n", best / 1e6, repetitions);
+    std::printf("realtime:     %.0fx\n", best / sampleRate);
+    std::printf("sensitivity:  %.2f %% (%zu/%zu)\n", 100.0 * truePositives / std::max<std::size_t>(1, reference),
+                truePositives, reference);
+    std::printf("precision:    %.2f %%\n", 100.0 * truePositives / std::max<std::size_t>(1, detectedAfterLearning));
+    std::printf("mean offset:  %.2f samples\n", offsetSum / std::max<std::size_t>(1, truePositives));
+    return 0;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+// Deterministic synthetic ECG shared by the benchmarks: Gaussian P/QRS/T
+// waves, RR variability, baseline wander and noise, with the true R-peak
+// positions for checking detection.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+struct SyntheticEcg {
+    std::vector<double> samples;
+    std::vector<std::uint64_t> rPeaks;
+};
+
+inline double syntheticGaussian(double t, double centre, double width)
+{
+    double x = (t - centre) / width;
+    return std::exp(-0.5 * x * x);
+}
+
+inline SyntheticEcg generateEcg(double seconds, double sampleRate, double amplitude, unsigned seed = 42)
+{
+    constexpr double PI = 3.14159265358979323846;
+
+    std::mt19937 random(seed);
+    std::normal_distribution<double> noise(0.0, 0.02 * amplitude);
+    std::normal_distribution<double> rrJitter(0.0, 0.04);
+
+    SyntheticEcg ecg;
+    const std::size_t count = std::size_t(seconds * sampleRate);
+    ecg.samples.resize(count);
+
+    // Beat onsets with RR intervals around 0.8 s
+    std::vector<double> beatTimes;
+    for (double t = 0.3; t < seconds + 1.0; t += 0.8 + rrJitter(random)) {
+        beatTimes.push_back(t);
+    }
+
+    std::size_t beat = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        double t = i / sampleRate;
+        while (beat + 1 < beatTimes.size() && t > beatTimes[beat + 1] - 0.4) {
+            ++beat;
+        }
+
+        double value = 0.0;
+        for (std::size_t b = beat > 0 ? beat - 1 : 0; b <= beat + 1 && b < beatTimes.size(); ++b) {
+            double r = beatTimes[b];
+            value += 0.15 * syntheticGaussian(t, r - 0.16, 0.025); // P
+            value -= 0.10 * syntheticGaussian(t, r - 0.03, 0.008); // Q
+            value += 1.00 * syntheticGaussian(t, r, 0.010);        // R
+            value -= 0.25 * syntheticGaussian(t, r + 0.03, 0.010); // S
+            value += 0.35 * syntheticGaussian(t, r + 0.25, 0.045); // T
+        }
+        value *= amplitude;
+        value += 0.1 * amplitude * std::sin(2.0 * PI * 0.3 * t); // Baseline wander
+        ecg.samples[i] = value + noise(random);
+    }
+
+    for (double r : beatTimes) {
+        if (r < seconds) {
+            ecg.rPeaks.push_back(std::uint64_t(std::lround(r * sampleRate)));
+        }
+    }
+    return ecg;
+}
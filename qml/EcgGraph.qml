@@ -2,342 +2,169 @@ import QtQuick
 import QtQuick.Controls
 import QtQuick.Layouts
 import QtQml
+import HeartMonitor
 
 
-Canvas {
-    id: ecgCanvas
+Item {
+    id: ecgGraph
+    clip: true
     
-    property color backgroundColor: "#1e1e1e"
-    property color gridColor: "#555555"
-    property color signalColor: "#e74c3c"
-    property real signalWidth: 2.0
-    property real gridLineWidth: 0.5
+    property alias backgroundColor: waveform.backgroundColor
+    property alias gridColor: waveform.gridColor
+    property alias signalColor: waveform.signalColor
+    property alias signalWidth: waveform.signalWidth
+    property alias gridLineWidth: waveform.gridLineWidth
     
     // ECG data properties
-    property real timeWindow: 10000 // 10 seconds in milliseconds
-    property real voltageRange: 2.0 // -1V to +1V
-    property int maxDataPoints: 2500 // 250Hz * 10s
+    property alias timeWindow: waveform.timeWindow // 10 seconds in milliseconds
+    property alias voltageRange: waveform.voltageRange // -1V to +1V
+    property alias maxDataPoints: waveform.capacity // 1000Hz * 10s
+    property alias source: waveform.source // LiveWaveformBuffer, drained once per frame
     
-    // Internal data storage
-    property var ecgData: []
-    property var timeData: []
-    property real currentTime: 0
-    property bool isRunning: false
+    readonly property alias currentTime: waveform.currentTime
+    readonly property alias isRunning: waveform.running
     
     // Grid properties
-    property real majorGridInterval: 1000 // 1 second
-    property real minorGridInterval: 200  // 0.2 seconds
-    property real voltageGridInterval: 0.5 // 0.5V
+    property alias majorGridInterval: waveform.majorGridInterval // 1 second
+    property alias minorGridInterval: waveform.minorGridInterval // 0.2 seconds
+    property alias voltageGridInterval: waveform.voltageGridInterval // 0.5V
     
-    onPaint: {
-        var ctx = getContext("2d")
-        ctx.clearRect(0, 0, width, height)
-        
-        drawBackground(ctx)
-        drawGrid(ctx)
-        drawEcgSignal(ctx)
-        drawLabels(ctx)
-    }
+    readonly property color labelColor: Qt.lighter(gridColor, 2)
+    
+    // Emitted after each frame that shows live data (latency measurement)
+    signal framePainted()
     
+    // Single samples from script; live data should come through source
     function addDataPoint(voltage, timestamp) {
-        ecgData.push(voltage)
-        timeData.push(timestamp)
-        
-        // Keep only data within time window
-        var cutoffTime = timestamp - timeWindow
-        while (timeData.length > 0 && timeData[0] < cutoffTime) {
-            ecgData.shift()
-            timeData.shift()
-        }
-        
-        // Limit array size for performance
-        if (ecgData.length > maxDataPoints) {
-            ecgData.shift()
-            timeData.shift()
-        }
-        
-        currentTime = timestamp
-        isRunning = true
-        
-        // Request repaint
-        requestPaint()
+        waveform.addDataPoint(voltage, timestamp)
     }
     
     function clearData() {
-        ecgData = []
-        timeData = []
-        isRunning = false
-        requestPaint()
+        waveform.clearData()
     }
     
-    function drawBackground(ctx) {
-        ctx.fillStyle = backgroundColor
-        ctx.fillRect(0, 0, width, height)
+    function voltageToY(voltage) {
+        var normalized = (voltage + voltageRange/2) / voltageRange
+        return height * (1 - normalized) // Invert Y axis
     }
     
-    function drawGrid(ctx) {
-        if (!isRunning || timeData.length === 0) return
-        
-        ctx.strokeStyle = gridColor
-        ctx.lineWidth = gridLineWidth
-        ctx.setLineDash([])
-        
-        var latestTime = currentTime
-        var startTime = latestTime - timeWindow
-        
-        // Vertical grid lines (time)
-        var timeStep = minorGridInterval
-        var startTimeGrid = Math.floor(startTime / timeStep) * timeStep
-        
-        for (var t = startTimeGrid; t <= latestTime + timeStep; t += timeStep) {
-            if (t < startTime) continue
-            
-            var x = timeToX(t, startTime, latestTime)
-            if (x >= 0 && x <= width) {
-                ctx.beginPath()
-                ctx.moveTo(x, 0)
-                ctx.lineTo(x, height)
-                
-                // Major grid lines (every second)
-                if (Math.abs(t % majorGridInterval) < timeStep / 2) {
-                    ctx.strokeStyle = Qt.lighter(gridColor, 1.5)
-                    ctx.lineWidth = gridLineWidth * 2
-                } else {
-                    ctx.strokeStyle = gridColor
-                    ctx.lineWidth = gridLineWidth
-                }
-                
-                ctx.stroke()
-            }
-        }
-        
-        // Horizontal grid lines (voltage)
-        var voltageStep = voltageGridInterval / 2 // Minor grid
-        var minVoltage = -voltageRange / 2
-        var maxVoltage = voltageRange / 2
-        
-        for (var v = minVoltage; v <= maxVoltage; v += voltageStep) {
-            var y = voltageToY(v)
-            if (y >= 0 && y <= height) {
-                ctx.beginPath()
-                ctx.moveTo(0, y)
-                ctx.lineTo(width, y)
-                
-                // Major grid lines (every 0.5V)
-                if (Math.abs(v % voltageGridInterval) < 0.001) {
-                    ctx.strokeStyle = Qt.lighter(gridColor, 1.5)
-                    ctx.lineWidth = gridLineWidth * 2
-                } else {
-                    ctx.strokeStyle = gridColor
-                    ctx.lineWidth = gridLineWidth
-                }
-                
-                ctx.stroke()
-            }
-        }
-        
-        // Zero line
-        var zeroY = voltageToY(0)
-        ctx.beginPath()
-        ctx.moveTo(0, zeroY)
-        ctx.lineTo(width, zeroY)
-        ctx.strokeStyle = Qt.lighter(gridColor, 2)
-        ctx.lineWidth = gridLineWidth * 1.5
-        ctx.stroke()
+    EcgWaveform {
+        id: waveform
+        anchors.fill: parent
+        onFramePainted: ecgGraph.framePainted()
     }
     
-    function drawEcgSignal(ctx) {
-        if (ecgData.length < 2) return
-        
-        var latestTime = currentTime
-        var startTime = latestTime - timeWindow
-        
-        ctx.strokeStyle = signalColor
-        ctx.lineWidth = signalWidth
-        ctx.setLineDash([])
-        ctx.lineCap = "round"
-        ctx.lineJoin = "round"
-        
-        ctx.beginPath()
-        
-        var firstPoint = true
-        for (var i = 0; i < ecgData.length; i++) {
-            if (timeData[i] < startTime) continue
-            
-            var x = timeToX(timeData[i], startTime, latestTime)
-            var y = voltageToY(ecgData[i])
-            
-            if (firstPoint) {
-                ctx.moveTo(x, y)
-                firstPoint = false
-            } else {
-                ctx.lineTo(x, y)
-            }
+    // Voltage labels
+    Repeater {
+        model: Math.floor(voltageRange / voltageGridInterval + 1e-6) + 1
+        
+        Text {
+            property real voltage: -voltageRange / 2 + index * voltageGridInterval
+            visible: Math.abs(voltage) > 0.001 // Skip zero
+            x: 5
+            y: voltageToY(voltage) - 12
+            text: voltage.toFixed(1) + "V"
+            color: labelColor
+            font.family: "Arial"
+            font.pixelSize: 10
         }
-        
-        ctx.stroke()
-        
-        // Draw current point indicator
-        if (ecgData.length > 0) {
-            var lastX = timeToX(timeData[timeData.length - 1], startTime, latestTime)
-            var lastY = voltageToY(ecgData[ecgData.length - 1])
-            
-            ctx.beginPath()
-            ctx.arc(lastX, lastY, 3, 0, 2 * Math.PI)
-            ctx.fillStyle = signalColor
-            ctx.fill()
-            
-            // Pulsing effect
-            ctx.beginPath()
-            ctx.arc(lastX, lastY, 6, 0, 2 * Math.PI)
-            ctx.strokeStyle = signalColor
-            ctx.lineWidth = 1
-            ctx.globalAlpha = 0.5 * (1 + Math.sin(Date.now() / 200))
-            ctx.stroke()
-            ctx.globalAlpha = 1.0
+    }
+    
+    // Time labels, counted back from the newest sample at the right edge
+    Repeater {
+        model: isRunning ? Math.floor(timeWindow / majorGridInterval) + 1 : 0
+        
+        Text {
+            property real centerX: ecgGraph.width * (1 - index * majorGridInterval / timeWindow)
+            visible: centerX >= 30 && centerX <= ecgGraph.width - 30
+            x: centerX - width / 2
+            y: ecgGraph.height - 5 - height
+            text: Math.floor(index * majorGridInterval / 1000) + "s"
+            color: labelColor
+            font.family: "Arial"
+            font.pixelSize: 10
         }
     }
     
-    function drawLabels(ctx) {
-        ctx.fillStyle = Qt.lighter(gridColor, 2)
-        ctx.font = "10px Arial"
-        ctx.textAlign = "left"
-        ctx.textBaseline = "top"
-        
-        // Voltage labels
-        var minVoltage = -voltageRange / 2
-        var maxVoltage = voltageRange / 2
-        
-        for (var v = minVoltage; v <= maxVoltage; v += voltageGridInterval) {
-            var y = voltageToY(v)
-            if (Math.abs(v) > 0.001) { // Skip zero
-                ctx.fillText(v.toFixed(1) + "V", 5, y - 12)
-            }
+    // Title and info
+    Column {
+        x: 10
+        y: 10
+        spacing: 4
+        
+        Text {
+            text: "ECG Signal"
+            color: "#ffffff"
+            font.family: "Arial"
+            font.pixelSize: 12
         }
         
-        // Time labels
-        if (isRunning && timeData.length > 0) {
-            ctx.textAlign = "center"
-            ctx.textBaseline = "bottom"
-            
-            var latestTime = currentTime
-            var startTime = latestTime - timeWindow
-            
-            for (var t = startTime; t <= latestTime; t += majorGridInterval) {
-                var x = timeToX(t, startTime, latestTime)
-                if (x >= 30 && x <= width - 30) {
-                    var timeStr = Math.floor((latestTime - t) / 1000) + "s"
-                    ctx.fillText(timeStr, x, height - 5)
-                }
-            }
+        Text {
+            visible: isRunning
+            text: "Sweep: " + (timeWindow/1000) + "s | Range: ±" + (voltageRange/2) + "V"
+            color: "#ffffff"
+            font.family: "Arial"
+            font.pixelSize: 10
         }
         
-        // Title and info
-        ctx.textAlign = "left"
-        ctx.textBaseline = "top"
-        ctx.fillStyle = "#ffffff"
-        ctx.font = "12px Arial"
-        ctx.fillText("ECG Signal", 10, 10)
-        
-        if (isRunning) {
-            ctx.font = "10px Arial"
-            ctx.fillText("Sweep: " + (timeWindow/1000) + "s | Range: ±" + (voltageRange/2) + "V", 10, 30)
-            ctx.fillText("Samples: " + ecgData.length, 10, 45)
+        Text {
+            visible: isRunning
+            text: "Samples: " + waveform.sampleCount
+            color: "#ffffff"
+            font.family: "Arial"
+            font.pixelSize: 10
         }
     }
     
-    function timeToX(time, startTime, endTime) {
-        return width * (time - startTime) / (endTime - startTime)
-    }
-    
-    function voltageToY(voltage) {
-        var normalized = (voltage + voltageRange/2) / voltageRange
-        return height * (1 - normalized) // Invert Y axis
-    }
-    
-    // Animation for sweep effect when no data
-    Timer {
-        id: sweepTimer
-        interval: 100
-        running: !isRunning
-        repeat: true
-        property real sweepPosition: 0
-
-        onTriggered: {
-            sweepPosition += 0.02
-            if (sweepPosition > 1.0) {
-                sweepPosition = 0
-            }
-            // Draw sweep line
-            var ctx = ecgCanvas.getContext("2d")
-            if (ctx) {
-                ecgCanvas.requestPaint()
-                // Add sweep line
-                function addSweepLine() {
-                    var ctx2 = ecgCanvas.getContext("2d")
-                    ctx2.strokeStyle = Qt.rgba(0.2, 1.0, 0.2, 0.8)
-                    ctx2.lineWidth = 1
-                    ctx2.beginPath()
-                    var x = width * sweepPosition
-                    ctx2.moveTo(x, 0)
-                    ctx2.lineTo(x, height)
-                    ctx2.stroke()
-                }
-                addSweepLine()
-            }
+    // Sweep line when no data
+    Rectangle {
+        id: sweepLine
+        visible: !isRunning
+        width: 1
+        height: parent.height
+        color: Qt.rgba(0.2, 1.0, 0.2, 0.8)
+        
+        NumberAnimation on x {
+            from: 0
+            to: ecgGraph.width
+            duration: 5000
+            loops: Animation.Infinite
+            running: sweepLine.visible
         }
     }
     
     // Mouse interaction for measurements
     MouseArea {
+        id: measureArea
         anchors.fill: parent
         hoverEnabled: true
         
-        property point lastMousePos: Qt.point(0, 0)
-        property bool measuring: false
+        property bool measuring: pressed
         
-        onPressed: {
-            measuring = true
-            lastMousePos = Qt.point(mouse.x, mouse.y)
+        Rectangle {
+            visible: measureArea.measuring
+            x: measureArea.mouseX
+            width: 1
+            height: parent.height
+            color: "#ffff00"
         }
         
-        onReleased: {
-            measuring = false
-            ecgCanvas.requestPaint()
+        Rectangle {
+            visible: measureArea.measuring
+            y: measureArea.mouseY
+            width: parent.width
+            height: 1
+            color: "#ffff00"
         }
         
-        onPositionChanged: {
-            if (measuring) {
-                // Draw measurement line
-                var ctx = ecgCanvas.getContext("2d")
-                ecgCanvas.requestPaint()
-                
-                // Add measurement overlay
-                Timer.singleShot(1, function() {
-                    var ctx2 = ecgCanvas.getContext("2d")
-                    ctx2.strokeStyle = "#ffff00"
-                    ctx2.lineWidth = 1
-                    ctx2.setLineDash([5, 5])
-                    
-                    // Vertical measurement line
-                    ctx2.beginPath()
-                    ctx2.moveTo(mouse.x, 0)
-                    ctx2.lineTo(mouse.x, height)
-                    ctx2.stroke()
-                    
-                    // Horizontal measurement line
-                    ctx2.beginPath()
-                    ctx2.moveTo(0, mouse.y)
-                    ctx2.lineTo(width, mouse.y)
-                    ctx2.stroke()
-                    
-                    // Measurement text
-                    var voltage = (height - mouse.y) / height * voltageRange - voltageRange/2
-                    ctx2.fillStyle = "#ffff00"
-                    ctx2.font = "10px Arial"
-                    ctx2.fillText(voltage.toFixed(3) + "V", mouse.x + 5, mouse.y - 15)
-                })
-            }
+        Text {
+            visible: measureArea.measuring
+            x: measureArea.mouseX + 5
+            y: measureArea.mouseY - 15
+            text: ((ecgGraph.height - measureArea.mouseY) / ecgGraph.height * voltageRange - voltageRange/2).toFixed(3) + "V"
+            color: "#ffff00"
+            font.family: "Arial"
+            font.pixelSize: 10
         }
     }
-}
\ No newline at end of file
+}
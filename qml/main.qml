@@ -241,9 +241,34 @@ ApplicationWindow {
                         spacing: 10
                         
                         Button {
-                            text: "Export Data"
+                            text: hmController.isExporting ? "Cancel Export" : "Export Data"
                             Layout.fillWidth: true
-                            onClicked: exportDialog.open()
+                            onClicked: {
+                                if (hmController.isExporting) {
+                                    hmController.cancelExport()
+                                } else {
+                                    exportDialog.open()
+                                }
+                            }
+                        }
+                        
+                        ProgressBar {
+                            Layout.fillWidth: true
+                            visible: hmController.isExporting
+                            value: hmController.exportProgress
+                        }
+                        
+                        Button {
+                            text: "Import Data"
+                            Layout.fillWidth: true
+                            enabled: !hmController.isImporting
+                            onClicked: importDialog.open()
+                        }
+                        
+                        ProgressBar {
+                            Layout.fillWidth: true
+                            visible: hmController.isImporting
+                            value: hmController.importProgress
                         }
                         
                         Button {
@@ -292,12 +317,9 @@ ApplicationWindow {
                     gridColor: darkTheme ? "#555" : "#ddd"
                     signalColor: primaryColor
                     
-                    Connections {
-                        target: hmController
-                        function onNewEcgData(voltage, timestamp) {
-                            ecgGraph.addDataPoint(voltage, timestamp)
-                        }
-                    }
+                    source: hmController.liveWaveform
+                    
+                    onFramePainted: hmController.reportFramePainted()
                 }
             }
         }
@@ -481,7 +503,7 @@ ApplicationWindow {
             spacing: 20
             
             Text {
-                text: "Export historical ECG data to CSV file"
+                text: "Export historical ECG data to CSV, EDF+ (.edf) or raw binary (.hmraw) file"
                 color: textColor
                 wrapMode: Text.WordWrap
                 Layout.fillWidth: true
@@ -514,6 +536,57 @@ ApplicationWindow {
         }
     }
     
+    Dialog {
+        id: importDialog
+        title: "Import ECG Data"
+        modal: true
+        anchors.centerIn: parent
+        width: 400
+        height: 200
+        
+        background: Rectangle {
+            color: cardColor
+            border.color: darkTheme ? "#555" : "#ccc"
+            radius: 8
+        }
+        
+        ColumnLayout {
+            anchors.fill: parent
+            spacing: 20
+            
+            Text {
+                text: "Import an EDF+ (.edf) or raw binary (.hmraw) recording"
+                color: textColor
+                wrapMode: Text.WordWrap
+                Layout.fillWidth: true
+            }
+            
+            TextField {
+                id: importPathField
+                placeholderText: "Enter file path (e.g., /path/to/ecg_data.edf)"
+                Layout.fillWidth: true
+            }
+            
+            Row {
+                Layout.alignment: Qt.AlignRight
+                spacing: 10
+                
+                Button {
+                    text: "Cancel"
+                    onClicked: importDialog.close()
+                }
+                
+                Button {
+                    text: "Import"
+                    onClicked: {
+                        hmController.importData("file://" + importPathField.text)
+                        importDialog.close()
+                    }
+                }
+            }
+        }
+    }
+    
     Dialog {
         id: clearDialog
         title: "Clear Historical Data"
@@ -567,6 +640,11 @@ ApplicationWindow {
             toastMessage.color = success ? "#27ae60" : "#e74c3c"
             toastAnimation.start()
         }
+        function onDataImported(success, message) {
+            toastMessage.text = message
+            toastMessage.color = success ? "#27ae60" : "#e74c3c"
+            toastAnimation.start()
+        }
     }
     
     Rectangle {
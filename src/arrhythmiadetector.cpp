@@ -1,28 +1,50 @@
 #include "arrhythmiadetector.h"
 #include <QDebug>
-#include <QtMath>
-#include <QRandomGenerator>
+#include <QThread>
 
 ArrhythmiaDetector::ArrhythmiaDetector(QObject* parent)
     : QObject(parent)
-    , m_peakThreshold(MIN_PEAK_HEIGHT)
-    , m_lastPeakTime(0)
-    , m_inRefractoryPeriod(false)
-    , m_averageRRInterval(0.0)
-    , m_rrVariability(0.0)
-    , m_currentRhythm("Normal Sinus Rhythm")
     , m_isMonitoring(false)
+    , m_mainsHz(EcgFrontEndFilter::DEFAULT_MAINS_HZ)
 {
     qRegisterMetaType<ArrhythmiaDetector>("ArrhythmiaDetector");
-    m_analysisTimer = new QTimer(this);
-    connect(m_analysisTimer, &QTimer::timeout, this, &ArrhythmiaDetector::analyzeRhythm);
-    m_analysisTimer->setInterval(5000); // Analyze every 5 seconds
+    
+    m_analysisThread = new QThread(this);
+    m_analysisThread->setObjectName("ArrhythmiaAnalysis");
+    m_worker = new ArrhythmiaWorker;
+    m_worker->moveToThread(m_analysisThread);
+    connect(m_analysisThread, &QThread::started, m_worker, &ArrhythmiaWorker::start);
+    connect(m_analysisThread, &QThread::finished, m_worker, &QObject::deleteLater);
+    connect(this, &ArrhythmiaDetector::blockAdded, m_worker, &ArrhythmiaWorker::processBlock);
+    connect(m_worker, &ArrhythmiaWorker::samplesFiltered, this, &ArrhythmiaDetector::samplesFiltered);
+    connect(m_worker, &ArrhythmiaWorker::resultReady, this, &ArrhythmiaDetector::onResultReady);
+    connect(m_worker, &ArrhythmiaWorker::arrhythmiaDetected, this, &ArrhythmiaDetector::arrhythmiaDetected);
+    
+    m_spectralThread = new QThread(this);
+    m_spectralThread->setObjectName("SpectralHrv");
+    m_spectralWorker = new SpectralHrvWorker;
+    m_spectralWorker->moveToThread(m_spectralThread);
+    connect(m_spectralThread, &QThread::started, m_spectralWorker, &SpectralHrvWorker::start);
+    connect(m_spectralThread, &QThread::finished, m_spectralWorker, &QObject::deleteLater);
+    connect(m_worker, &ArrhythmiaWorker::nnIntervalAdded, m_spectralWorker, &SpectralHrvWorker::addInterval);
+    connect(m_spectralWorker, &SpectralHrvWorker::spectrumUpdated, this, &ArrhythmiaDetector::onSpectrumUpdated);
+    
+    m_analysisThread->start();
+    m_spectralThread->start(QThread::LowPriority);
+}
+
+ArrhythmiaDetector::~ArrhythmiaDetector()
+{
+    m_analysisThread->quit();
+    m_spectralThread->quit();
+    m_analysisThread->wait();
+    m_spectralThread->wait();
 }
 
 void ArrhythmiaDetector::startMonitoring()
 {
     m_isMonitoring = true;
-    m_analysisTimer->start();
+    QMetaObject::invokeMethod(m_worker, &ArrhythmiaWorker::setMonitoring, true);
     emit monitoringChanged();
     qDebug() << "Arrhythmia monitoring started";
 }
@@ -30,195 +52,77 @@ void ArrhythmiaDetector::startMonitoring()
 void ArrhythmiaDetector::stopMonitoring()
 {
     m_isMonitoring = false;
-    m_analysisTimer->stop();
+    QMetaObject::invokeMethod(m_worker, &ArrhythmiaWorker::setMonitoring, false);
     emit monitoringChanged();
     qDebug() << "Arrhythmia monitoring stopped";
 }
 
 void ArrhythmiaDetector::resetAnalysis()
 {
-    m_voltageBuffer.clear();
-    m_timestampBuffer.clear();
-    m_rrIntervals.clear();
-    m_lastPeakTime = 0;
-    m_averageRRInterval = 0.0;
-    m_rrVariability = 0.0;
-    m_currentRhythm = "Normal Sinus Rhythm";
-    
-    emit rhythmChanged();
-    emit metricsChanged();
+    // The worker answers with an empty result
+    QMetaObject::invokeMethod(m_worker, &ArrhythmiaWorker::reset);
+    QMetaObject::invokeMethod(m_spectralWorker, &SpectralHrvWorker::reset);
 }
 
-void ArrhythmiaDetector::processEcgSample(double voltage, quint64 timestamp)
+void ArrhythmiaDetector::setSampleRate(double sampleRate)
 {
-    if (!m_isMonitoring) {
-        return;
-    }
-    
-    // Add to buffer
-    m_voltageBuffer.enqueue(voltage);
-    m_timestampBuffer.enqueue(timestamp);
-    
-    // Keep buffer size manageable
-    while (m_voltageBuffer.size() > BUFFER_SIZE) {
-        m_voltageBuffer.dequeue();
-        m_timestampBuffer.dequeue();
-    }
-    
-    // Detect R-peaks
-    detectRPeak(voltage, timestamp);
+    QMetaObject::invokeMethod(m_worker, &ArrhythmiaWorker::setSampleRate, sampleRate);
 }
 
-void ArrhythmiaDetector::detectRPeak(double voltage, quint64 timestamp)
+void ArrhythmiaDetector::setMainsFrequency(double hz)
 {
-    // Simple R-peak detection algorithm
-    if (m_voltageBuffer.size() < 3) {
-        return;
-    }
-    
-    // Check if we're in refractory period
-    if (m_inRefractoryPeriod && (timestamp - m_lastPeakTime) < REFRACTORY_PERIOD_MS) {
-        return;
-    }
-    m_inRefractoryPeriod = false;
-    
-    // Check if current sample is a local maximum above threshold
-    int bufferSize = m_voltageBuffer.size();
-    if (bufferSize >= 3) {
-        double prev = m_voltageBuffer.at(bufferSize - 2);
-        double current = m_voltageBuffer.at(bufferSize - 1);
-        double next = voltage;
-        
-        if (current > prev && current > next && current > m_peakThreshold) {
-            // Found R-peak
-            quint64 peakTime = m_timestampBuffer.at(bufferSize - 1);
-            calculateRRInterval(peakTime);
-            
-            m_lastPeakTime = peakTime;
-            m_inRefractoryPeriod = true;
-        }
-    }
+    m_mainsHz = hz;
+    QMetaObject::invokeMethod(m_worker, &ArrhythmiaWorker::setMainsFrequency, hz);
 }
 
-void ArrhythmiaDetector::calculateRRInterval(quint64 currentPeakTime)
+void ArrhythmiaDetector::setLatencyMonitor(LatencyMonitor *monitor)
 {
-    if (m_lastPeakTime > 0) {
-        double interval = currentPeakTime - m_lastPeakTime;
-        
-        // Validate interval (should be between 300ms and 2000ms for normal heart rates)
-        if (interval >= 300 && interval <= 2000) {
-            RRInterval rrInterval;
-            rrInterval.interval = interval;
-            rrInterval.timestamp = currentPeakTime;
-            
-            m_rrIntervals.enqueue(rrInterval);
-            
-            // Keep only recent intervals
-            while (m_rrIntervals.size() > MAX_RR_INTERVALS) {
-                m_rrIntervals.dequeue();
-            }
-            
-            updateMetrics();
-        }
-    }
+    ArrhythmiaWorker *worker = m_worker;
+    QMetaObject::invokeMethod(m_worker, [worker, monitor] { worker->setLatencyMonitor(monitor); });
 }
 
-void ArrhythmiaDetector::updateMetrics()
+void ArrhythmiaDetector::processBlock(const EcgSampleBlock &block)
 {
-    if (m_rrIntervals.isEmpty()) {
-        return;
-    }
-    
-    // Calculate average RR interval
-    double sum = 0.0;
-    for (const RRInterval &interval : m_rrIntervals) {
-        sum += interval.interval;
-    }
-    m_averageRRInterval = sum / m_rrIntervals.size();
-    
-    // Calculate RR variability (RMSSD - root mean square of successive differences)
-    if (m_rrIntervals.size() > 1) {
-        double sumSquaredDifferences = 0.0;
-        for (int i = 1; i < m_rrIntervals.size(); ++i) {
-            double diff = m_rrIntervals.at(i).interval - m_rrIntervals.at(i-1).interval;
-            sumSquaredDifferences += diff * diff;
-        }
-        m_rrVariability = qSqrt(sumSquaredDifferences / (m_rrIntervals.size() - 1));
-    }
-    
-    emit metricsChanged();
+    // Detection runs whether or not rhythm monitoring is on: heart rate needs it
+    emit blockAdded(EcgSampleBuffer(block));
 }
 
-void ArrhythmiaDetector::analyzeRhythm()
+void ArrhythmiaDetector::onResultReady(const ArrhythmiaResult &result)
 {
-    if (m_rrIntervals.size() < 5) {
-        return; // Need more data
-    }
-    
-    QString newRhythm = classifyRhythm();
-    
-    if (newRhythm != m_currentRhythm) {
-        m_currentRhythm = newRhythm;
+    const bool newRhythm = result.rhythm != m_result.rhythm;
+    const bool newHeartRate = result.heartRate != m_result.heartRate;
+    const bool newEctopy = result.pvcPerMinute != m_result.pvcPerMinute
+                               || result.pacPerMinute != m_result.pacPerMinute
+                               || result.pvcCount != m_result.pvcCount
+                               || result.pacCount != m_result.pacCount;
+    m_result = result;
+    
+    if (newRhythm) {
         emit rhythmChanged();
-        
-        // Check if this is an arrhythmia
-        if (newRhythm != "Normal Sinus Rhythm") {
-            int severity = calculateSeverity(newRhythm);
-            emit arrhythmiaDetected(newRhythm, severity);
-        }
     }
+    if (newHeartRate) {
+        emit heartRateChanged();
+    }
+    if (newEctopy) {
+        emit ectopyChanged();
+    }
+    emit metricsChanged();
 }
 
-QString ArrhythmiaDetector::classifyRhythm()
+QVariantMap ArrhythmiaDetector::hrvMetrics(HrvStatistics::Window window) const
 {
-    if (m_rrIntervals.isEmpty()) {
-        return "No Data";
-    }
-    
-    // Calculate heart rate from average RR interval
-    double avgHeartRate = 60000.0 / m_averageRRInterval; // BPM
-    
-    // Calculate coefficient of variation for rhythm regularity
-    double cv = (m_rrVariability / m_averageRRInterval) * 100.0;
-    
-    // Simple rhythm classification
-    if (avgHeartRate < 60) {
-        if (cv > 15) {
-            return "Bradyarrhythmia";
-        } else {
-            return "Sinus Bradycardia";
-        }
-    } else if (avgHeartRate > 100) {
-        if (cv > 15) {
-            return "Tachyarrhythmia";
-        } else {
-            return "Sinus Tachycardia";
-        }
-    } else {
-        // Normal rate (60-100 BPM)
-        if (cv > 20) {
-            return "Atrial Fibrillation"; // Very irregular
-        } else if (cv > 15) {
-            return "Irregular Rhythm";
-        } else {
-            return "Normal Sinus Rhythm";
-        }
-    }
+    const HrvMetrics &metrics = m_result.hrv[window];
+    QVariantMap map;
+    map["beats"] = qulonglong(metrics.beats);
+    map["meanRR"] = metrics.meanRR;
+    map["sdnn"] = metrics.sdnn;
+    map["rmssd"] = metrics.rmssd;
+    map["pnn50"] = metrics.pnn50;
+    return map;
 }
 
-int ArrhythmiaDetector::calculateSeverity(const QString &arrhythmiaType)
+void ArrhythmiaDetector::onSpectrumUpdated(const SpectralHrvResult &result)
 {
-    // Severity levels: 1=Low, 2=Medium, 3=High, 4=Critical
-    
-    if (arrhythmiaType == "Sinus Bradycardia" || arrhythmiaType == "Sinus Tachycardia") {
-        return 1; // Low - usually benign
-    } else if (arrhythmiaType == "Irregular Rhythm") {
-        return 2; // Medium - needs attention
-    } else if (arrhythmiaType == "Bradyarrhythmia" || arrhythmiaType == "Tachyarrhythmia") {
-        return 3; // High - concerning
-    } else if (arrhythmiaType == "Atrial Fibrillation") {
-        return 3; // High - stroke risk
-    }
-    
-    return 2; // Default medium severity
-}
\ No newline at end of file
+    m_spectrum = result;
+    emit spectrumChanged();
+}
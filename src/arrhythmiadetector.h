@@ -2,17 +2,23 @@
 
 #include <QObject>
 #include <QQmlEngine>
-#include <QTimer>
-#include <QQueue>
+#include <QVariantMap>
 #include <QQmlEngine>
 #include <QtQml>
 #include <QtQml/qqmlregistration.h>
 
-struct RRInterval {
-    double interval; // in milliseconds
-    quint64 timestamp;
-};
+#include "arrhythmiaworker.h"
+#include "beatdetector.h"
+#include "hrvstatistics.h"
+#include "spectralhrvworker.h"
+
+QT_FORWARD_DECLARE_CLASS(QThread)
+class LatencyMonitor;
 
+// GUI-side face of beat and rhythm analysis. The analysis itself runs on its
+// own thread (ArrhythmiaWorker); sample blocks are queued to it, the filtered
+// samples come back through samplesFiltered() and everything else as one
+// ArrhythmiaResult, so the properties below never wait on it.
 class ArrhythmiaDetector : public QObject
 {
     Q_OBJECT
@@ -20,64 +26,94 @@ class ArrhythmiaDetector : public QObject
     
     Q_PROPERTY(bool isMonitoring READ isMonitoring NOTIFY monitoringChanged)
     Q_PROPERTY(QString currentRhythm READ currentRhythm NOTIFY rhythmChanged)
+    Q_PROPERTY(int rhythmType READ rhythmType NOTIFY rhythmChanged)
+    Q_PROPERTY(int heartRate READ heartRate NOTIFY heartRateChanged)
     Q_PROPERTY(double averageRRInterval READ averageRRInterval NOTIFY metricsChanged)
     Q_PROPERTY(double rrVariability READ rrVariability NOTIFY metricsChanged)
+    Q_PROPERTY(QVariantMap hrvShortTerm READ hrvShortTerm NOTIFY metricsChanged)
+    Q_PROPERTY(QVariantMap hrvFiveMinutes READ hrvFiveMinutes NOTIFY metricsChanged)
+    Q_PROPERTY(QVariantMap hrvOneHour READ hrvOneHour NOTIFY metricsChanged)
+    Q_PROPERTY(QVariantMap hrvTwentyFourHours READ hrvTwentyFourHours NOTIFY metricsChanged)
+    Q_PROPERTY(double lfPower READ lfPower NOTIFY spectrumChanged)
+    Q_PROPERTY(double hfPower READ hfPower NOTIFY spectrumChanged)
+    Q_PROPERTY(double lfHfRatio READ lfHfRatio NOTIFY spectrumChanged)
+    Q_PROPERTY(int pvcPerMinute READ pvcPerMinute NOTIFY ectopyChanged)
+    Q_PROPERTY(int pacPerMinute READ pacPerMinute NOTIFY ectopyChanged)
+    Q_PROPERTY(int pvcCount READ pvcCount NOTIFY ectopyChanged)
+    Q_PROPERTY(int pacCount READ pacCount NOTIFY ectopyChanged)
 
 public:
     explicit ArrhythmiaDetector(QObject *parent = nullptr);
+    ~ArrhythmiaDetector();
 
     // Property getters
     bool isMonitoring() const { return m_isMonitoring; }
-    QString currentRhythm() const { return m_currentRhythm; }
-    double averageRRInterval() const { return m_averageRRInterval; }
-    double rrVariability() const { return m_rrVariability; }
+    QString currentRhythm() const { return QString::fromLatin1(rhythmName(m_result.rhythm)); }
+    int rhythmType() const { return int(m_result.rhythm); }
+    RhythmType rhythm() const { return m_result.rhythm; }
+    int heartRate() const { return m_result.heartRate; }
+    quint64 beatCount() const { return m_result.beatCount; }
+    double averageRRInterval() const { return m_result.averageRRInterval; }
+    double rrVariability() const { return m_result.rrVariability; }
+    QVariantMap hrvShortTerm() const { return hrvMetrics(HrvStatistics::ShortTerm); }
+    QVariantMap hrvFiveMinutes() const { return hrvMetrics(HrvStatistics::FiveMinutes); }
+    QVariantMap hrvOneHour() const { return hrvMetrics(HrvStatistics::OneHour); }
+    QVariantMap hrvTwentyFourHours() const { return hrvMetrics(HrvStatistics::TwentyFourHours); }
+    double lfPower() const { return m_spectrum.lfPower; }
+    double hfPower() const { return m_spectrum.hfPower; }
+    double lfHfRatio() const { return m_spectrum.lfHfRatio; }
+    int pvcPerMinute() const { return m_result.pvcPerMinute; }
+    int pacPerMinute() const { return m_result.pacPerMinute; }
+    int pvcCount() const { return m_result.pvcCount; }
+    int pacCount() const { return m_result.pacCount; }
 
     // Invokable methods
     Q_INVOKABLE void startMonitoring();
     Q_INVOKABLE void stopMonitoring();
-    Q_INVOKABLE void resetAnalysis();
+    Q_INVOKABLE void resetAnalysis(); // Also restarts filtering and beat detection
+
+    // Of the samples passed to processBlock(); the front-end filter is
+    // designed for both
+    void setSampleRate(double sampleRate);
+    void setMainsFrequency(double hz);
+    double mainsFrequency() const { return m_mainsHz; }
+    void setLatencyMonitor(LatencyMonitor *monitor); // Detect stage
 
-    // Called by HMController
-    void processEcgSample(double voltage, quint64 timestamp);
+    // Queues a copy of the block to the worker
+    void processBlock(const EcgSampleBlock &block);
 
 signals:
     void monitoringChanged();
     void rhythmChanged();
+    void heartRateChanged();
     void metricsChanged();
-    void arrhythmiaDetected(const QString &type, int severity);
+    void arrhythmiaDetected(RhythmType rhythm, int severity);
+    void spectrumChanged();
+    void ectopyChanged();
+    void samplesFiltered(const EcgSampleBuffer &filtered);
+
+    // Queued to the worker
+    void blockAdded(const EcgSampleBuffer &buffer);
 
 private slots:
-    void analyzeRhythm();
+    void onResultReady(const ArrhythmiaResult &result);
+    void onSpectrumUpdated(const SpectralHrvResult &result);
 
 private:
-    void detectRPeak(double voltage, quint64 timestamp);
-    void calculateRRInterval(quint64 currentPeakTime);
-    void updateMetrics();
-    QString classifyRhythm();
-    int calculateSeverity(const QString &arrhythmiaType);
-    
-    // R-peak detection
-    QQueue<double> m_voltageBuffer;
-    QQueue<quint64> m_timestampBuffer;
-    double m_peakThreshold;
-    quint64 m_lastPeakTime;
-    bool m_inRefractoryPeriod;
+    QVariantMap hrvMetrics(HrvStatistics::Window window) const;
     
-    // RR interval analysis
-    QQueue<RRInterval> m_rrIntervals;
-    double m_averageRRInterval;
-    double m_rrVariability;
+    // RR statistics, beat morphology and rhythm classification
+    QThread *m_analysisThread;
+    ArrhythmiaWorker *m_worker;
+    ArrhythmiaResult m_result;
     
-    // Rhythm classification
-    QString m_currentRhythm;
-    QTimer *m_analysisTimer;
+    // LF/HF spectrum, computed on its own thread
+    QThread *m_spectralThread;
+    SpectralHrvWorker *m_spectralWorker;
+    SpectralHrvResult m_spectrum;
     
     bool m_isMonitoring;
-    
-    static constexpr int BUFFER_SIZE = 50; // Number of samples to keep
-    static constexpr int MAX_RR_INTERVALS = 20; // For analysis
-    static constexpr int REFRACTORY_PERIOD_MS = 200; // Minimum time between R-peaks
-    static constexpr double MIN_PEAK_HEIGHT = 0.5; // Minimum voltage for R-peak
+    double m_mainsHz;
 };
 
 Q_DECLARE_METATYPE(ArrhythmiaDetector)
@@ -0,0 +1,285 @@
+#include "arrhythmiaworker.h"
+#include "latencymonitor.h"
+
+#include <QDebug>
+#include <QTimer>
+#include <QtMath>
+
+const char *rhythmName(RhythmType rhythm)
+{
+    switch (rhythm) {
+    case RhythmType::NoData: return "No Data";
+    case RhythmType::NormalSinus: return "Normal Sinus Rhythm";
+    case RhythmType::SinusBradycardia: return "Sinus Bradycardia";
+    case RhythmType::SinusTachycardia: return "Sinus Tachycardia";
+    case RhythmType::Bradyarrhythmia: return "Bradyarrhythmia";
+    case RhythmType::Tachyarrhythmia: return "Tachyarrhythmia";
+    case RhythmType::IrregularRhythm: return "Irregular Rhythm";
+    case RhythmType::AtrialFibrillation: return "Atrial Fibrillation";
+    case RhythmType::FrequentPvcs: return "Frequent PVCs";
+    case RhythmType::FrequentPacs: return "Frequent PACs";
+    }
+    return "Unknown";
+}
+
+int rhythmSeverity(RhythmType rhythm)
+{
+    switch (rhythm) {
+    case RhythmType::SinusBradycardia:
+    case RhythmType::SinusTachycardia:
+    case RhythmType::FrequentPacs:
+        return 1; // Low - usually benign
+    case RhythmType::IrregularRhythm:
+    case RhythmType::FrequentPvcs:
+        return 2; // Medium - needs attention
+    case RhythmType::Bradyarrhythmia:
+    case RhythmType::Tachyarrhythmia:
+        return 3; // High - concerning
+    case RhythmType::AtrialFibrillation:
+        return 3; // High - stroke risk
+    default:
+        return 2; // Default medium severity
+    }
+}
+
+ArrhythmiaWorker::ArrhythmiaWorker(QObject *parent)
+    : QObject(parent)
+    , m_frontEndFilter(BeatDetector::DEFAULT_SAMPLE_RATE)
+    , m_beatDetector(new BeatDetector(this))
+    , m_lastSampleTime(0.0)
+    , m_latencyMonitor(nullptr)
+    , m_monitoring(false)
+    , m_analysisTimer(nullptr)
+    , m_publishTimer(nullptr)
+    , m_dirty(false)
+{
+    qRegisterMetaType<RhythmType>("RhythmType");
+    qRegisterMetaType<ArrhythmiaResult>("ArrhythmiaResult");
+    qRegisterMetaType<EcgSampleBuffer>("EcgSampleBuffer");
+
+    // Same thread as this worker, so these are direct calls
+    connect(m_beatDetector, &BeatDetector::beatDetected, this, &ArrhythmiaWorker::onBeatDetected);
+    connect(m_beatDetector, &BeatDetector::beatWindowReady, this, &ArrhythmiaWorker::onBeatWindowReady);
+}
+
+void ArrhythmiaWorker::start()
+{
+    // Created here so the timers live on the worker thread
+    m_analysisTimer = new QTimer(this);
+    m_analysisTimer->setInterval(ANALYSIS_INTERVAL_MS);
+    connect(m_analysisTimer, &QTimer::timeout, this, &ArrhythmiaWorker::analyzeRhythm);
+    if (m_monitoring) {
+        m_analysisTimer->start();
+    }
+
+    m_publishTimer = new QTimer(this);
+    m_publishTimer->setInterval(PUBLISH_INTERVAL_MS);
+    connect(m_publishTimer, &QTimer::timeout, this, &ArrhythmiaWorker::publish);
+    m_publishTimer->start();
+}
+
+void ArrhythmiaWorker::setMonitoring(bool monitoring)
+{
+    m_monitoring = monitoring;
+    if (!m_analysisTimer) {
+        return; // start() picks it up
+    } else if (monitoring) {
+        m_analysisTimer->start();
+    } else {
+        m_analysisTimer->stop();
+    }
+}
+
+void ArrhythmiaWorker::setSampleRate(double sampleRate)
+{
+    // The filter is designed for the rate it runs at, so it follows the detector
+    m_beatDetector->setSampleRate(sampleRate);
+    m_frontEndFilter.reset(m_beatDetector->sampleRate(), m_frontEndFilter.mainsFrequency(), 1);
+}
+
+void ArrhythmiaWorker::setMainsFrequency(double hz)
+{
+    m_frontEndFilter.reset(m_frontEndFilter.sampleRate(), hz, 1);
+}
+
+void ArrhythmiaWorker::reset()
+{
+    m_frontEndFilter.reset();
+    m_beatDetector->reset();
+    m_hrv.reset();
+    m_beatClassifier.reset();
+    m_pvcTimes.clear();
+    m_pacTimes.clear();
+    m_lastSampleTime = 0.0;
+    m_result = ArrhythmiaResult();
+    m_dirty = false;
+    emit resultReady(m_result);
+}
+
+void ArrhythmiaWorker::processBlock(const EcgSampleBuffer &buffer)
+{
+    // Analysis and display see it without baseline wander and mains
+    m_filtered = buffer;
+    m_frontEndFilter.process(m_filtered.samples.data(), m_filtered.samples.size());
+
+    // Beat detection; beats drive heart rate and rhythm analysis
+    const EcgSampleBlock filtered = m_filtered.block();
+    m_beatDetector->processBlock(filtered);
+    if (filtered.count > 0) {
+        m_lastSampleTime = filtered.timeAt(filtered.count - 1);
+    }
+    if (m_latencyMonitor && buffer.arrivalNs > 0) {
+        m_latencyMonitor->recordSince(LatencyStage::Detect, buffer.arrivalNs);
+    }
+
+    emit samplesFiltered(m_filtered);
+}
+
+void ArrhythmiaWorker::onBeatDetected(const BeatEvent &beat)
+{
+    ++m_result.beatCount;
+    m_result.lastBeat = beat;
+    m_dirty = true;
+
+    // Valid R-R interval (30-200 BPM range)
+    if (beat.rrInterval > MIN_RR_MS && beat.rrInterval < MAX_RR_MS) {
+        int newHeartRate = qRound(60000.0 / beat.rrInterval);
+
+        // Smooth the heart rate to avoid beat-to-beat fluctuations
+        m_result.heartRate = m_result.heartRate == 0
+            ? newHeartRate
+            : qRound((m_result.heartRate * 3 + newHeartRate) / 4.0);
+    }
+
+    if (m_monitoring) {
+        addBeat(beat);
+    }
+}
+
+void ArrhythmiaWorker::onBeatWindowReady(const BeatWindow &window)
+{
+    if (m_monitoring) {
+        addBeatWindow(window);
+    }
+}
+
+void ArrhythmiaWorker::addBeat(const BeatEvent &beat)
+{
+    // Validate interval (should be between 300ms and 2000ms for normal heart rates)
+    if (beat.rrInterval < MIN_RR_MS || beat.rrInterval > MAX_RR_MS) {
+        return;
+    }
+
+    m_hrv.addBeat(beat.time, beat.rrInterval);
+    emit nnIntervalAdded(beat.time, beat.rrInterval);
+    m_dirty = true;
+}
+
+void ArrhythmiaWorker::addBeatWindow(const BeatWindow &window)
+{
+    switch (m_beatClassifier.classify(window).type) {
+    case BeatClassifier::Pvc:
+        m_pvcTimes.push_back(window.time);
+        ++m_result.pvcCount;
+        break;
+    case BeatClassifier::Pac:
+        m_pacTimes.push_back(window.time);
+        ++m_result.pacCount;
+        break;
+    default:
+        break;
+    }
+    expireEctopy(window.time);
+    m_dirty = true;
+}
+
+void ArrhythmiaWorker::expireEctopy(double now)
+{
+    while (!m_pvcTimes.empty() && now - m_pvcTimes.front() > ECTOPY_WINDOW_MS) {
+        m_pvcTimes.pop_front();
+    }
+    while (!m_pacTimes.empty() && now - m_pacTimes.front() > ECTOPY_WINDOW_MS) {
+        m_pacTimes.pop_front();
+    }
+    m_result.pvcPerMinute = int(m_pvcTimes.size());
+    m_result.pacPerMinute = int(m_pacTimes.size());
+}
+
+void ArrhythmiaWorker::publish()
+{
+    // Ectopic beats age out even when no beat windows arrive (leads off,
+    // asystole), so frequent ectopy is not reported from stale counts
+    if (m_lastSampleTime > 0.0) {
+        const int pvcPerMinute = m_result.pvcPerMinute;
+        const int pacPerMinute = m_result.pacPerMinute;
+        expireEctopy(m_lastSampleTime);
+        m_dirty = m_dirty || m_result.pvcPerMinute != pvcPerMinute || m_result.pacPerMinute != pacPerMinute;
+    }
+
+    if (!m_dirty) {
+        return;
+    }
+    m_dirty = false;
+
+    // Rhythm classification works on the short-term window: mean RR and RMSSD
+    for (int window = 0; window < HrvStatistics::WindowCount; ++window) {
+        m_result.hrv[window] = m_hrv.metrics(HrvStatistics::Window(window));
+    }
+    m_result.averageRRInterval = m_result.hrv[HrvStatistics::ShortTerm].meanRR;
+    m_result.rrVariability = m_result.hrv[HrvStatistics::ShortTerm].rmssd;
+    emit resultReady(m_result);
+}
+
+void ArrhythmiaWorker::analyzeRhythm()
+{
+    if (m_hrv.beatCount(HrvStatistics::ShortTerm) < MIN_ANALYSIS_BEATS) {
+        return; // Need more data
+    }
+
+    publish(); // Classify on current metrics
+    RhythmType rhythm = classifyRhythm();
+    if (rhythm == m_result.rhythm) {
+        return;
+    }
+
+    m_result.rhythm = rhythm;
+    emit resultReady(m_result);
+
+    // Check if this is an arrhythmia
+    if (rhythm != RhythmType::NormalSinus) {
+        emit arrhythmiaDetected(rhythm, rhythmSeverity(rhythm));
+    }
+}
+
+RhythmType ArrhythmiaWorker::classifyRhythm() const
+{
+    if (m_hrv.beatCount(HrvStatistics::ShortTerm) == 0) {
+        return RhythmType::NoData;
+    }
+
+    // Calculate heart rate from average RR interval
+    double avgHeartRate = 60000.0 / m_result.averageRRInterval; // BPM
+
+    // Calculate coefficient of variation for rhythm regularity
+    double cv = (m_result.rrVariability / m_result.averageRRInterval) * 100.0;
+
+    // Simple rhythm classification
+    if (avgHeartRate < 60) {
+        return cv > 15 ? RhythmType::Bradyarrhythmia : RhythmType::SinusBradycardia;
+    } else if (avgHeartRate > 100) {
+        return cv > 15 ? RhythmType::Tachyarrhythmia : RhythmType::SinusTachycardia;
+    }
+
+    // Normal rate (60-100 BPM). Ectopic beats come first: they also
+    // raise the RR variability and would read as an irregular rhythm
+    if (m_result.pvcPerMinute >= FREQUENT_ECTOPY_PER_MINUTE) {
+        return RhythmType::FrequentPvcs;
+    } else if (m_result.pacPerMinute >= FREQUENT_ECTOPY_PER_MINUTE) {
+        return RhythmType::FrequentPacs;
+    } else if (cv > 20) {
+        return RhythmType::AtrialFibrillation; // Very irregular
+    } else if (cv > 15) {
+        return RhythmType::IrregularRhythm;
+    }
+    return RhythmType::NormalSinus;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <QObject>
+#include <QMetaType>
+
+#include <array>
+#include <deque>
+
+#include "beatclassifier.h"
+#include "beatdetector.h"
+#include "ecgfilter.h"
+#include "ecgsample.h"
+#include "hrvstatistics.h"
+
+QT_FORWARD_DECLARE_CLASS(QTimer)
+class LatencyMonitor;
+
+enum class RhythmType : quint8 {
+    NoData,
+    NormalSinus,
+    SinusBradycardia,
+    SinusTachycardia,
+    Bradyarrhythmia,
+    Tachyarrhythmia,
+    IrregularRhythm,
+    AtrialFibrillation,
+    FrequentPvcs,
+    FrequentPacs
+};
+
+const char *rhythmName(RhythmType rhythm);
+int rhythmSeverity(RhythmType rhythm); // 1=Low, 2=Medium, 3=High, 4=Critical
+
+// Everything the GUI shows of beat and rhythm analysis, published as one value
+struct ArrhythmiaResult {
+    RhythmType rhythm = RhythmType::NoData; // Until the first classification
+    int heartRate = 0;              // Smoothed BPM, 0 before the first valid RR interval
+    quint64 beatCount = 0;          // Beats detected since the last reset
+    BeatEvent lastBeat;
+    double averageRRInterval = 0.0; // Short-term window
+    double rrVariability = 0.0;     // Short-term RMSSD
+    std::array<HrvMetrics, HrvStatistics::WindowCount> hrv{};
+    int pvcPerMinute = 0;
+    int pacPerMinute = 0;
+    int pvcCount = 0;
+    int pacCount = 0;
+};
+
+Q_DECLARE_METATYPE(RhythmType)
+Q_DECLARE_METATYPE(ArrhythmiaResult)
+Q_DECLARE_METATYPE(EcgSampleBuffer)
+
+// The device's signal analysis off the GUI thread: front-end filtering, beat
+// detection, heart rate, RR statistics, beat morphology and rhythm
+// classification. Sample blocks are queued in as they are acquired; the
+// filtered samples go back out through samplesFiltered() for display,
+// everything else through resultReady() at most every PUBLISH_INTERVAL_MS,
+// and alerts through arrhythmiaDetected() as soon as the rhythm changes.
+class ArrhythmiaWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ArrhythmiaWorker(QObject *parent = nullptr);
+
+    // Detect stage; set before the first block
+    void setLatencyMonitor(LatencyMonitor *monitor) { m_latencyMonitor = monitor; }
+
+public slots:
+    void start();
+    void setMonitoring(bool monitoring);
+    void setSampleRate(double sampleRate);
+    void setMainsFrequency(double hz);
+    void reset();
+    void processBlock(const EcgSampleBuffer &buffer);
+    // Rhythm analysis input, fed by the beat detector while monitoring
+    void addBeat(const BeatEvent &beat);
+    void addBeatWindow(const BeatWindow &window);
+
+signals:
+    void samplesFiltered(const EcgSampleBuffer &filtered);
+    void resultReady(const ArrhythmiaResult &result);
+    void arrhythmiaDetected(RhythmType rhythm, int severity);
+    void nnIntervalAdded(double time, double rrInterval);
+
+private slots:
+    void onBeatDetected(const BeatEvent &beat);
+    void onBeatWindowReady(const BeatWindow &window);
+    void analyzeRhythm();
+    void publish();
+
+private:
+    void expireEctopy(double now);
+    RhythmType classifyRhythm() const;
+
+    EcgFrontEndFilter m_frontEndFilter;
+    BeatDetector *m_beatDetector;
+    EcgSampleBuffer m_filtered;
+    double m_lastSampleTime; // ms since epoch of the newest sample processed, the ectopy clock
+    LatencyMonitor *m_latencyMonitor;
+    bool m_monitoring;
+    HrvStatistics m_hrv;
+    BeatClassifier m_beatClassifier;
+    std::deque<double> m_pvcTimes; // Beat times within ECTOPY_WINDOW_MS
+    std::deque<double> m_pacTimes;
+    ArrhythmiaResult m_result;
+    QTimer *m_analysisTimer;
+    QTimer *m_publishTimer;
+    bool m_dirty;
+
+    static constexpr int ANALYSIS_INTERVAL_MS = 5000;
+    static constexpr int PUBLISH_INTERVAL_MS = 250; // GUI updates at most 4 per second
+    static constexpr int MIN_ANALYSIS_BEATS = 5;    // Before rhythm classification
+    static constexpr double MIN_RR_MS = 300.0;      // Valid intervals for normal heart rates
+    static constexpr double MAX_RR_MS = 2000.0;
+    static constexpr double ECTOPY_WINDOW_MS = 60000.0; // Ectopic beat rate window
+    static constexpr int FREQUENT_ECTOPY_PER_MINUTE = 6;
+};
@@ -0,0 +1,228 @@
+#include "beatclassifier.h"
+
+#include <algorithm>
+#include <cmath>
+
+BeatWindowExtractor::BeatWindowExtractor(double sampleRate)
+    : m_history(HISTORY, 0.0)
+{
+    reset(sampleRate);
+}
+
+void BeatWindowExtractor::reset(double sampleRate)
+{
+    m_sampleRate = sampleRate > 0.0 ? sampleRate : 250.0;
+    m_sampleCount = 0;
+    m_pending.clear();
+}
+
+void BeatWindowExtractor::append(const double *samples, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        m_history[(m_sampleCount + i) & (HISTORY - 1)] = samples[i];
+    }
+    m_sampleCount += count;
+}
+
+void BeatWindowExtractor::addBeat(std::uint64_t rIndex, double time, double rrInterval)
+{
+    m_pending.push_back({rIndex, time, rrInterval});
+}
+
+bool BeatWindowExtractor::extract(const PendingBeat &beat, BeatWindow &window) const
+{
+    const double samplesPerMs = m_sampleRate / 1000.0;
+    const double first = double(beat.rIndex) - BeatWindow::WINDOW_BEFORE_MS * samplesPerMs;
+    const double step = (BeatWindow::WINDOW_BEFORE_MS + BeatWindow::WINDOW_AFTER_MS) * samplesPerMs
+                        / double(BeatWindow::WINDOW_POINTS - 1);
+    const double oldest = double(m_sampleCount > HISTORY ? m_sampleCount - HISTORY : 0);
+    if (first < oldest) {
+        return false;
+    }
+
+    // Linear interpolation onto the fixed grid
+    for (int k = 0; k < BeatWindow::WINDOW_POINTS; ++k) {
+        const double position = first + k * step;
+        const auto index = std::uint64_t(position);
+        const double fraction = position - double(index);
+        const double a = m_history[index & (HISTORY - 1)];
+        const double b = m_history[(index + 1) & (HISTORY - 1)];
+        window.samples[k] = float(a + (b - a) * fraction);
+    }
+    window.time = beat.time;
+    window.rrInterval = beat.rrInterval;
+    return true;
+}
+
+BeatClassifier::BeatClassifier()
+{
+    reset();
+}
+
+void BeatClassifier::reset()
+{
+    m_templates = {};
+    m_templateCount = 0;
+    m_normalRR = 0.0;
+    m_learningRRSum = 0.0;
+    m_learningRRCount = 0;
+    m_counts = Counts();
+}
+
+float BeatClassifier::correlate(const float *a, const float *b)
+{
+    // Independent lane sums vectorise without reassociating a single sum
+    float lanes[LANES] = {};
+    for (int i = 0; i < POINTS; i += LANES) {
+        for (int l = 0; l < LANES; ++l) {
+            lanes[l] += a[i + l] * b[i + l];
+        }
+    }
+    float sum = 0.0f;
+    for (int l = 0; l < LANES; ++l) {
+        sum += lanes[l];
+    }
+    return sum;
+}
+
+bool BeatClassifier::normalise(const BeatWindow &window, float *shape)
+{
+    float mean = 0.0f;
+    for (float value : window.samples) {
+        mean += value;
+    }
+    mean /= float(POINTS);
+
+    float energy = 0.0f;
+    for (int i = 0; i < POINTS; ++i) {
+        shape[i] = window.samples[i] - mean;
+        energy += shape[i] * shape[i];
+    }
+    if (!(energy > 1e-12f)) {
+        return false; // Flat line or invalid samples
+    }
+    const float scale = 1.0f / std::sqrt(energy);
+    for (int i = 0; i < POINTS; ++i) {
+        shape[i] *= scale;
+    }
+    return true;
+}
+
+int BeatClassifier::dominantTemplate() const
+{
+    int dominant = -1;
+    for (int t = 0; t < m_templateCount; ++t) {
+        if (dominant < 0 || m_templates[t].members > m_templates[dominant].members) {
+            dominant = t;
+        }
+    }
+    return dominant;
+}
+
+int BeatClassifier::addTemplate(const float *shape)
+{
+    int index = m_templateCount;
+    if (m_templateCount < MAX_TEMPLATES) {
+        ++m_templateCount;
+    } else {
+        // Replace the rarest morphology, never the dominant one
+        const int dominant = dominantTemplate();
+        index = dominant == 0 ? 1 : 0;
+        for (int t = 0; t < m_templateCount; ++t) {
+            if (t != dominant && m_templates[t].members < m_templates[index].members) {
+                index = t;
+            }
+        }
+    }
+    std::copy_n(shape, POINTS, m_templates[index].shape.data());
+    m_templates[index].members = 1;
+    return index;
+}
+
+void BeatClassifier::updateNormalRR(double rrInterval)
+{
+    if (rrInterval <= 0.0) {
+        return;
+    }
+    // Compensatory pauses and missed beats do not move the reference
+    if (m_normalRR > 0.0 && std::abs(rrInterval - m_normalRR) > 0.3 * m_normalRR) {
+        return;
+    }
+    m_normalRR = m_normalRR > 0.0 ? m_normalRR + RR_ADAPTATION * (rrInterval - m_normalRR) : rrInterval;
+}
+
+BeatClassifier::Result BeatClassifier::classify(const BeatWindow &window)
+{
+    Result result;
+    alignas(32) float shape[POINTS];
+    if (!normalise(window, shape)) {
+        return result;
+    }
+    ++m_counts.beats;
+
+    // Best template by NCC
+    int best = -1;
+    float bestCorrelation = -1.0f;
+    for (int t = 0; t < m_templateCount; ++t) {
+        const float correlation = correlate(shape, m_templates[t].shape.data());
+        if (correlation > bestCorrelation) {
+            best = t;
+            bestCorrelation = correlation;
+        }
+    }
+
+    if (best >= 0 && bestCorrelation >= MATCH_CORRELATION) {
+        Template &matched = m_templates[best];
+        float energy = 0.0f;
+        for (int i = 0; i < POINTS; ++i) {
+            matched.shape[i] += TEMPLATE_ADAPTATION * (shape[i] - matched.shape[i]);
+            energy += matched.shape[i] * matched.shape[i];
+        }
+        const float scale = 1.0f / std::sqrt(energy);
+        for (float &value : matched.shape) {
+            value *= scale;
+        }
+        ++matched.members;
+        result.templateIndex = best;
+    } else {
+        result.templateIndex = addTemplate(shape);
+    }
+
+    if (m_counts.beats <= std::uint64_t(LEARNING_BEATS)) {
+        if (window.rrInterval > 0.0) {
+            m_learningRRSum += window.rrInterval;
+            ++m_learningRRCount;
+        }
+        if (m_counts.beats == std::uint64_t(LEARNING_BEATS) && m_learningRRCount > 0) {
+            m_normalRR = m_learningRRSum / m_learningRRCount;
+        }
+        return result;
+    }
+
+    const int dominant = dominantTemplate();
+    result.correlation = correlate(shape, m_templates[dominant].shape.data());
+    result.premature = window.rrInterval > 0.0 && m_normalRR > 0.0
+                       && window.rrInterval < PREMATURE_RATIO * m_normalRR;
+
+    if (result.correlation >= NORMAL_CORRELATION) {
+        result.type = result.premature ? Pac : Normal;
+    } else if (result.premature || result.correlation < ABERRANT_CORRELATION) {
+        result.type = Pvc;
+    }
+
+    switch (result.type) {
+    case Normal:
+        ++m_counts.normal;
+        updateNormalRR(window.rrInterval);
+        break;
+    case Pvc:
+        ++m_counts.pvc;
+        break;
+    case Pac:
+        ++m_counts.pac;
+        break;
+    case Unclassified:
+        break;
+    }
+    return result;
+}
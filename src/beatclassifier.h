@@ -0,0 +1,155 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Shape of one beat: the signal from WINDOW_BEFORE_MS before to
+// WINDOW_AFTER_MS after the R peak, resampled to WINDOW_POINTS points so
+// beats from any sample rate compare directly
+struct BeatWindow {
+    static constexpr int WINDOW_POINTS = 64;
+    static constexpr double WINDOW_BEFORE_MS = 200.0; // P wave and QRS onset
+    static constexpr double WINDOW_AFTER_MS = 300.0;  // QRS and ST segment
+
+    double time = 0.0;       // ms since epoch of the R peak
+    double rrInterval = 0.0; // ms since the previous beat, 0 if there is none
+    alignas(32) std::array<float, WINDOW_POINTS> samples{};
+};
+
+// Cuts BeatWindows out of a sample stream. Beats are confirmed some time
+// after their R peak and the window reaches past it, so a beat waits here
+// until the samples after it have arrived. History covers HISTORY samples
+// (4 s at 2 kHz); a beat whose window fell out of it is dropped.
+class BeatWindowExtractor
+{
+public:
+    explicit BeatWindowExtractor(double sampleRate = 250.0);
+
+    void reset(double sampleRate);
+
+    void append(const double *samples, std::size_t count);
+    void addBeat(std::uint64_t rIndex, double time, double rrInterval);
+
+    // Calls fn(const BeatWindow &) for every beat whose window is complete
+    template <typename Fn>
+    void takeReady(Fn &&fn);
+
+    std::uint64_t sampleCount() const { return m_sampleCount; }
+
+    static constexpr std::size_t HISTORY = 8192;
+
+private:
+    struct PendingBeat {
+        std::uint64_t rIndex;
+        double time;
+        double rrInterval;
+    };
+
+    bool extract(const PendingBeat &beat, BeatWindow &window) const;
+
+    double m_sampleRate;
+    std::uint64_t m_sampleCount;
+    std::vector<double> m_history;
+    std::vector<PendingBeat> m_pending;
+};
+
+// Morphology classification of beats by normalised cross-correlation (NCC)
+// against a running set of beat templates. Each window is reduced to zero
+// mean and unit energy, so the NCC with a template is a plain dot product.
+// A beat joins the best template at or above MATCH_CORRELATION, which then
+// follows it slowly; otherwise it starts a template of its own. The template
+// with the most members is the dominant (normal) morphology:
+//
+// - like the dominant, on time:        Normal
+// - like the dominant, premature:      Pac (supraventricular ectopic)
+// - unlike the dominant, premature or
+//   very unlike it (any timing):       Pvc (ventricular ectopic)
+//
+// "Premature" is an RR interval below PREMATURE_RATIO of the running normal
+// RR. The dot products run in float lanes the compiler vectorises.
+class BeatClassifier
+{
+public:
+    enum BeatType {
+        Unclassified, // Learning, or no clear call
+        Normal,
+        Pvc,
+        Pac
+    };
+
+    struct Result {
+        BeatType type = Unclassified;
+        float correlation = 0.0f; // With the dominant template
+        int templateIndex = -1;   // Template the beat joined
+        bool premature = false;
+    };
+
+    struct Counts {
+        std::uint64_t beats = 0;
+        std::uint64_t normal = 0;
+        std::uint64_t pvc = 0;
+        std::uint64_t pac = 0;
+    };
+
+    BeatClassifier();
+
+    Result classify(const BeatWindow &window);
+    void reset();
+
+    const Counts &counts() const { return m_counts; }
+    int templateCount() const { return m_templateCount; }
+    double normalRR() const { return m_normalRR; }
+
+    static float correlate(const float *a, const float *b);
+
+    static constexpr int MAX_TEMPLATES = 8;
+    static constexpr int LEARNING_BEATS = 8;          // Templates only, no calls
+    static constexpr float MATCH_CORRELATION = 0.92f; // Same morphology
+    static constexpr float NORMAL_CORRELATION = 0.85f; // Close enough to the dominant
+    static constexpr float ABERRANT_CORRELATION = 0.5f; // Ventricular whatever the timing
+    static constexpr double PREMATURE_RATIO = 0.85;
+    static constexpr float TEMPLATE_ADAPTATION = 0.05f; // Weight of a new member
+    static constexpr double RR_ADAPTATION = 0.1;
+
+private:
+    static constexpr int POINTS = BeatWindow::WINDOW_POINTS;
+    static constexpr int LANES = 8;
+
+    struct Template {
+        alignas(32) std::array<float, POINTS> shape{};
+        std::uint32_t members = 0;
+    };
+
+    static bool normalise(const BeatWindow &window, float *shape);
+    int dominantTemplate() const;
+    int addTemplate(const float *shape);
+    void updateNormalRR(double rrInterval);
+
+    std::array<Template, MAX_TEMPLATES> m_templates;
+    int m_templateCount;
+    double m_normalRR;
+    double m_learningRRSum;
+    int m_learningRRCount;
+    Counts m_counts;
+};
+
+template <typename Fn>
+void BeatWindowExtractor::takeReady(Fn &&fn)
+{
+    BeatWindow window;
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < m_pending.size(); ++i) {
+        const PendingBeat &beat = m_pending[i];
+        const double afterSamples = BeatWindow::WINDOW_AFTER_MS * m_sampleRate / 1000.0;
+        if (double(beat.rIndex) + afterSamples + 1.0 >= double(m_sampleCount)) {
+            m_pending[kept++] = beat; // Still waiting for samples
+            continue;
+        }
+        if (extract(beat, window)) {
+            fn(window);
+        }
+    }
+    m_pending.resize(kept);
+}
@@ -0,0 +1,77 @@
+#include "beatdetector.h"
+
+#include <QDebug>
+#include <QtMath>
+
+BeatDetector::BeatDetector(QObject *parent)
+    : QObject(parent)
+    , m_qrsDetector(DEFAULT_SAMPLE_RATE)
+    , m_windowExtractor(DEFAULT_SAMPLE_RATE)
+    , m_lastBeatTime(0.0)
+{
+    qRegisterMetaType<BeatEvent>("BeatEvent");
+    qRegisterMetaType<BeatWindow>("BeatWindow");
+}
+
+void BeatDetector::setSampleRate(double sampleRate)
+{
+    if (sampleRate > 0.0 && sampleRate != m_qrsDetector.sampleRate()) {
+        qDebug() << "Beat detector sample rate set to" << sampleRate << "Hz";
+        m_qrsDetector.reset(sampleRate);
+        m_windowExtractor.reset(sampleRate);
+        m_lastBeatTime = 0.0;
+    }
+}
+
+void BeatDetector::reset()
+{
+    m_qrsDetector.reset(m_qrsDetector.sampleRate());
+    m_windowExtractor.reset(m_qrsDetector.sampleRate());
+    m_lastBeatTime = 0.0;
+}
+
+void BeatDetector::processBlock(const EcgSampleBlock &block)
+{
+    // Beats are confirmed up to a few hundred ms after the R peak, possibly
+    // in an earlier block, so their time is taken relative to this block
+    const double period = 1000.0 / m_qrsDetector.sampleRate();
+    const double firstIndex = double(m_qrsDetector.sampleCount());
+    m_windowExtractor.append(block.samples, std::size_t(block.count));
+
+    for (qsizetype i = 0; i < block.count; ++i) {
+        if (!m_qrsDetector.process(block.samples[i])) {
+            continue;
+        }
+
+        const QrsDetector::Beat &detected = m_qrsDetector.lastBeat();
+        BeatEvent beat;
+        beat.time = block.startTime + (double(detected.sampleIndex) - firstIndex) * period;
+        beat.confidence = confidenceOf(detected);
+        beat.amplitude = detected.amplitude;
+
+        double interval = beat.time - m_lastBeatTime;
+        if (m_lastBeatTime > 0.0 && interval > 0.0 && interval <= MAX_RR_INTERVAL_MS) {
+            beat.rrInterval = interval;
+        }
+        m_lastBeatTime = beat.time;
+
+        emit beatDetected(beat);
+        m_windowExtractor.addBeat(detected.sampleIndex, beat.time, beat.rrInterval);
+    }
+
+    m_windowExtractor.takeReady([this](const BeatWindow &window) { emit beatWindowReady(window); });
+}
+
+double BeatDetector::confidenceOf(const QrsDetector::Beat &beat) const
+{
+    if (beat.threshold <= 0.0) {
+        return 0.5;
+    }
+
+    // How far the integrated peak cleared its threshold: just above it maps
+    // to 0.5, twice the threshold or more to 1.0. Search-back beats were
+    // accepted against the lower threshold and are scaled into 0..0.5.
+    double margin = qBound(0.0, beat.peakValue / beat.threshold - 1.0, 1.0);
+    double confidence = 0.5 + 0.5 * margin;
+    return beat.searchBack ? 0.5 * confidence : confidence;
+}
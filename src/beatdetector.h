@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QObject>
+#include <QMetaType>
+
+#include "beatclassifier.h"
+#include "ecgsample.h"
+#include "qrsdetector.h"
+
+// One detected heartbeat
+struct BeatEvent {
+    double time = 0.0;       // ms since epoch of the R peak
+    double rrInterval = 0.0; // ms since the previous beat, 0 if there is none
+    double confidence = 0.0; // 0..1, search-back beats stay below 0.5
+    double amplitude = 0.0;  // Signal value at the R peak
+};
+
+Q_DECLARE_METATYPE(BeatEvent)
+Q_DECLARE_METATYPE(BeatWindow)
+
+// The single source of beats in the application. Runs the streaming QRS
+// detector over incoming sample blocks and emits each beat exactly once;
+// heart rate, RR metrics and rhythm analysis all consume this stream. Each
+// beat is also cut out of the signal as a BeatWindow for morphology
+// analysis, once the samples after its R peak have arrived.
+class BeatDetector : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit BeatDetector(QObject *parent = nullptr);
+
+    double sampleRate() const { return m_qrsDetector.sampleRate(); }
+    void setSampleRate(double sampleRate);
+
+    void processBlock(const EcgSampleBlock &block);
+    void reset();
+
+    static constexpr double DEFAULT_SAMPLE_RATE = 250.0; // Hz, the device's until told otherwise
+
+signals:
+    void beatDetected(const BeatEvent &beat);
+    void beatWindowReady(const BeatWindow &window);
+
+private:
+    double confidenceOf(const QrsDetector::Beat &beat) const;
+
+    QrsDetector m_qrsDetector;
+    BeatWindowExtractor m_windowExtractor;
+    double m_lastBeatTime;
+
+    static constexpr double MAX_RR_INTERVAL_MS = 3000.0; // Longer gaps do not form an RR interval
+};
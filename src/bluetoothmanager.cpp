@@ -1,18 +1,35 @@
 #include "bluetoothmanager.h"
+#include "latencymonitor.h"
 #include <QDebug>
 #include <QBluetoothServiceDiscoveryAgent>
 #include <QtMath>
-#include <QRandomGenerator>
+#include <QDateTime>
+#include <algorithm>
+#include <cmath>
 
 BluetoothManager::BluetoothManager(QObject *parent)
     : QObject(parent)
     , m_discoveryAgent(nullptr)
     , m_socket(nullptr)
+    , m_sampleRing(nullptr)
+    , m_latencyMonitor(nullptr)
     , m_isScanning(false)
     , m_isConnected(false)
     , m_useSimulation(true) // Enable simulation by default for testing
-    , m_simulationTime(0.0)
-    , m_simulationHeartRate(72)
+    , m_deviceProtocol(DeviceProtocol::Auto)
+    , m_activeProtocol(DeviceProtocol::Auto)
+    , m_readBuffer(READ_CHUNK)
+    , m_parsedBlock(MAX_PARSED_BLOCK)
+    , m_parsedCount(0)
+    , m_deviceSampleRate(250.0)
+    , m_deviceSampleIndex(0)
+    , m_deviceClock(m_deviceSampleRate)
+    , m_hostAnchorNs(0)
+    , m_hostAnchorEpochMs(0.0)
+    , m_samplePeriodMs(0.0)
+    , m_clockDriftPpm(0.0)
+    , m_simulationUnthrottled(false)
+    , m_simulationBlock(MAX_SIMULATION_BLOCK)
 {
     // Initialize Bluetooth discovery agent
     m_discoveryAgent = new QBluetoothDeviceDiscoveryAgent(this);
@@ -26,7 +43,8 @@ BluetoothManager::BluetoothManager(QObject *parent)
     // Initialize simulation timer for testing
     m_simulationTimer = new QTimer(this);
     connect(m_simulationTimer, &QTimer::timeout, this, &BluetoothManager::simulateEcgData);
-    m_simulationTimer->setInterval(4); // 250 Hz sampling rate (4ms intervals)
+    m_simulationTimer->setTimerType(Qt::PreciseTimer);
+    m_simulationTimer->setInterval(SIMULATION_TICK_MS);
     
     qDebug() << "BluetoothManager initialized";
 }
@@ -70,9 +88,12 @@ void BluetoothManager::startScanning()
         // For simulation, immediately "connect" and start generating data
         m_isConnected = true;
         m_connectedDeviceName = "ECG Simulator";
+        m_simulator.reset(quint64(QDateTime::currentMSecsSinceEpoch()));
+        m_simulationClock.start();
         m_simulationTimer->start();
         emit connectionStateChanged(true);
-        qDebug() << "Started ECG simulation";
+        qDebug() << "Started ECG simulation at" << m_simulator.sampleRate() << "Hz"
+                 << (m_simulationUnthrottled ? "(unthrottled)" : "");
         return;
     }
     
@@ -122,6 +143,16 @@ void BluetoothManager::connectToDevice(const QString &deviceAddress)
         return;
     }
     
+    // Fresh parser state for the new stream
+    m_activeProtocol = m_deviceProtocol;
+    m_frameParser.reset();
+    m_textParser.reset();
+    m_parsedCount = 0;
+    m_deviceSampleIndex = 0;
+    m_deviceClock.reset(m_deviceSampleRate);
+    m_hostAnchorNs = LatencyMonitor::nowNs();
+    m_hostAnchorEpochMs = double(QDateTime::currentMSecsSinceEpoch());
+    
     // Create socket and connect
     m_socket = new QBluetoothSocket(QBluetoothServiceInfo::RfcommProtocol, this);
     
@@ -165,6 +196,50 @@ QVariantList BluetoothManager::getAvailableDevices()
     return availableDevices();
 }
 
+void BluetoothManager::setSampleRing(EcgSampleRing *ring)
+{
+    m_sampleRing = ring;
+}
+
+void BluetoothManager::setLatencyMonitor(LatencyMonitor *monitor)
+{
+    m_latencyMonitor = monitor;
+}
+
+void BluetoothManager::setDeviceProtocol(DeviceProtocol protocol)
+{
+    m_deviceProtocol = protocol;
+}
+
+void BluetoothManager::setDeviceSampleRate(double sampleRate)
+{
+    m_deviceSampleRate = sampleRate;
+}
+
+BluetoothManager::ProtocolStatistics BluetoothManager::protocolStatistics() const
+{
+    EcgFrameParser::Statistics frames = m_frameParser.statistics();
+    ProtocolStatistics stats;
+    stats.frames = frames.frames;
+    stats.crcErrors = frames.crcErrors;
+    stats.lostFrames = frames.lostFrames;
+    stats.discardedBytes = frames.discardedBytes;
+    stats.invalidLines = m_textParser.invalidLines();
+    stats.samplePeriodMs = m_samplePeriodMs.load(std::memory_order_relaxed);
+    stats.clockDriftPpm = m_clockDriftPpm.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void BluetoothManager::setSimulationOptions(const SimulationOptions &options)
+{
+    m_simulator = EcgSimulator(options.sampleRate, options.seed);
+    m_simulator.setScript(options.script);
+    m_simulationUnthrottled = options.unthrottled;
+
+    // Unthrottled: tick whenever the event loop is idle
+    m_simulationTimer->setInterval(m_simulationUnthrottled ? 0 : SIMULATION_TICK_MS);
+}
+
 // Private slots
 void BluetoothManager::deviceDiscovered(const QBluetoothDeviceInfo &device)
 {
@@ -253,77 +328,134 @@ void BluetoothManager::socketReadyRead()
 {
     if (!m_socket) return;
     
-    QByteArray data = m_socket->readAll();
-    m_incomingBuffer.append(data);
+    // Everything in this read arrived together
+    const qint64 arrivalNs = LatencyMonitor::nowNs();
     
-    // Process complete packets (assuming newline-terminated)
-    while (m_incomingBuffer.contains('\n')) {
-        int newlineIndex = m_incomingBuffer.indexOf('\n');
-        QByteArray packet = m_incomingBuffer.left(newlineIndex);
-        m_incomingBuffer.remove(0, newlineIndex + 1);
-        
-        processIncomingData(packet);
+    // Read into the reused buffer and parse in place; no per-packet copies
+    std::size_t samples = 0;
+    qint64 bytes;
+    while ((bytes = m_socket->read(m_readBuffer.data(), qint64(m_readBuffer.size()))) > 0) {
+        samples += parseIncomingData(m_readBuffer.data(), std::size_t(bytes), arrivalNs);
+    }
+    flushParsedSamples(arrivalNs);
+    
+    // One clock read per socket read keeps this cheap; Parse is per sample
+    if (m_latencyMonitor && samples > 0) {
+        m_latencyMonitor->record(LatencyStage::Parse, (LatencyMonitor::nowNs() - arrivalNs) / qint64(samples));
     }
 }
 
 void BluetoothManager::simulateEcgData()
 {
-    // Generate realistic ECG simulation
-    double t = m_simulationTime;
-    double heartRateBpm = m_simulationHeartRate + QRandomGenerator::global()->bounded(-5, 5); // Slight variation
-    double heartRateHz = heartRateBpm / 60.0;
-    
-    // ECG waveform simulation (simplified)
-    double ecgValue = 0.0;
-    
-    // P wave, QRS complex, T wave simulation
-    double heartCycle = fmod(t * heartRateHz, 1.0);
-    
-    if (heartCycle < 0.1) {
-        // P wave
-        ecgValue = 0.2 * sin(heartCycle * 31.4159);
-    } else if (heartCycle > 0.15 && heartCycle < 0.25) {
-        // QRS complex
-        double qrsPhase = (heartCycle - 0.15) / 0.1;
-        if (qrsPhase < 0.3) {
-            ecgValue = -0.1 * sin(qrsPhase * 10.47);
-        } else if (qrsPhase < 0.7) {
-            ecgValue = 1.0 * sin((qrsPhase - 0.3) * 7.85);
-        } else {
-            ecgValue = -0.3 * sin((qrsPhase - 0.7) * 10.47);
+    std::size_t due;
+    if (m_simulationUnthrottled) {
+        // Only as much as the consumer has drained; the rest would overflow
+        due = m_sampleRing ? m_sampleRing->freeSpace() : MAX_SIMULATION_BLOCK;
+    } else {
+        // Catch the sample clock up with real time, however late the tick
+        quint64 target = quint64(double(m_simulationClock.nsecsElapsed()) * m_simulator.sampleRate() / 1e9);
+        due = target > m_simulator.sampleIndex() ? std::size_t(target - m_simulator.sampleIndex()) : 0;
+    }
+
+    const qint64 arrivalNs = LatencyMonitor::nowNs();
+    while (due > 0) {
+        std::size_t count = std::min(due, MAX_SIMULATION_BLOCK);
+        m_simulator.generate(m_simulationBlock.data(), count);
+        for (std::size_t i = 0; i < count; ++i) {
+            m_simulationBlock[i].arrivalNs = arrivalNs;
         }
-    } else if (heartCycle > 0.4 && heartCycle < 0.6) {
-        // T wave
-        ecgValue = 0.3 * sin((heartCycle - 0.4) * 15.7);
+        deliverSamples(m_simulationBlock.data(), count);
+        due -= count;
+    }
+}
+
+std::size_t BluetoothManager::parseIncomingData(const char *data, std::size_t size, qint64 arrivalNs)
+{
+    if (m_activeProtocol == DeviceProtocol::Auto) {
+        // Text devices send printable ASCII only; frame headers never are
+        bool binary = std::any_of(data, data + size, [](char c) {
+            unsigned char byte = static_cast<unsigned char>(c);
+            return (byte < 0x20 && byte != '\n' && byte != '\r' && byte != '\t') || byte > 0x7E;
+        });
+        m_activeProtocol = binary ? DeviceProtocol::BinaryFrames : DeviceProtocol::Text;
+        qDebug() << "Device protocol:" << (binary ? "binary frames" : "text");
     }
     
-    // Add some noise
-    ecgValue += (QRandomGenerator::global()->generateDouble() - 0.5) * 0.05;
+    std::size_t count = 0;
+    if (m_activeProtocol == DeviceProtocol::BinaryFrames) {
+        m_frameParser.feed(reinterpret_cast<const std::uint8_t *>(data), size, [&](const EcgFrame &frame) {
+            // The device kept sampling while the lost frames were in transit
+            quint64 lost = quint64(frame.lostBefore) * frame.sampleCount;
+            if (double(lost) > MAX_LOST_SECONDS * m_deviceSampleRate) {
+                flushParsedSamples(arrivalNs);
+                m_deviceClock.reset();
+                qWarning() << "Device sequence jumped by" << frame.lostBefore << "frames; resynchronising its clock";
+            }
+            m_deviceSampleIndex += lost;
+            for (std::size_t i = 0; i < frame.sampleCount; ++i) {
+                appendParsedSample(frame.voltage(i, 0), arrivalNs);
+            }
+            count += frame.sampleCount;
+        });
+    } else {
+        m_textParser.feed(data, size, [&](const double *values, std::size_t) {
+            appendParsedSample(values[0], arrivalNs);
+            ++count;
+        });
+    }
+    return count;
+}
+
+void BluetoothManager::appendParsedSample(double voltage, qint64 arrivalNs)
+{
+    EcgSample &sample = m_parsedBlock[m_parsedCount++];
+    sample.voltage = voltage;
+    sample.arrivalNs = arrivalNs;
+    sample.sampleIndex = m_deviceSampleIndex++;
+    if (m_parsedCount == m_parsedBlock.size()) {
+        flushParsedSamples(arrivalNs);
+    }
+}
+
+void BluetoothManager::flushParsedSamples(qint64 arrivalNs)
+{
+    if (m_parsedCount == 0) {
+        return;
+    }
     
-    quint64 timestamp = QDateTime::currentMSecsSinceEpoch();
-    emit newEcgData(ecgValue, timestamp);
+    // The newest sample had been taken by the time its read arrived; stamp
+    // the whole batch from the updated device clock
+    double hostMs = m_hostAnchorEpochMs + double(arrivalNs - m_hostAnchorNs) / 1e6;
+    m_deviceClock.observe(m_parsedBlock[m_parsedCount - 1].sampleIndex, hostMs);
+    for (std::size_t i = 0; i < m_parsedCount; ++i) {
+        m_parsedBlock[i].timestamp = quint64(std::llround(m_deviceClock.timeAt(m_parsedBlock[i].sampleIndex)));
+    }
+    m_samplePeriodMs.store(m_deviceClock.samplePeriodMs(), std::memory_order_relaxed);
+    m_clockDriftPpm.store(m_deviceClock.driftPpm(), std::memory_order_relaxed);
     
-    m_simulationTime += 0.004; // 4ms increment (250 Hz)
+    deliverSamples(m_parsedBlock.data(), m_parsedCount);
+    m_parsedCount = 0;
 }
 
-void BluetoothManager::processIncomingData(const QByteArray &data)
+void BluetoothManager::deliverSamples(const EcgSample *samples, std::size_t count)
 {
-    double ecgValue = parseEcgValue(data);
-    quint64 timestamp = QDateTime::currentMSecsSinceEpoch();
+    if (!m_sampleRing) {
+        for (std::size_t i = 0; i < count; ++i) {
+            emit newEcgData(samples[i].voltage, samples[i].timestamp);
+        }
+        return;
+    }
     
-    emit newEcgData(ecgValue, timestamp);
+    m_sampleRing->push(samples, count);
+    if (m_sampleRing->requestWakeup()) {
+        emit samplesAvailable();
+    }
 }
 
 double BluetoothManager::parseEcgValue(const QByteArray &data)
 {
-    // Parse ECG value from device-specific format
-    // This is a simplified example - adjust based on your device's protocol
-    QString dataStr = QString::fromUtf8(data).trimmed();
-    
-    // Assuming format like "ECG:1.234" or just "1.234"
-    if (dataStr.startsWith("ECG:")) {
-        return dataStr.mid(4).toDouble();
-    }
-    
-    return dataStr.toDouble();
-}
\ No newline at end of file
+    // Malformed lines read as 0, as with QString::toDouble
+    double value = 0.0;
+    EcgTextParser::parseLine(data.constData(), data.constData() + data.size(), &value, 1);
+    return value;
+}
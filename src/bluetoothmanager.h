@@ -5,12 +5,21 @@
 #include <QBluetoothDeviceInfo>
 #include <QBluetoothUuid>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QVariantList>
 #include <QQmlEngine>
 #include <QtQml>
 #include <QtQml/qqmlregistration.h>
 
+#include "ecgframeparser.h"
+#include "ecgsample.h"
+#include "ecgsimulator.h"
+#include "sampleclock.h"
+#include <atomic>
+#include <vector>
+
 QT_FORWARD_DECLARE_CLASS(QBluetoothServiceDiscoveryAgent)
+class LatencyMonitor;
 
 class BluetoothManager : public QObject
 {
@@ -23,6 +32,30 @@ class BluetoothManager : public QObject
     Q_PROPERTY(QVariantList availableDevices READ availableDevices NOTIFY devicesUpdated)
 
 public:
+    // Wire format of a real device; Auto decides on the first bytes received
+    enum class DeviceProtocol {
+        Auto,
+        Text,        // "ECG:1.234\n" lines
+        BinaryFrames // See ecgframeparser.h
+    };
+
+    struct ProtocolStatistics {
+        quint64 frames = 0;
+        quint64 crcErrors = 0;
+        quint64 lostFrames = 0;     // From sequence number gaps
+        quint64 discardedBytes = 0; // Skipped while resynchronising
+        quint64 invalidLines = 0;
+        double samplePeriodMs = 0.0; // Estimated device sample period
+        double clockDriftPpm = 0.0;  // Device clock against the host
+    };
+
+    struct SimulationOptions {
+        double sampleRate = 250.0;
+        std::vector<EcgSimulator::Step> script = {{EcgSimulator::NormalSinus, 0.0}};
+        bool unthrottled = false; // Generate as fast as the ring drains
+        quint32 seed = 1;
+    };
+
     explicit BluetoothManager(QObject *parent = nullptr);
     ~BluetoothManager();
 
@@ -39,11 +72,34 @@ public:
     Q_INVOKABLE void disconnectFromDevice();
     Q_INVOKABLE QVariantList getAvailableDevices();
 
+    // When set, samples are pushed into the ring instead of emitted through
+    // newEcgData. Must be called before the manager is moved to its thread.
+    void setSampleRing(EcgSampleRing *ring);
+
+    // Records the Parse stage. Must be called before the manager is moved to its thread.
+    void setLatencyMonitor(LatencyMonitor *monitor);
+
+    // Simulated device settings; apply before the manager is moved to its
+    // thread or while it is disconnected
+    void setSimulationOptions(const SimulationOptions &options);
+
+    // Apply before connecting. The rate is the device's nominal one; its
+    // actual clock is estimated from the arrival times.
+    void setDeviceProtocol(DeviceProtocol protocol);
+    void setDeviceSampleRate(double sampleRate);
+
+    // Parser counters for the current connection; thread-safe
+    ProtocolStatistics protocolStatistics() const;
+
+    // Parses one line of the device's text protocol ("ECG:1.234" or "1.234")
+    static double parseEcgValue(const QByteArray &data);
+
 signals:
     void scanningChanged();
     void connectionStateChanged(bool connected);
     void devicesUpdated();
     void newEcgData(double voltage, quint64 timestamp);
+    void samplesAvailable(); // Ring went from drained to non-empty
     void error(const QString &errorString);
 
 private slots:
@@ -57,8 +113,10 @@ private slots:
     void simulateEcgData(); // For testing without actual device
 
 private:
-    void processIncomingData(const QByteArray &data);
-    double parseEcgValue(const QByteArray &data);
+    std::size_t parseIncomingData(const char *data, std::size_t size, qint64 arrivalNs);
+    void appendParsedSample(double voltage, qint64 arrivalNs);
+    void flushParsedSamples(qint64 arrivalNs);
+    void deliverSamples(const EcgSample *samples, std::size_t count);
     
     QBluetoothDeviceDiscoveryAgent *m_discoveryAgent;
     QBluetoothSocket *m_socket;
@@ -66,13 +124,45 @@ private:
     
     QList<QBluetoothDeviceInfo> m_devices;
     QString m_connectedDeviceName;
-    QByteArray m_incomingBuffer;
+    EcgSampleRing *m_sampleRing;
+    LatencyMonitor *m_latencyMonitor;
     
     bool m_isScanning;
     bool m_isConnected;
     bool m_useSimulation; // For testing without actual device
+
+    // Device input is parsed straight out of m_readBuffer; only a packet
+    // split across reads is carried over inside the parsers. Only the first
+    // lead is delivered, the analysis pipeline is single-lead.
+    DeviceProtocol m_deviceProtocol;
+    DeviceProtocol m_activeProtocol; // Resolved from Auto per connection
+    EcgFrameParser m_frameParser;
+    EcgTextParser m_textParser;
+    std::vector<char> m_readBuffer;
+    std::vector<EcgSample> m_parsedBlock;
+    std::size_t m_parsedCount;
+
+    // Device samples are numbered as they are parsed (frames lost in
+    // transit advance the counter) and stamped from the device clock
+    // estimate rather than their arrival, so bursts keep exact spacing
+    double m_deviceSampleRate;
+    quint64 m_deviceSampleIndex;
+    SampleClock m_deviceClock;
+    qint64 m_hostAnchorNs;       // Steady clock ...
+    double m_hostAnchorEpochMs;  // ... and wall clock at connection
+    std::atomic<double> m_samplePeriodMs;
+    std::atomic<double> m_clockDriftPpm;
     
-    // Simulation variables
-    double m_simulationTime;
-    int m_simulationHeartRate;
+    // Simulation: the sample counter, not the timer, defines the timestamps;
+    // each tick generates whatever the elapsed time (or free ring space) allows
+    EcgSimulator m_simulator;
+    QElapsedTimer m_simulationClock;
+    bool m_simulationUnthrottled;
+    std::vector<EcgSample> m_simulationBlock;
+
+    static constexpr int SIMULATION_TICK_MS = 10;
+    static constexpr std::size_t MAX_SIMULATION_BLOCK = 1024;
+    static constexpr std::size_t READ_CHUNK = 16384;
+    static constexpr std::size_t MAX_PARSED_BLOCK = 1024;
+    static constexpr double MAX_LOST_SECONDS = 5.0; // Longer sequence gaps are taken as a device restart
 };
@@ -3,33 +3,38 @@
 
 EcgDataModel::EcgDataModel(QObject *parent)
     : QAbstractListModel(parent)
+    , m_voltages(MAX_STORED_READINGS)
+    , m_timestamps(MAX_STORED_READINGS)
+    , m_heartRates(MAX_STORED_READINGS)
+    , m_head(0)
+    , m_count(0)
 {
 }
 
 int EcgDataModel::rowCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent)
-    return m_readings.count();
+    return int(m_count);
 }
 
 QVariant EcgDataModel::data(const QModelIndex &index, int role) const
 {
-    if (!index.isValid() || index.row() >= m_readings.count())
+    if (!index.isValid() || index.row() >= m_count)
         return QVariant();
 
-    const EcgReading &reading = m_readings.at(index.row());
+    const qsizetype i = slot(index.row());
 
     switch (role) {
     case VoltageRole:
-        return reading.voltage;
+        return m_voltages[i];
     case TimestampRole:
-        return static_cast<qint64>(reading.timestamp);
+        return static_cast<qint64>(m_timestamps[i]);
     case HeartRateRole:
-        return reading.heartRate;
+        return int(m_heartRates[i]);
     case DateTimeRole:
-        return reading.dateTime;
+        return QDateTime::fromMSecsSinceEpoch(qint64(m_timestamps[i]));
     case FormattedTimeRole:
-        return reading.dateTime.toString("hh:mm:ss");
+        return QDateTime::fromMSecsSinceEpoch(qint64(m_timestamps[i])).toString("hh:mm:ss");
     default:
         return QVariant();
     }
@@ -48,47 +53,80 @@ QHash<int, QByteArray> EcgDataModel::roleNames() const
 
 void EcgDataModel::addReading(double voltage, quint64 timestamp, int heartRate)
 {
-    // Manage memory by removing old readings
-    if (m_readings.size() >= MAX_STORED_READINGS) {
-        beginRemoveRows(QModelIndex(), 0, 0);
-        m_readings.removeFirst();
-        endRemoveRows();
+    EcgSampleBlock block;
+    block.samples = &voltage;
+    block.count = 1;
+    block.startTime = timestamp;
+    addReadings(block, heartRate);
+}
+
+void EcgDataModel::addReadings(const EcgSampleBlock &block, int heartRate)
+{
+    if (block.count <= 0) {
+        return;
     }
 
-    beginInsertRows(QModelIndex(), m_readings.count(), m_readings.count());
-    
-    EcgReading reading;
-    reading.voltage = voltage;
-    reading.timestamp = timestamp;
-    reading.heartRate = heartRate;
-    reading.dateTime = QDateTime::fromMSecsSinceEpoch(timestamp);
-    
-    m_readings.append(reading);
-    endInsertRows();
+    // Only the newest MAX_STORED_READINGS of a large block can survive
+    qsizetype first = qMax<qsizetype>(0, block.count - MAX_STORED_READINGS);
+    qsizetype incoming = block.count - first;
+
+    const qsizetype oldCount = m_count;
+    const qsizetype newCount = qMin(MAX_STORED_READINGS, m_count + incoming);
+    const qsizetype dropped = m_count + incoming - newCount;
+
+    if (newCount > oldCount) {
+        beginInsertRows(QModelIndex(), int(oldCount), int(newCount - 1));
+    }
+
+    // Write behind the newest reading, over the oldest once full
+    const quint16 rate = quint16(qBound(0, heartRate, 0xFFFF));
+    qsizetype tail = slot(m_count);
+    for (qsizetype i = first; i < block.count; ++i) {
+        m_voltages[tail] = block.samples[i];
+        m_timestamps[tail] = block.timestampAt(i);
+        m_heartRates[tail] = rate;
+        if (++tail == MAX_STORED_READINGS) {
+            tail = 0;
+        }
+    }
+    m_head = slot(dropped);
+    m_count = newCount;
+
+    if (newCount > oldCount) {
+        endInsertRows();
+    }
+
+    // Dropping the oldest shifts every earlier row to a newer reading: one
+    // change notification for all of them instead of a remove per block
+    if (dropped > 0 && oldCount > 0) {
+        emit dataChanged(index(0), index(int(oldCount - 1)));
+    }
 }
 
 void EcgDataModel::clearData()
 {
     beginResetModel();
-    m_readings.clear();
+    m_head = 0;
+    m_count = 0;
     endResetModel();
 }
 
 int EcgDataModel::getReadingCount() const
 {
-    return m_readings.count();
+    return int(m_count);
 }
 
 QVariantMap EcgDataModel::getReading(int index) const
 {
     QVariantMap reading;
-    if (index >= 0 && index < m_readings.count()) {
-        const EcgReading &r = m_readings.at(index);
-        reading["voltage"] = r.voltage;
-        reading["timestamp"] = static_cast<qint64>(r.timestamp);
-        reading["heartRate"] = r.heartRate;
-        reading["dateTime"] = r.dateTime;
-        reading["formattedTime"] = r.dateTime.toString("hh:mm:ss");
+    if (index >= 0 && index < m_count) {
+        const qsizetype i = slot(index);
+        const QDateTime dateTime = QDateTime::fromMSecsSinceEpoch(qint64(m_timestamps[i]));
+        reading["voltage"] = m_voltages[i];
+        reading["timestamp"] = static_cast<qint64>(m_timestamps[i]);
+        reading["heartRate"] = int(m_heartRates[i]);
+        reading["dateTime"] = dateTime;
+        reading["formattedTime"] = dateTime.toString("hh:mm:ss");
     }
     return reading;
 }
@@ -96,9 +134,9 @@ QVariantMap EcgDataModel::getReading(int index) const
 QVariantList EcgDataModel::getRecentReadings(int count) const
 {
     QVariantList recent;
-    int start = qMax(0, m_readings.count() - count);
+    int start = qMax(0, int(m_count) - count);
     
-    for (int i = start; i < m_readings.count(); ++i) {
+    for (int i = start; i < m_count; ++i) {
         recent.append(getReading(i));
     }
     
@@ -5,12 +5,8 @@
 #include <QtQml>
 #include <QtQml/qqmlregistration.h>
 
-struct EcgReading {
-    double voltage;
-    quint64 timestamp;
-    int heartRate;
-    QDateTime dateTime;
-};
+#include "ecgsample.h"
+#include <vector>
 
 class EcgDataModel : public QAbstractListModel
 {
@@ -35,12 +31,24 @@ public:
 
     // Model management
     Q_INVOKABLE void addReading(double voltage, quint64 timestamp, int heartRate = 0);
+    void addReadings(const EcgSampleBlock &block, int heartRate = 0);
     Q_INVOKABLE void clearData();
     Q_INVOKABLE int getReadingCount() const;
     Q_INVOKABLE QVariantMap getReading(int index) const;
     Q_INVOKABLE QVariantList getRecentReadings(int count) const;
 
+    static constexpr qsizetype MAX_STORED_READINGS = 10000;
+
 private:
-    QList<EcgReading> m_readings;
-    static const int MAX_STORED_READINGS = 10000;
+    qsizetype slot(qsizetype row) const { return (m_head + row) % MAX_STORED_READINGS; }
+
+    // Fixed-capacity ring in structure-of-arrays layout, allocated once;
+    // row 0 is the oldest reading, at m_head. Once full, new readings
+    // overwrite the oldest in place. dateTime and formattedTime are derived
+    // from the timestamp when asked for.
+    std::vector<double> m_voltages;
+    std::vector<quint64> m_timestamps;
+    std::vector<quint16> m_heartRates;
+    qsizetype m_head;
+    qsizetype m_count;
 };
@@ -0,0 +1,330 @@
+#include "ecgexporter.h"
+#include "ecgsegment.h"
+#include "ecgfileformats.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QDateTime>
+#include <QTimeZone>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QScopedPointer>
+#include <QList>
+#include <QStringList>
+#include <QtMath>
+#include <charconv>
+#include <cstring>
+
+namespace {
+
+// Formats "yyyy-MM-dd hh:mm:ss.zzz" (UTC), rebuilding the date/time part
+// only when the second changes.
+class TimestampFormatter
+{
+public:
+    int format(quint64 timestamp, char *out)
+    {
+        quint64 second = timestamp / 1000;
+        if (second != m_cachedSecond || m_prefixLength == 0) {
+            QByteArray prefix = QDateTime::fromMSecsSinceEpoch(qint64(second) * 1000, QTimeZone::UTC)
+                                    .toString("yyyy-MM-dd hh:mm:ss.").toLatin1();
+            m_prefixLength = qMin(int(prefix.size()), int(sizeof(m_prefix)));
+            std::memcpy(m_prefix, prefix.constData(), m_prefixLength);
+            m_cachedSecond = second;
+        }
+
+        std::memcpy(out, m_prefix, m_prefixLength);
+        int ms = int(timestamp % 1000);
+        out[m_prefixLength] = char('0' + ms / 100);
+        out[m_prefixLength + 1] = char('0' + (ms / 10) % 10);
+        out[m_prefixLength + 2] = char('0' + ms % 10);
+        return m_prefixLength + 3;
+    }
+
+private:
+    quint64 m_cachedSecond = 0;
+    char m_prefix[32];
+    int m_prefixLength = 0;
+};
+
+// Digits needed to print a value quantised to `scale` without loss
+int decimalsForScale(double scale)
+{
+    if (scale <= 0.0 || scale >= 1.0) {
+        return 0;
+    }
+    return qBound(0, qCeil(-std::log10(scale) - 1e-9), 9);
+}
+
+} // namespace
+
+EcgExporter::EcgExporter(const EcgExportRequest &request, QObject *parent)
+    : QObject(parent)
+    , m_request(request)
+    , m_cancelled(false)
+    , m_lastPercent(-1)
+{
+    setAutoDelete(false);
+}
+
+void EcgExporter::run()
+{
+    QString message;
+    bool success = exportSegments(message);
+    emit finished(success, message);
+}
+
+bool EcgExporter::exportSegments(QString &message)
+{
+    // Private connection for this pool thread, removed once all queries are gone
+    QString connectionName = QString("ecg_export_%1").arg(reinterpret_cast<quintptr>(this), 0, 16);
+    bool success = false;
+
+    {
+        QSqlDatabase database = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        database.setDatabaseName(m_request.databasePath);
+        database.setConnectOptions("QSQLITE_OPEN_READONLY");
+
+        if (!database.open()) {
+            message = "Failed to open database: " + database.lastError().text();
+        } else {
+            QString where = "WHERE 1=1";
+            if (m_request.fromTime > 0) {
+                where += " AND end_time >= :from";
+            }
+            if (m_request.toTime > 0) {
+                where += " AND start_time <= :to";
+            }
+            if (m_request.sessionId > 0) {
+                where += " AND session_id = :session";
+            }
+
+            auto bindFilter = [this](QSqlQuery &query) {
+                if (m_request.fromTime > 0) {
+                    query.bindValue(":from", m_request.fromTime);
+                }
+                if (m_request.toTime > 0) {
+                    query.bindValue(":to", m_request.toTime);
+                }
+                if (m_request.sessionId > 0) {
+                    query.bindValue(":session", m_request.sessionId);
+                }
+            };
+
+            QSqlQuery countQuery(database);
+            countQuery.prepare("SELECT COUNT(*) FROM ecg_segments " + where);
+            bindFilter(countQuery);
+            qint64 totalSegments = (countQuery.exec() && countQuery.next()) ? countQuery.value(0).toLongLong() : 0;
+
+            QSqlQuery query(database);
+            query.setForwardOnly(true);
+            query.prepare(QString("SELECT %1, session_id FROM ecg_segments %2 ORDER BY start_time")
+                          .arg(EcgSegment::SELECT_COLUMNS, where));
+            bindFilter(query);
+
+            if (!query.exec()) {
+                message = "Database query failed: " + query.lastError().text();
+            } else if (ecgFileFormatForPath(m_request.filePath) == EcgFileFormat::Csv) {
+                success = writeCsv(query, totalSegments, message);
+            } else {
+                success = writeBinary(query, totalSegments, message);
+            }
+        }
+    }
+
+    QSqlDatabase::removeDatabase(connectionName);
+    return success;
+}
+
+bool EcgExporter::writeCsv(QSqlQuery &query, qint64 totalSegments, QString &message)
+{
+    QFile file(m_request.filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        message = "Failed to open file for writing";
+        return false;
+    }
+
+    QByteArray chunk;
+    chunk.reserve(WRITE_CHUNK_SIZE + 256);
+    chunk.append("Timestamp,Voltage,HeartRate,DateTime\n");
+
+    TimestampFormatter timestampFormatter;
+    char line[128];
+    char *const lineEnd = line + sizeof(line);
+    qint64 recordCount = 0;
+    qint64 segmentCount = 0;
+    bool writeOk = true;
+
+    while (writeOk && !m_cancelled.load(std::memory_order_relaxed) && query.next()) {
+        EcgSegment segment = EcgSegment::fromQuery(query);
+        int decimals = decimalsForScale(segment.scale);
+
+        qsizetype first, last;
+        selectedRange(segment, first, last);
+        for (qsizetype i = first; i < last; ++i) {
+            quint64 timestamp = segment.sampleTime(i);
+
+            char *p = std::to_chars(line, lineEnd, timestamp).ptr;
+            *p++ = ',';
+            p = std::to_chars(p, lineEnd, segment.voltageAt(i), std::chars_format::fixed, decimals).ptr;
+            *p++ = ',';
+            p = std::to_chars(p, lineEnd, segment.heartRate).ptr;
+            *p++ = ',';
+            p += timestampFormatter.format(timestamp, p);
+            *p++ = '\n';
+
+            chunk.append(line, p - line);
+        }
+        recordCount += last - first;
+
+        if (chunk.size() >= WRITE_CHUNK_SIZE) {
+            writeOk = file.write(chunk) == chunk.size();
+            chunk.resize(0);
+        }
+
+        reportProgress(++segmentCount, totalSegments);
+    }
+
+    if (writeOk && !chunk.isEmpty()) {
+        writeOk = file.write(chunk) == chunk.size();
+    }
+    file.close();
+
+    return finishFile(file, writeOk, recordCount, message);
+}
+
+bool EcgExporter::writeBinary(QSqlQuery &query, qint64 totalSegments, QString &message)
+{
+    QScopedPointer<EcgFileWriter> writer(EcgFileWriter::create(ecgFileFormatForPath(m_request.filePath)));
+    bool opened = false;
+    bool writeOk = true;
+    double sampleRate = 0.0;
+    double scale = 0.0;
+    double nextSampleTime = 0.0; // ms, where the next sample continues the current run
+    qint64 sessionId = m_request.sessionId;
+    qint64 otherSessionSegments = 0;
+    qint64 runCount = 0;
+    qint64 recordCount = 0;
+    qint64 segmentCount = 0;
+    QList<qint16> requantised;
+
+    while (writeOk && !m_cancelled.load(std::memory_order_relaxed) && query.next()) {
+        EcgSegment segment = EcgSegment::fromQuery(query);
+        segment.sessionId = query.value(SESSION_COLUMN).toLongLong();
+        qsizetype first, last;
+        selectedRange(segment, first, last);
+
+        if (last > first) {
+            // The first exported sample fixes the file's rate, scale, start
+            // time and, unless one was requested, session: one signal per file
+            if (!opened) {
+                sampleRate = segment.sampleRate;
+                scale = segment.scale;
+                sessionId = segment.sessionId;
+                if (!writer->open(m_request.filePath, sampleRate, scale, qint64(segment.sampleTime(first)))) {
+                    message = "Failed to open file for writing";
+                    return false;
+                }
+                opened = true;
+                runCount = 1;
+                nextSampleTime = double(segment.sampleTime(first));
+            }
+
+            if (segment.sessionId != sessionId) {
+                ++otherSessionSegments;
+            } else if (!qFuzzyCompare(segment.sampleRate, sampleRate)) {
+                qWarning() << "Skipping segment with sample rate" << segment.sampleRate << "in" << sampleRate << "Hz export";
+            } else {
+                // Pauses and reconnects start a new run instead of being closed up
+                const double startTime = double(segment.sampleTime(first));
+                if (qAbs(startTime - nextSampleTime) > EcgSegmentBuilder::GAP_TOLERANCE_MS) {
+                    writeOk = writer->startRun(qint64(segment.sampleTime(first)));
+                    ++runCount;
+                }
+
+                const qint16 *samples = segment.samples.constData() + first;
+                if (!qFuzzyCompare(segment.scale, scale)) {
+                    requantised.resize(last - first);
+                    for (qsizetype i = first; i < last; ++i) {
+                        requantised[i - first] = qint16(qBound(-32768, qRound(segment.voltageAt(i) / scale), 32767));
+                    }
+                    samples = requantised.constData();
+                }
+                writeOk = writeOk && writer->writeSamples(samples, last - first);
+                recordCount += last - first;
+                nextSampleTime = segment.startTime + last * 1000.0 / segment.sampleRate;
+            }
+        }
+
+        reportProgress(++segmentCount, totalSegments);
+    }
+
+    if (!opened) {
+        message = m_cancelled.load(std::memory_order_relaxed) ? "Export cancelled" : "No samples in the selected range";
+        return false;
+    }
+
+    writeOk = writer->close() && writeOk;
+    if (!writeOk) {
+        message = "Failed to write export file: " + writer->errorString();
+    }
+
+    const QStringList filePaths = writer->filePaths();
+    if (m_cancelled.load(std::memory_order_relaxed)) {
+        for (const QString &path : filePaths) {
+            QFile::remove(path);
+        }
+    }
+
+    QFile file(m_request.filePath);
+    if (!finishFile(file, writeOk, recordCount, message)) {
+        return false;
+    }
+    if (runCount > 1) {
+        message += QString(" (%1 contiguous runs in %2 file(s))").arg(runCount).arg(filePaths.size());
+    }
+    if (otherSessionSegments > 0) {
+        qWarning() << "Binary export of session" << sessionId << "skipped" << otherSessionSegments << "segments of other sessions";
+        message += QString("; session %1 only, other sessions need their own export").arg(sessionId);
+    }
+    return true;
+}
+
+void EcgExporter::selectedRange(const EcgSegment &segment, qsizetype &first, qsizetype &last) const
+{
+    first = 0;
+    last = segment.samples.size();
+    while (first < last && m_request.fromTime > 0 && segment.sampleTime(first) < quint64(m_request.fromTime)) {
+        ++first;
+    }
+    while (last > first && m_request.toTime > 0 && segment.sampleTime(last - 1) > quint64(m_request.toTime)) {
+        --last;
+    }
+}
+
+void EcgExporter::reportProgress(qint64 segmentCount, qint64 totalSegments)
+{
+    int percent = totalSegments > 0 ? int(segmentCount * 100 / totalSegments) : 100;
+    if (percent != m_lastPercent) {
+        m_lastPercent = percent;
+        emit progressChanged(percent / 100.0);
+    }
+}
+
+bool EcgExporter::finishFile(QFile &file, bool writeOk, qint64 recordCount, QString &message)
+{
+    if (m_cancelled.load(std::memory_order_relaxed)) {
+        file.remove();
+        message = "Export cancelled";
+        return false;
+    }
+    if (!writeOk) {
+        if (message.isEmpty()) {
+            message = "Failed to write export file: " + file.errorString();
+        }
+        return false;
+    }
+    message = QString("Exported %1 records successfully").arg(recordCount);
+    return true;
+}
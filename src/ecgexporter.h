@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QObject>
+#include <QRunnable>
+#include <QString>
+#include <atomic>
+
+struct EcgSegment;
+QT_FORWARD_DECLARE_CLASS(QFile)
+QT_FORWARD_DECLARE_CLASS(QSqlQuery)
+
+struct EcgExportRequest {
+    QString filePath;
+    QString databasePath;
+    qint64 fromTime = 0;    // ms since epoch, 0 = from the beginning
+    qint64 toTime = 0;      // ms since epoch, 0 = up to the end
+    qint64 sessionId = 0;   // 0 = all sessions
+};
+
+// Streams stored segments to a file on a QThreadPool thread. The format
+// follows the file extension: CSV (default), EDF+ (.edf) or raw binary
+// (.hmraw). Reads the database through its own connection, formats CSV
+// numbers without locale lookups and writes in large chunks. Progress is
+// reported per segment. A binary file holds one signal, so it covers a
+// single session (the requested one, else that of the first sample) and
+// keeps the gaps between its contiguous runs.
+class EcgExporter : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+public:
+    explicit EcgExporter(const EcgExportRequest &request, QObject *parent = nullptr);
+
+    void run() override;
+    void cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+
+signals:
+    void progressChanged(double progress);
+    void finished(bool success, const QString &message);
+
+private:
+    bool exportSegments(QString &message);
+    bool writeCsv(QSqlQuery &query, qint64 totalSegments, QString &message);
+    bool writeBinary(QSqlQuery &query, qint64 totalSegments, QString &message);
+    void selectedRange(const EcgSegment &segment, qsizetype &first, qsizetype &last) const;
+    void reportProgress(qint64 segmentCount, qint64 totalSegments);
+    bool finishFile(QFile &file, bool writeOk, qint64 recordCount, QString &message);
+
+    EcgExportRequest m_request;
+    std::atomic<bool> m_cancelled;
+    int m_lastPercent;
+
+    static constexpr qsizetype WRITE_CHUNK_SIZE = 256 * 1024;
+    static constexpr int SESSION_COLUMN = 5; // After EcgSegment::SELECT_COLUMNS
+};
@@ -0,0 +1,507 @@
+#include "ecgfileformats.h"
+#include <QDebug>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QtEndian>
+#include <QtMath>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const char RAW_MAGIC[8] = {'H', 'M', 'R', 'A', 'W', '0', '0', '1'};
+constexpr int RAW_HEADER_SIZE = 48;
+constexpr int RAW_SAMPLE_COUNT_OFFSET = 40;
+
+constexpr int EDF_FIXED_HEADER_SIZE = 256;
+constexpr int EDF_SIGNAL_HEADER_SIZE = 256;
+constexpr int EDF_RESERVED_OFFSET = 192;
+constexpr int EDF_RECORD_COUNT_OFFSET = 236;
+const QByteArray EDF_ANNOTATIONS_LABEL = "EDF Annotations";
+
+// EDF header fields are left-justified ASCII padded with spaces
+void appendField(QByteArray &header, const QByteArray &value, int width)
+{
+    QByteArray field = value.left(width);
+    field.append(QByteArray(width - field.size(), ' '));
+    header.append(field);
+}
+
+// Shortest representation that fits an 8-character EDF numeric field
+QByteArray edfNumber(double value)
+{
+    for (int precision = 8; precision > 0; --precision) {
+        QByteArray text = QByteArray::number(value, 'g', precision);
+        if (text.size() <= 8 && !text.contains('e')) {
+            return text;
+        }
+    }
+    return QByteArray::number(qRound64(value));
+}
+
+QByteArray edfField(const uchar *data, qint64 offset, int width)
+{
+    return QByteArray(reinterpret_cast<const char *>(data + offset), width).trimmed();
+}
+
+double unitToVolts(const QByteArray &dimension)
+{
+    QByteArray unit = dimension.trimmed();
+    if (unit == "uV") return 1e-6;
+    if (unit == "mV") return 1e-3;
+    if (unit == "nV") return 1e-9;
+    return 1.0;
+}
+
+} // namespace
+
+EcgFileFormat ecgFileFormatForPath(const QString &filePath)
+{
+    QString suffix = QFileInfo(filePath).suffix().toLower();
+    if (suffix == "edf") {
+        return EcgFileFormat::Edf;
+    }
+    if (suffix == "hmraw" || suffix == "raw" || suffix == "bin") {
+        return EcgFileFormat::Raw;
+    }
+    return EcgFileFormat::Csv;
+}
+
+EcgFileWriter *EcgFileWriter::create(EcgFileFormat format)
+{
+    switch (format) {
+    case EcgFileFormat::Edf:
+        return new EdfEcgWriter;
+    case EcgFileFormat::Raw:
+        return new RawEcgWriter;
+    default:
+        return nullptr;
+    }
+}
+
+// Raw binary writer
+bool RawEcgWriter::open(const QString &filePath, double sampleRate, double scale, qint64 startTime)
+{
+    m_basePath = filePath;
+    m_filePaths.clear();
+    m_header.sampleRate = sampleRate;
+    m_header.scale = scale;
+    return openFile(filePath, startTime);
+}
+
+bool RawEcgWriter::startRun(qint64 startTime)
+{
+    if (!close()) {
+        return false;
+    }
+
+    QFileInfo base(m_basePath);
+    QString name = base.completeBaseName() + "_" + QString::number(m_filePaths.size() + 1);
+    if (!base.suffix().isEmpty()) {
+        name += "." + base.suffix();
+    }
+    return openFile(base.dir().filePath(name), startTime);
+}
+
+bool RawEcgWriter::openFile(const QString &filePath, qint64 startTime)
+{
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    m_filePaths.append(filePath);
+
+    std::memcpy(m_header.magic, RAW_MAGIC, sizeof(RAW_MAGIC));
+    m_header.headerSize = RAW_HEADER_SIZE;
+    m_header.startTime = startTime;
+    m_header.sampleCount = 0;
+
+    uchar header[RAW_HEADER_SIZE] = {};
+    std::memcpy(header, m_header.magic, 8);
+    qToLittleEndian<quint32>(m_header.headerSize, header + 8);
+    qToLittleEndian<quint32>(0, header + 12);
+    qToLittleEndian<double>(m_header.sampleRate, header + 16);
+    qToLittleEndian<double>(m_header.scale, header + 24);
+    qToLittleEndian<qint64>(m_header.startTime, header + 32);
+    qToLittleEndian<quint64>(0, header + RAW_SAMPLE_COUNT_OFFSET);
+
+    return m_file.write(reinterpret_cast<const char *>(header), RAW_HEADER_SIZE) == RAW_HEADER_SIZE;
+}
+
+bool RawEcgWriter::writeSamples(const qint16 *samples, qsizetype count)
+{
+    qint64 bytes = count * qint64(sizeof(qint16));
+    bool ok;
+    if constexpr (QSysInfo::ByteOrder == QSysInfo::LittleEndian) {
+        ok = m_file.write(reinterpret_cast<const char *>(samples), bytes) == bytes;
+    } else {
+        QByteArray buffer(bytes, Qt::Uninitialized);
+        qToLittleEndian<qint16>(samples, count, buffer.data());
+        ok = m_file.write(buffer) == bytes;
+    }
+    m_header.sampleCount += count;
+    return ok;
+}
+
+bool RawEcgWriter::close()
+{
+    uchar count[8];
+    qToLittleEndian<quint64>(m_header.sampleCount, count);
+    bool ok = m_file.seek(RAW_SAMPLE_COUNT_OFFSET)
+              && m_file.write(reinterpret_cast<const char *>(count), 8) == 8;
+    m_file.close();
+    return ok;
+}
+
+// EDF+ writer
+bool EdfEcgWriter::open(const QString &filePath, double sampleRate, double scale, qint64 startTime)
+{
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    m_filePaths = {filePath};
+
+    // One-second data records; the ECG signal carries round(rate) samples each
+    m_headerTime = startTime - startTime % 1000;
+    m_recordOnset = (startTime % 1000) / 1000.0;
+    m_samplesPerRecord = qMax(1, qRound(sampleRate));
+    m_recordCount = 0;
+    m_record.resize(m_samplesPerRecord);
+    m_recordFill = 0;
+    m_discontinuous = false;
+    m_recordBytes.reserve(m_samplesPerRecord * 2 + ANNOTATION_BYTES);
+
+    QDateTime start = QDateTime::fromMSecsSinceEpoch(startTime);
+    const int signalCount = 2;
+
+    double physicalMin = -32768 * scale * 1000.0; // mV
+    double physicalMax = 32767 * scale * 1000.0;
+
+    QByteArray header;
+    header.reserve(EDF_FIXED_HEADER_SIZE + signalCount * EDF_SIGNAL_HEADER_SIZE);
+    appendField(header, "0", 8);
+    appendField(header, "X X X X", 80);
+    appendField(header, "Startdate " + start.toString("dd-MMM-yyyy").toUpper().toLatin1() + " X X HeartMonitor", 80);
+    appendField(header, start.toString("dd.MM.yy").toLatin1(), 8);
+    appendField(header, start.toString("hh.mm.ss").toLatin1(), 8);
+    appendField(header, QByteArray::number(EDF_FIXED_HEADER_SIZE + signalCount * EDF_SIGNAL_HEADER_SIZE), 8);
+    appendField(header, "EDF+C", 44);
+    appendField(header, "-1", 8); // Patched on close
+    appendField(header, "1", 8);
+    appendField(header, QByteArray::number(signalCount), 4);
+
+    appendField(header, "ECG", 16);
+    appendField(header, EDF_ANNOTATIONS_LABEL, 16);
+    appendField(header, "AgAgCl electrode", 80);
+    appendField(header, "", 80);
+    appendField(header, "mV", 8);
+    appendField(header, "", 8);
+    appendField(header, edfNumber(physicalMin), 8);
+    appendField(header, "-1", 8);
+    appendField(header, edfNumber(physicalMax), 8);
+    appendField(header, "1", 8);
+    appendField(header, "-32768", 8);
+    appendField(header, "-32768", 8);
+    appendField(header, "32767", 8);
+    appendField(header, "32767", 8);
+    appendField(header, "", 80);
+    appendField(header, "", 80);
+    appendField(header, QByteArray::number(m_samplesPerRecord), 8);
+    appendField(header, QByteArray::number(ANNOTATION_BYTES / 2), 8);
+    appendField(header, "", 32);
+    appendField(header, "", 32);
+
+    return m_file.write(header) == header.size();
+}
+
+bool EdfEcgWriter::writeSamples(const qint16 *samples, qsizetype count)
+{
+    while (count > 0) {
+        qsizetype n = qMin<qsizetype>(count, m_samplesPerRecord - m_recordFill);
+        std::copy_n(samples, n, m_record.data() + m_recordFill);
+        m_recordFill += n;
+        samples += n;
+        count -= n;
+
+        if (m_recordFill == m_samplesPerRecord && !writeRecord()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool EdfEcgWriter::writeRecord()
+{
+    m_recordBytes.resize(m_samplesPerRecord * 2);
+    qToLittleEndian<qint16>(m_record.constData(), m_samplesPerRecord, m_recordBytes.data());
+
+    // Time-keeping TAL: onset of this record relative to the header start time
+    QByteArray annotation = "+" + QByteArray::number(m_recordOnset, 'f', 3) + "\x14\x14";
+    annotation.append('\0');
+    annotation.append(QByteArray(ANNOTATION_BYTES - annotation.size(), '\0'));
+    m_recordBytes.append(annotation);
+
+    m_recordFill = 0;
+    m_recordCount++;
+    m_recordOnset += 1.0;
+    return m_file.write(m_recordBytes) == m_recordBytes.size();
+}
+
+void EdfEcgWriter::holdLastValue(qsizetype until)
+{
+    if (m_recordFill > 0 && until > m_recordFill) {
+        std::fill(m_record.begin() + m_recordFill, m_record.begin() + until, m_record.at(m_recordFill - 1));
+        m_recordFill = until;
+    }
+}
+
+bool EdfEcgWriter::startRun(qint64 startTime)
+{
+    const double onset = (startTime - m_headerTime) / 1000.0;
+    if (m_recordFill > 0) {
+        // Still inside the current record: bridge the gap, keep the record
+        const qint64 position = qRound64((onset - m_recordOnset) * m_samplesPerRecord);
+        if (position < m_samplesPerRecord) {
+            holdLastValue(position);
+            return true;
+        }
+        holdLastValue(m_samplesPerRecord);
+        if (!writeRecord()) {
+            return false;
+        }
+    }
+
+    if (onset - m_recordOnset >= 0.0005) {
+        m_recordOnset = onset;
+        m_discontinuous = true;
+    }
+    return true;
+}
+
+bool EdfEcgWriter::close()
+{
+    bool ok = true;
+
+    // EDF needs whole records; pad the last one with its final value
+    if (m_recordFill > 0) {
+        holdLastValue(m_samplesPerRecord);
+        ok = writeRecord();
+    }
+
+    QByteArray count = QByteArray::number(m_recordCount).leftJustified(8, ' ', true);
+    ok = ok && m_file.seek(EDF_RECORD_COUNT_OFFSET) && m_file.write(count) == 8;
+    if (m_discontinuous) {
+        ok = ok && m_file.seek(EDF_RESERVED_OFFSET) && m_file.write("EDF+D") == 5;
+    }
+    m_file.close();
+    return ok;
+}
+
+// Memory-mapped reader
+EcgFileReader::~EcgFileReader()
+{
+    close();
+}
+
+bool EcgFileReader::open(const QString &filePath)
+{
+    close();
+
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+
+    m_size = m_file.size();
+    m_data = m_file.map(0, m_size);
+    if (!m_data) {
+        m_error = "Failed to map file: " + m_file.errorString();
+        m_file.close();
+        return false;
+    }
+
+    bool ok = false;
+    if (m_size >= RAW_HEADER_SIZE && std::memcmp(m_data, RAW_MAGIC, sizeof(RAW_MAGIC)) == 0) {
+        ok = parseRaw();
+    } else if (m_size >= EDF_FIXED_HEADER_SIZE && m_data[0] == '0') {
+        ok = parseEdf();
+    } else {
+        m_error = "Unrecognised file format";
+    }
+
+    if (!ok) {
+        close();
+    }
+    return ok;
+}
+
+void EcgFileReader::close()
+{
+    if (m_data) {
+        m_file.unmap(const_cast<uchar *>(m_data));
+        m_data = nullptr;
+    }
+    m_file.close();
+    m_size = 0;
+    m_sampleCount = 0;
+    m_recordOnsets.clear();
+}
+
+bool EcgFileReader::parseRaw()
+{
+    quint32 headerSize = qFromLittleEndian<quint32>(m_data + 8);
+    m_sampleRate = qFromLittleEndian<double>(m_data + 16);
+    m_scale = qFromLittleEndian<double>(m_data + 24);
+    m_offset = 0.0;
+    m_startTime = qFromLittleEndian<qint64>(m_data + 32);
+    quint64 sampleCount = qFromLittleEndian<quint64>(m_data + RAW_SAMPLE_COUNT_OFFSET);
+
+    if (headerSize < RAW_HEADER_SIZE || headerSize > m_size || m_sampleRate <= 0.0) {
+        m_error = "Invalid raw header";
+        return false;
+    }
+
+    // Tolerate truncated files (e.g. the writer never reached close())
+    qint64 available = (m_size - headerSize) / qint64(sizeof(qint16));
+    m_sampleCount = (sampleCount == 0) ? available : qMin<qint64>(sampleCount, available);
+    m_firstSampleOffset = headerSize;
+    m_samplesPerBlock = qMax<qint64>(1, m_sampleCount);
+    m_blockStride = 0;
+    return true;
+}
+
+bool EcgFileReader::parseEdf()
+{
+    qint64 headerBytes = edfField(m_data, 184, 8).toLongLong();
+    qint64 recordCount = edfField(m_data, 236, 8).toLongLong();
+    double recordDuration = edfField(m_data, 244, 8).toDouble();
+    int signalCount = edfField(m_data, 252, 4).toInt();
+
+    if (signalCount <= 0 || headerBytes != EDF_FIXED_HEADER_SIZE + signalCount * EDF_SIGNAL_HEADER_SIZE
+        || headerBytes > m_size || !(recordDuration > 0.0) || !qIsFinite(recordDuration)) {
+        m_error = "Invalid EDF header";
+        return false;
+    }
+
+    // Signal header fields are stored column-wise: all labels, then all transducers, ...
+    auto signalField = [&](int fieldOffset, int width, int signal) {
+        return edfField(m_data, EDF_FIXED_HEADER_SIZE + qint64(fieldOffset) * signalCount + qint64(signal) * width, width);
+    };
+
+    int ecgSignal = -1;
+    int annotationSignal = -1;
+    qint64 recordBytes = 0;
+    qint64 ecgOffset = 0;
+    qint64 annotationOffset = 0;
+    for (int i = 0; i < signalCount; ++i) {
+        qint64 samplesPerRecord = signalField(216, 8, i).toLongLong();
+        if (samplesPerRecord < 0) {
+            m_error = "Invalid EDF signal header";
+            return false;
+        }
+        bool isAnnotation = signalField(0, 16, i) == EDF_ANNOTATIONS_LABEL;
+        if (isAnnotation && annotationSignal < 0) {
+            annotationSignal = i;
+            annotationOffset = recordBytes;
+        } else if (!isAnnotation && ecgSignal < 0) {
+            ecgSignal = i;
+            ecgOffset = recordBytes;
+            m_samplesPerBlock = samplesPerRecord;
+        }
+        recordBytes += samplesPerRecord * 2;
+    }
+
+    if (ecgSignal < 0 || m_samplesPerBlock <= 0) {
+        m_error = "EDF file has no ECG signal";
+        return false;
+    }
+
+    if (recordBytes <= 0) {
+        m_error = "EDF data records are empty";
+        return false;
+    }
+
+    qint64 availableRecords = (m_size - headerBytes) / recordBytes;
+    if (recordCount < 0 || recordCount > availableRecords) {
+        recordCount = availableRecords;
+    }
+
+    double physicalMin = signalField(104, 8, ecgSignal).toDouble();
+    double physicalMax = signalField(112, 8, ecgSignal).toDouble();
+    double digitalMin = signalField(120, 8, ecgSignal).toDouble();
+    double digitalMax = signalField(128, 8, ecgSignal).toDouble();
+    double unit = unitToVolts(signalField(96, 8, ecgSignal));
+    double gain = (digitalMax > digitalMin) ? (physicalMax - physicalMin) / (digitalMax - digitalMin) : 1.0;
+
+    m_scale = gain * unit;
+    m_offset = (physicalMin - digitalMin * gain) * unit;
+    m_sampleRate = m_samplesPerBlock / recordDuration;
+    m_sampleCount = recordCount * m_samplesPerBlock;
+    m_firstSampleOffset = headerBytes + ecgOffset;
+    m_blockStride = recordBytes;
+
+    QByteArray date = edfField(m_data, 168, 8);
+    QByteArray time = edfField(m_data, 176, 8);
+    QDate startDate = QDate::fromString(QString::fromLatin1(date), "dd.MM.yy");
+    if (startDate.isValid() && startDate.year() < 1985) {
+        startDate = startDate.addYears(100); // EDF: yy 85-99 are 19yy, 00-84 are 20yy
+    }
+    QTime startTime = QTime::fromString(QString::fromLatin1(time), "hh.mm.ss");
+    m_startTime = QDateTime(startDate, startTime).toMSecsSinceEpoch();
+
+    // EDF+ keeps record onsets in the time-keeping TALs: the first holds the
+    // sub-second start offset, and in EDF+D each one says where its record starts
+    m_recordOnsets.clear();
+    if (annotationSignal >= 0 && recordCount > 0) {
+        auto recordOnset = [&](qint64 record) -> qint64 {
+            QByteArray tal = edfField(m_data, headerBytes + record * recordBytes + annotationOffset, 16);
+            int end = tal.indexOf('\x14');
+            return (tal.startsWith('+') && end > 1) ? qRound64(tal.mid(1, end - 1).toDouble() * 1000.0) : -1;
+        };
+
+        const qint64 firstOnset = qMax<qint64>(0, recordOnset(0));
+        m_startTime += firstOnset;
+        if (edfField(m_data, EDF_RESERVED_OFFSET, 44).startsWith("EDF+D")) {
+            m_recordOnsets.resize(recordCount);
+            qint64 expected = 0;
+            for (qint64 record = 0; record < recordCount; ++record) {
+                const qint64 onset = recordOnset(record);
+                m_recordOnsets[record] = onset >= 0 ? onset - firstOnset : expected;
+                expected = m_recordOnsets[record] + qRound64(recordDuration * 1000.0);
+            }
+        }
+    }
+
+    return true;
+}
+
+qint64 EcgFileReader::sampleTime(qint64 index) const
+{
+    if (m_recordOnsets.isEmpty()) {
+        return m_startTime + qRound64(index * 1000.0 / m_sampleRate);
+    }
+    const qint64 record = qBound<qint64>(0, index / m_samplesPerBlock, m_recordOnsets.size() - 1);
+    const qint64 within = index - record * m_samplesPerBlock;
+    return m_startTime + m_recordOnsets.at(record) + qRound64(within * 1000.0 / m_sampleRate);
+}
+
+qsizetype EcgFileReader::readSamples(qint64 first, qint16 *out, qsizetype count) const
+{
+    qsizetype copied = 0;
+    while (copied < count && first < m_sampleCount) {
+        qint64 block = first / m_samplesPerBlock;
+        qint64 within = first % m_samplesPerBlock;
+        qsizetype n = std::min<qint64>({qint64(count - copied), m_samplesPerBlock - within, m_sampleCount - first});
+
+        const uchar *source = m_data + m_firstSampleOffset + block * m_blockStride + within * 2;
+        qFromLittleEndian<qint16>(source, n, out + copied);
+
+        copied += n;
+        first += n;
+    }
+    return copied;
+}
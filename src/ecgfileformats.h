@@ -0,0 +1,142 @@
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QStringList>
+#include <QtGlobal>
+
+enum class EcgFileFormat {
+    Csv,
+    Edf,  // EDF+C/EDF+D, one ECG signal plus the EDF Annotations time-keeping signal
+    Raw   // HMRAW header followed by little-endian int16 samples, one file per contiguous run
+};
+
+EcgFileFormat ecgFileFormatForPath(const QString &filePath);
+
+// Layout of the raw binary format. All fields little-endian.
+struct RawEcgHeader {
+    char magic[8];        // "HMRAW001"
+    quint32 headerSize;   // Offset of the first sample
+    quint32 reserved;
+    double sampleRate;    // Hz
+    double scale;         // Volts per LSB
+    qint64 startTime;     // ms since epoch of the first sample
+    quint64 sampleCount;
+};
+
+// Streaming writers for the binary formats. Samples are written straight
+// from stored int16 segments; the sample count is patched in on close().
+// startRun() marks a discontinuity: the samples written after it begin at
+// startTime rather than one sample period after the previous ones.
+class EcgFileWriter
+{
+public:
+    virtual ~EcgFileWriter() = default;
+
+    virtual bool open(const QString &filePath, double sampleRate, double scale, qint64 startTime) = 0;
+    virtual bool writeSamples(const qint16 *samples, qsizetype count) = 0;
+    virtual bool startRun(qint64 startTime) = 0;
+    virtual bool close() = 0;
+
+    QString errorString() const { return m_file.errorString(); }
+    QStringList filePaths() const { return m_filePaths; } // Every file written
+
+    static EcgFileWriter *create(EcgFileFormat format);
+
+protected:
+    QFile m_file;
+    QStringList m_filePaths;
+};
+
+// HMRAW has a single start time, so each run after the first goes to a
+// file of its own: name_2.hmraw, name_3.hmraw, ...
+class RawEcgWriter : public EcgFileWriter
+{
+public:
+    bool open(const QString &filePath, double sampleRate, double scale, qint64 startTime) override;
+    bool writeSamples(const qint16 *samples, qsizetype count) override;
+    bool startRun(qint64 startTime) override;
+    bool close() override;
+
+private:
+    bool openFile(const QString &filePath, qint64 startTime);
+
+    RawEcgHeader m_header = {};
+    QString m_basePath;
+};
+
+// Writes EDF+C, patched to EDF+D on close() if a run did not start where
+// the previous one ended. Every record carries its onset in its
+// time-keeping TAL. A gap shorter than the rest of the current record is
+// held at the last value instead, so records never overlap.
+class EdfEcgWriter : public EcgFileWriter
+{
+public:
+    bool open(const QString &filePath, double sampleRate, double scale, qint64 startTime) override;
+    bool writeSamples(const qint16 *samples, qsizetype count) override;
+    bool startRun(qint64 startTime) override;
+    bool close() override;
+
+private:
+    bool writeRecord();
+    void holdLastValue(qsizetype until);
+
+    qint64 m_headerTime = 0;    // ms since epoch of the header's whole-second start
+    double m_recordOnset = 0.0; // s after m_headerTime of the record being filled
+    int m_samplesPerRecord = 0;
+    qsizetype m_recordFill = 0;
+    qint64 m_recordCount = 0;
+    bool m_discontinuous = false;
+    QList<qint16> m_record;
+    QByteArray m_recordBytes;
+
+    static constexpr int ANNOTATION_BYTES = 64; // Per record, holds one TAL
+};
+
+// Memory-mapped reader for both binary formats.
+class EcgFileReader
+{
+public:
+    ~EcgFileReader();
+
+    bool open(const QString &filePath);
+    void close();
+    QString errorString() const { return m_error; }
+
+    double sampleRate() const { return m_sampleRate; }
+    double scale() const { return m_scale; }       // Volts per LSB
+    double offset() const { return m_offset; }     // Volts at raw value 0
+    qint64 startTime() const { return m_startTime; }
+    qint64 sampleCount() const { return m_sampleCount; }
+    bool isContinuous() const { return m_recordOnsets.isEmpty(); }
+
+    // ms since epoch of a sample, following the record onsets of EDF+D
+    qint64 sampleTime(qint64 index) const;
+
+    // Copies `count` raw samples starting at `first` into `out`
+    qsizetype readSamples(qint64 first, qint16 *out, qsizetype count) const;
+
+private:
+    bool parseRaw();
+    bool parseEdf();
+
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    qint64 m_size = 0;
+    QString m_error;
+
+    double m_sampleRate = 0.0;
+    double m_scale = 0.0;
+    double m_offset = 0.0;
+    qint64 m_startTime = 0;
+    qint64 m_sampleCount = 0;
+
+    // Sample layout: samplesPerBlock contiguous int16 every blockStride bytes
+    qint64 m_firstSampleOffset = 0;
+    qint64 m_samplesPerBlock = 0;
+    qint64 m_blockStride = 0;
+
+    QList<qint64> m_recordOnsets; // EDF+D only: ms after m_startTime of each record
+};
@@ -0,0 +1,139 @@
+#include "ecgfilter.h"
+
+#include <algorithm>
+
+namespace {
+struct StandardDesign {
+    double sampleRate;
+    double mainsHz;
+    EcgFilterDesign::Sections sections;
+};
+
+constexpr StandardDesign standard(double sampleRate, double mainsHz)
+{
+    return {sampleRate, mainsHz, EcgFilterDesign::frontEnd(sampleRate, mainsHz)};
+}
+
+// The device and simulator rates
+constexpr std::array<StandardDesign, 8> STANDARD_DESIGNS = {
+    standard(250.0, 50.0), standard(250.0, 60.0),
+    standard(500.0, 50.0), standard(500.0, 60.0),
+    standard(1000.0, 50.0), standard(1000.0, 60.0),
+    standard(2000.0, 50.0), standard(2000.0, 60.0),
+};
+
+// Unity gain where it should pass, none where it should block
+constexpr double dcGain(const BiquadCoefficients &c)
+{
+    return (c.b0 + c.b1 + c.b2) / (1.0 + c.a1 + c.a2);
+}
+
+constexpr bool checkDesigns()
+{
+    for (const StandardDesign &design : STANDARD_DESIGNS) {
+        const EcgFilterDesign::Sections &s = design.sections;
+        if (EcgFilterDesign::abs(dcGain(s[0])) > 1e-9 || EcgFilterDesign::abs(dcGain(s[1]) - 1.0) > 1e-9
+            || EcgFilterDesign::abs(dcGain(s[2]) - 1.0) > 1e-9 || EcgFilterDesign::abs(dcGain(s[3]) - 1.0) > 1e-9) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(checkDesigns(), "Front-end filter designs lost their DC response");
+}
+
+EcgFrontEndFilter::EcgFrontEndFilter(double sampleRate, double mainsHz, int channels)
+{
+    reset(sampleRate, mainsHz, channels);
+}
+
+void EcgFrontEndFilter::reset(double sampleRate, double mainsHz, int channels)
+{
+    m_sampleRate = sampleRate > 0.0 ? sampleRate : 250.0;
+    m_mainsHz = mainsHz;
+    m_channels = std::clamp(channels, 1, MAX_CHANNELS);
+    m_lanes = (m_channels + LANE_WIDTH - 1) / LANE_WIDTH * LANE_WIDTH;
+
+    const EcgFilterDesign::Sections *design = standardDesign(m_sampleRate, m_mainsHz);
+    m_sections = design ? *design : EcgFilterDesign::frontEnd(m_sampleRate, m_mainsHz);
+    reset();
+}
+
+void EcgFrontEndFilter::reset()
+{
+    std::fill(&m_z1[0][0], &m_z1[0][0] + EcgFilterDesign::SECTIONS * MAX_CHANNELS, 0.0);
+    std::fill(&m_z2[0][0], &m_z2[0][0] + EcgFilterDesign::SECTIONS * MAX_CHANNELS, 0.0);
+    m_primed = false;
+}
+
+const EcgFilterDesign::Sections *EcgFrontEndFilter::standardDesign(double sampleRate, double mainsHz)
+{
+    for (const StandardDesign &design : STANDARD_DESIGNS) {
+        if (design.sampleRate == sampleRate && design.mainsHz == mainsHz) {
+            return &design.sections;
+        }
+    }
+    return nullptr;
+}
+
+void EcgFrontEndFilter::prime(const double *frame)
+{
+    // State of each section after an endless run of this frame
+    for (int c = 0; c < m_channels; ++c) {
+        double x = frame[c];
+        for (int s = 0; s < EcgFilterDesign::SECTIONS; ++s) {
+            const BiquadCoefficients &k = m_sections[s];
+            const double y = dcGain(k) * x;
+            m_z2[s][c] = k.b2 * x - k.a2 * y;
+            m_z1[s][c] = k.b1 * x - k.a1 * y + m_z2[s][c];
+            x = y;
+        }
+    }
+    m_primed = true;
+}
+
+void EcgFrontEndFilter::process(double *samples, std::size_t frames)
+{
+    if (frames == 0) {
+        return;
+    }
+    if (!m_primed) {
+        prime(samples);
+    }
+
+    switch (m_lanes) {
+    case 4: processLanes<4>(samples, frames); break;
+    case 8: processLanes<8>(samples, frames); break;
+    case 12: processLanes<12>(samples, frames); break;
+    default: processLanes<16>(samples, frames); break;
+    }
+}
+
+template <int LANES>
+void EcgFrontEndFilter::processLanes(double *samples, std::size_t frames)
+{
+    static_assert(LANES % LANE_WIDTH == 0 && LANES <= MAX_CHANNELS);
+
+    // Padding lanes run on zeros and stay zero
+    alignas(64) double x[LANES] = {};
+    const int channels = m_channels;
+    for (std::size_t f = 0; f < frames; ++f) {
+        double *frame = samples + f * std::size_t(channels);
+        std::copy_n(frame, channels, x);
+
+        for (int s = 0; s < EcgFilterDesign::SECTIONS; ++s) {
+            const BiquadCoefficients k = m_sections[s];
+            double *z1 = m_z1[s];
+            double *z2 = m_z2[s];
+            for (int l = 0; l < LANES; ++l) {
+                const double in = x[l];
+                const double y = k.b0 * in + z1[l];
+                z1[l] = k.b1 * in - k.a1 * y + z2[l];
+                z2[l] = k.b2 * in - k.a2 * y;
+                x[l] = y;
+            }
+        }
+
+        std::copy_n(x, channels, frame);
+    }
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+// Transposed direct form II biquad, normalised to a0 = 1
+struct BiquadCoefficients {
+    double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+};
+
+// Compile-time filter design (RBJ cookbook biquads). std::sin/std::cos are
+// not constexpr before C++26, so the few values needed come from series
+// that are exact to double precision on [0, pi].
+struct EcgFilterDesign {
+    static constexpr double PI = 3.14159265358979323846;
+
+    static constexpr double sin(double x)
+    {
+        double term = x;
+        double sum = x;
+        for (int n = 1; n < 24; ++n) {
+            term *= -x * x / double((2 * n) * (2 * n + 1));
+            sum += term;
+        }
+        return sum;
+    }
+
+    static constexpr double cos(double x)
+    {
+        double term = 1.0;
+        double sum = 1.0;
+        for (int n = 1; n < 24; ++n) {
+            term *= -x * x / double((2 * n - 1) * (2 * n));
+            sum += term;
+        }
+        return sum;
+    }
+
+    static constexpr double abs(double x) { return x < 0.0 ? -x : x; }
+
+    static constexpr BiquadCoefficients normalise(double b0, double b1, double b2, double a0, double a1, double a2)
+    {
+        return {b0 / a0, b1 / a0, b2 / a0, a1 / a0, a2 / a0};
+    }
+
+    static constexpr BiquadCoefficients lowPass(double cutoff, double sampleRate, double q)
+    {
+        if (cutoff <= 0.0 || cutoff >= 0.45 * sampleRate) {
+            return {};
+        }
+        const double w = 2.0 * PI * cutoff / sampleRate;
+        const double c = cos(w);
+        const double alpha = sin(w) / (2.0 * q);
+        return normalise((1.0 - c) / 2.0, 1.0 - c, (1.0 - c) / 2.0, 1.0 + alpha, -2.0 * c, 1.0 - alpha);
+    }
+
+    static constexpr BiquadCoefficients highPass(double cutoff, double sampleRate, double q)
+    {
+        if (cutoff <= 0.0 || cutoff >= 0.45 * sampleRate) {
+            return {};
+        }
+        const double w = 2.0 * PI * cutoff / sampleRate;
+        const double c = cos(w);
+        const double alpha = sin(w) / (2.0 * q);
+        return normalise((1.0 + c) / 2.0, -(1.0 + c), (1.0 + c) / 2.0, 1.0 + alpha, -2.0 * c, 1.0 - alpha);
+    }
+
+    static constexpr BiquadCoefficients notch(double frequency, double sampleRate, double q)
+    {
+        if (frequency <= 0.0 || frequency >= 0.5 * sampleRate) {
+            return {};
+        }
+        const double w = 2.0 * PI * frequency / sampleRate;
+        const double c = cos(w);
+        const double alpha = sin(w) / (2.0 * q);
+        return normalise(1.0, -2.0 * c, 1.0, 1.0 + alpha, -2.0 * c, 1.0 - alpha);
+    }
+
+    static constexpr int SECTIONS = 4;
+    using Sections = std::array<BiquadCoefficients, SECTIONS>;
+
+    // Monitoring band: 2nd-order Butterworth high-pass (baseline wander),
+    // mains notch, 4th-order Butterworth low-pass (muscle noise)
+    static constexpr Sections frontEnd(double sampleRate, double mainsHz)
+    {
+        return {highPass(HIGH_PASS_HZ, sampleRate, BUTTERWORTH_Q),
+                notch(mainsHz, sampleRate, NOTCH_Q),
+                lowPass(LOW_PASS_HZ, sampleRate, BUTTERWORTH4_Q1),
+                lowPass(LOW_PASS_HZ, sampleRate, BUTTERWORTH4_Q2)};
+    }
+
+    static constexpr double HIGH_PASS_HZ = 0.5;
+    static constexpr double LOW_PASS_HZ = 40.0;
+    static constexpr double NOTCH_Q = 30.0;               // ~1.7 Hz wide at 50 Hz
+    static constexpr double BUTTERWORTH_Q = 0.70710678118654752;
+    static constexpr double BUTTERWORTH4_Q1 = 0.54119610014619698;
+    static constexpr double BUTTERWORTH4_Q2 = 1.30656296487637653;
+};
+
+// Front-end filter between acquisition and analysis: baseline removal, mains
+// notch and band limit as a cascade of EcgFilterDesign::frontEnd() biquads,
+// for one or more interleaved channels (leads). Designs for the standard
+// sample rates and both mains frequencies are computed at compile time;
+// other rates are designed at reset().
+//
+// Channels are processed in lanes: every section updates all channels of a
+// frame with the same straight-line arithmetic over fixed-size arrays, which
+// the compiler turns into SIMD instructions (2 lanes per SSE2/NEON register,
+// 4 per AVX). Doubles, because a 0.5 Hz pole at 2 kHz is too close to the
+// unit circle for float state. The first frame primes the state to the
+// filters' steady state, so a DC offset does not ring through the high-pass.
+class EcgFrontEndFilter
+{
+public:
+    explicit EcgFrontEndFilter(double sampleRate = 250.0, double mainsHz = DEFAULT_MAINS_HZ, int channels = 1);
+
+    void reset(double sampleRate, double mainsHz, int channels);
+    void reset(); // Clears the state; the next frame primes it again
+
+    // In place; samples holds frames * channels() values, frame by frame
+    void process(double *samples, std::size_t frames);
+
+    double sampleRate() const { return m_sampleRate; }
+    double mainsFrequency() const { return m_mainsHz; }
+    int channels() const { return m_channels; }
+    const EcgFilterDesign::Sections &sections() const { return m_sections; }
+
+    // Compile-time design for a standard rate, nullptr for others
+    static const EcgFilterDesign::Sections *standardDesign(double sampleRate, double mainsHz);
+
+    static constexpr double DEFAULT_MAINS_HZ = 50.0;
+    static constexpr int LANE_WIDTH = 4;     // Channels are padded to a multiple of this
+    static constexpr int MAX_CHANNELS = 16;  // 12-lead plus spares
+
+private:
+    template <int LANES>
+    void processLanes(double *samples, std::size_t frames);
+    void prime(const double *frame);
+
+    double m_sampleRate;
+    double m_mainsHz;
+    int m_channels;
+    int m_lanes;
+    bool m_primed;
+    EcgFilterDesign::Sections m_sections;
+
+    // Section state per lane
+    alignas(64) double m_z1[EcgFilterDesign::SECTIONS][MAX_CHANNELS];
+    alignas(64) double m_z2[EcgFilterDesign::SECTIONS][MAX_CHANNELS];
+};
@@ -0,0 +1,213 @@
+#include "ecgframeparser.h"
+
+#include <array>
+#include <bit>
+#include <charconv>
+
+namespace {
+std::uint16_t readU16(const std::uint8_t *p)
+{
+    return std::uint16_t(p[0] | (p[1] << 8));
+}
+
+void appendU16(std::vector<std::uint8_t> &out, std::uint16_t value)
+{
+    out.push_back(std::uint8_t(value));
+    out.push_back(std::uint8_t(value >> 8));
+}
+
+constexpr std::array<std::uint16_t, 256> makeCrcTable()
+{
+    std::array<std::uint16_t, 256> table{};
+    for (unsigned byte = 0; byte < 256; ++byte) {
+        std::uint16_t crc = std::uint16_t(byte << 8);
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = std::uint16_t((crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1);
+        }
+        table[byte] = crc;
+    }
+    return table;
+}
+
+constexpr std::array<std::uint16_t, 256> CRC_TABLE = makeCrcTable();
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+}
+
+EcgFrameParser::EcgFrameParser()
+    : m_haveSequence(false)
+    , m_lastSequence(0)
+    , m_frames(0)
+    , m_samples(0)
+    , m_crcErrors(0)
+    , m_discardedBytes(0)
+    , m_lostFrames(0)
+{
+    // The only allocation; a frame split across reads never needs more
+    m_pending.reserve(MAX_FRAME_SIZE);
+}
+
+void EcgFrameParser::reset()
+{
+    m_pending.clear();
+    m_haveSequence = false;
+    m_frames = 0;
+    m_samples = 0;
+    m_crcErrors = 0;
+    m_discardedBytes = 0;
+    m_lostFrames = 0;
+}
+
+EcgFrameParser::Statistics EcgFrameParser::statistics() const
+{
+    Statistics stats;
+    stats.frames = m_frames.load(std::memory_order_relaxed);
+    stats.samples = m_samples.load(std::memory_order_relaxed);
+    stats.crcErrors = m_crcErrors.load(std::memory_order_relaxed);
+    stats.discardedBytes = m_discardedBytes.load(std::memory_order_relaxed);
+    stats.lostFrames = m_lostFrames.load(std::memory_order_relaxed);
+    return stats;
+}
+
+EcgFrameParser::Result EcgFrameParser::parseFrame(const std::uint8_t *data, std::size_t size,
+                                                  EcgFrame &frame, std::size_t &frameSize)
+{
+    if (size < HEADER_SIZE) {
+        return Result::Incomplete;
+    }
+
+    std::uint8_t format = data[2];
+    std::uint8_t leads = data[3];
+    std::uint16_t count = readU16(data + 6);
+    if ((format != EcgFrame::Int16 && format != EcgFrame::Int24)
+        || leads == 0 || leads > MAX_LEADS
+        || count == 0 || count > MAX_SAMPLES_PER_FRAME) {
+        return Result::Invalid;
+    }
+
+    std::size_t payloadSize = std::size_t(count) * leads * EcgFrame::bytesPerSample(EcgFrame::Format(format));
+    frameSize = HEADER_SIZE + payloadSize + CRC_SIZE;
+    if (size < frameSize) {
+        return Result::Incomplete;
+    }
+
+    std::uint16_t crc = crc16(data + 2, HEADER_SIZE - 2 + payloadSize);
+    if (crc != readU16(data + HEADER_SIZE + payloadSize)) {
+        m_crcErrors.fetch_add(1, std::memory_order_relaxed);
+        return Result::Invalid;
+    }
+
+    std::uint32_t scaleBits = std::uint32_t(data[8]) | (std::uint32_t(data[9]) << 8)
+                              | (std::uint32_t(data[10]) << 16) | (std::uint32_t(data[11]) << 24);
+    frame.sequence = readU16(data + 4);
+    frame.sampleCount = count;
+    frame.leadCount = leads;
+    frame.format = EcgFrame::Format(format);
+    frame.voltsPerLsb = std::bit_cast<float>(scaleBits);
+    frame.payload = data + HEADER_SIZE;
+    return Result::Frame;
+}
+
+void EcgFrameParser::noteFrame(EcgFrame &frame)
+{
+    if (m_haveSequence) {
+        // Wraps naturally; a device restart shows up as one large gap
+        frame.lostBefore = std::uint16_t(frame.sequence - m_lastSequence - 1);
+        if (frame.lostBefore != 0) {
+            m_lostFrames.fetch_add(frame.lostBefore, std::memory_order_relaxed);
+        }
+    }
+    m_haveSequence = true;
+    m_lastSequence = frame.sequence;
+    m_frames.fetch_add(1, std::memory_order_relaxed);
+    m_samples.fetch_add(frame.sampleCount, std::memory_order_relaxed);
+}
+
+void EcgFrameParser::encode(std::vector<std::uint8_t> &out, std::uint16_t sequence, EcgFrame::Format format,
+                            std::uint8_t leadCount, float voltsPerLsb, const std::int32_t *samples, std::size_t sampleCount)
+{
+    std::size_t start = out.size();
+    out.push_back(SYNC_0);
+    out.push_back(SYNC_1);
+    out.push_back(format);
+    out.push_back(leadCount);
+    appendU16(out, sequence);
+    appendU16(out, std::uint16_t(sampleCount));
+
+    std::uint32_t scaleBits = std::bit_cast<std::uint32_t>(voltsPerLsb);
+    for (int shift = 0; shift < 32; shift += 8) {
+        out.push_back(std::uint8_t(scaleBits >> shift));
+    }
+
+    std::size_t values = sampleCount * leadCount;
+    for (std::size_t i = 0; i < values; ++i) {
+        std::uint32_t raw = std::uint32_t(samples[i]);
+        out.push_back(std::uint8_t(raw));
+        out.push_back(std::uint8_t(raw >> 8));
+        if (format == EcgFrame::Int24) {
+            out.push_back(std::uint8_t(raw >> 16));
+        }
+    }
+
+    appendU16(out, crc16(out.data() + start + 2, out.size() - start - 2));
+}
+
+std::uint16_t EcgFrameParser::crc16(const std::uint8_t *data, std::size_t size, std::uint16_t crc)
+{
+    // CRC-16/CCITT-FALSE (poly 0x1021), one table lookup per byte
+    for (std::size_t i = 0; i < size; ++i) {
+        crc = std::uint16_t((crc << 8) ^ CRC_TABLE[(crc >> 8) ^ data[i]]);
+    }
+    return crc;
+}
+
+EcgTextParser::EcgTextParser()
+    : m_discarding(false)
+    , m_invalidLines(0)
+{
+    m_pending.reserve(MAX_LINE_LENGTH);
+}
+
+std::size_t EcgTextParser::parseLine(const char *begin, const char *end, double *values, std::size_t maxValues)
+{
+    while (begin < end && isSpace(*begin)) {
+        ++begin;
+    }
+    while (end > begin && isSpace(end[-1])) {
+        --end;
+    }
+    if (end - begin >= 4 && std::memcmp(begin, "ECG:", 4) == 0) {
+        begin += 4;
+    }
+
+    std::size_t count = 0;
+    while (count < maxValues) {
+        while (begin < end && isSpace(*begin)) {
+            ++begin;
+        }
+        if (begin < end && *begin == '+') {
+            ++begin; // from_chars rejects an explicit plus sign
+        }
+        auto [next, ec] = std::from_chars(begin, end, values[count]);
+        if (ec != std::errc()) {
+            return 0;
+        }
+        ++count;
+
+        begin = next;
+        while (begin < end && isSpace(*begin)) {
+            ++begin;
+        }
+        if (begin == end) {
+            return count;
+        }
+        if (*begin != ',') {
+            return 0;
+        }
+        ++begin;
+    }
+    return 0; // More leads than supported
+}
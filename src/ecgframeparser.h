@@ -0,0 +1,272 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Stream parsers for the two device protocols. Both parse straight from the
+// bytes handed to feed(): complete packets are decoded in place and only an
+// incomplete tail is copied into a fixed buffer allocated once, so there is
+// no per-packet allocation or buffer shifting.
+//
+// Binary frame layout (all fields little-endian):
+//
+//   offset  size  field
+//        0     2  sync word 0xA5 0x5A
+//        2     1  sample format: 1 = int16, 2 = int24
+//        3     1  lead count (1..MAX_LEADS), samples are interleaved by lead
+//        4     2  sequence number, +1 per frame, wrapping
+//        6     2  samples per lead (1..MAX_SAMPLES_PER_FRAME)
+//        8     4  volts per LSB, IEEE float32
+//       12     n  samples
+//     12+n     2  CRC-16/CCITT-FALSE over bytes 2 .. 12+n-1
+//
+// On a bad header or CRC the parser skips to the next sync word.
+
+class EcgFrame
+{
+public:
+    enum Format : std::uint8_t {
+        Int16 = 1,
+        Int24 = 2
+    };
+
+    std::uint16_t sequence = 0;
+    std::uint16_t lostBefore = 0;  // Frames missing just before this one, by sequence number
+    std::uint16_t sampleCount = 0; // Per lead
+    std::uint8_t leadCount = 0;
+    Format format = Int16;
+    float voltsPerLsb = 0.0f;
+    const std::uint8_t *payload = nullptr; // Valid only during the callback
+
+    std::int32_t rawSample(std::size_t index, std::size_t lead) const
+    {
+        const std::uint8_t *p = payload + (index * leadCount + lead) * bytesPerSample(format);
+        if (format == Int16) {
+            return std::int16_t(std::uint16_t(p[0] | (p[1] << 8)));
+        }
+        // Sign-extend 24 bits
+        return std::int32_t(std::uint32_t(p[0] | (p[1] << 8) | (p[2] << 16)) << 8) >> 8;
+    }
+
+    double voltage(std::size_t index, std::size_t lead) const { return rawSample(index, lead) * double(voltsPerLsb); }
+
+    static constexpr std::size_t bytesPerSample(Format format) { return format == Int24 ? 3 : 2; }
+};
+
+class EcgFrameParser
+{
+public:
+    struct Statistics {
+        std::uint64_t frames = 0;
+        std::uint64_t samples = 0;          // Per lead
+        std::uint64_t crcErrors = 0;
+        std::uint64_t discardedBytes = 0;   // Skipped while searching for sync
+        std::uint64_t lostFrames = 0;       // From sequence number gaps
+    };
+
+    EcgFrameParser();
+
+    // Calls onFrame(const EcgFrame &) for every complete, valid frame
+    template <typename OnFrame>
+    void feed(const std::uint8_t *data, std::size_t size, OnFrame &&onFrame);
+
+    void reset();
+    Statistics statistics() const; // Thread-safe
+
+    // Writes one frame; for simulators, tests and device firmware reference
+    static void encode(std::vector<std::uint8_t> &out, std::uint16_t sequence, EcgFrame::Format format,
+                       std::uint8_t leadCount, float voltsPerLsb, const std::int32_t *samples, std::size_t sampleCount);
+
+    static std::uint16_t crc16(const std::uint8_t *data, std::size_t size, std::uint16_t crc = 0xFFFF);
+
+    static constexpr std::uint8_t SYNC_0 = 0xA5;
+    static constexpr std::uint8_t SYNC_1 = 0x5A;
+    static constexpr std::size_t HEADER_SIZE = 12;
+    static constexpr std::size_t CRC_SIZE = 2;
+    static constexpr std::size_t MAX_LEADS = 12;
+    static constexpr std::size_t MAX_SAMPLES_PER_FRAME = 1024;
+    static constexpr std::size_t MAX_FRAME_SIZE = HEADER_SIZE + MAX_SAMPLES_PER_FRAME * MAX_LEADS * 3 + CRC_SIZE;
+
+private:
+    enum class Result { Frame, Incomplete, Invalid };
+
+    // Parses one frame at data (which starts with the sync word)
+    Result parseFrame(const std::uint8_t *data, std::size_t size, EcgFrame &frame, std::size_t &frameSize);
+    void noteFrame(EcgFrame &frame);
+
+    template <typename OnFrame>
+    std::size_t parseAvailable(const std::uint8_t *data, std::size_t size, OnFrame &onFrame);
+
+    std::vector<std::uint8_t> m_pending; // Incomplete tail, capacity MAX_FRAME_SIZE
+    bool m_haveSequence;
+    std::uint16_t m_lastSequence;
+
+    std::atomic<std::uint64_t> m_frames;
+    std::atomic<std::uint64_t> m_samples;
+    std::atomic<std::uint64_t> m_crcErrors;
+    std::atomic<std::uint64_t> m_discardedBytes;
+    std::atomic<std::uint64_t> m_lostFrames;
+};
+
+// Line-oriented text protocol: "ECG:1.234" or "1.234", optionally several
+// comma-separated leads ("0.81,1.02,0.22"), terminated by '\n' (a trailing
+// '\r' is ignored). Numbers are converted with std::from_chars directly on
+// the received bytes.
+class EcgTextParser
+{
+public:
+    EcgTextParser();
+
+    // Calls onLine(const double *values, std::size_t leadCount) per valid line
+    template <typename OnLine>
+    void feed(const char *data, std::size_t size, OnLine &&onLine);
+
+    void reset()
+    {
+        m_pending.clear();
+        m_discarding = false;
+    }
+    std::uint64_t invalidLines() const { return m_invalidLines.load(std::memory_order_relaxed); }
+
+    // Parses one line (without the terminator); returns the number of values
+    static std::size_t parseLine(const char *begin, const char *end, double *values, std::size_t maxValues);
+
+    static constexpr std::size_t MAX_LEADS = EcgFrameParser::MAX_LEADS;
+    static constexpr std::size_t MAX_LINE_LENGTH = 256; // Longer lines are discarded
+
+private:
+    template <typename OnLine>
+    void parse(const char *begin, const char *end, OnLine &onLine);
+
+    std::vector<char> m_pending; // Incomplete last line
+    bool m_discarding;           // Inside an over-long line
+    std::atomic<std::uint64_t> m_invalidLines;
+};
+
+template <typename OnFrame>
+void EcgFrameParser::feed(const std::uint8_t *data, std::size_t size, OnFrame &&onFrame)
+{
+    // Complete the frame left over from the previous read first; once the
+    // pending bytes are used up the rest is parsed from the caller's buffer
+    while (!m_pending.empty() && size > 0) {
+        std::size_t before = m_pending.size();
+        std::size_t take = std::min(size, MAX_FRAME_SIZE - before);
+        m_pending.insert(m_pending.end(), data, data + take);
+
+        std::size_t consumed = parseAvailable(m_pending.data(), m_pending.size(), onFrame);
+        if (consumed >= before) {
+            std::size_t used = consumed - before;
+            data += used;
+            size -= used;
+            m_pending.clear();
+            break;
+        }
+
+        // Still incomplete: keep it all and wait for more
+        m_pending.erase(m_pending.begin(), m_pending.begin() + std::ptrdiff_t(consumed));
+        data += take;
+        size -= take;
+    }
+    if (size == 0) {
+        return;
+    }
+
+    std::size_t consumed = parseAvailable(data, size, onFrame);
+    m_pending.insert(m_pending.end(), data + consumed, data + size);
+}
+
+template <typename OnFrame>
+std::size_t EcgFrameParser::parseAvailable(const std::uint8_t *data, std::size_t size, OnFrame &onFrame)
+{
+    std::size_t cursor = 0;
+    while (cursor < size) {
+        if (data[cursor] != SYNC_0 || (cursor + 1 < size && data[cursor + 1] != SYNC_1)) {
+            // Resynchronise at the next candidate sync byte
+            const void *next = std::memchr(data + cursor + 1, SYNC_0, size - cursor - 1);
+            std::size_t skipTo = next ? std::size_t(static_cast<const std::uint8_t *>(next) - data) : size;
+            m_discardedBytes.fetch_add(skipTo - cursor, std::memory_order_relaxed);
+            cursor = skipTo;
+            continue;
+        }
+
+        EcgFrame frame;
+        std::size_t frameSize = 0;
+        switch (parseFrame(data + cursor, size - cursor, frame, frameSize)) {
+        case Result::Frame:
+            noteFrame(frame);
+            onFrame(frame);
+            cursor += frameSize;
+            break;
+        case Result::Incomplete:
+            return cursor;
+        case Result::Invalid:
+            m_discardedBytes.fetch_add(1, std::memory_order_relaxed);
+            ++cursor;
+            break;
+        }
+    }
+    return cursor;
+}
+
+template <typename OnLine>
+void EcgTextParser::feed(const char *data, std::size_t size, OnLine &&onLine)
+{
+    const char *end = data + size;
+
+    // Finish the line carried over from the previous read
+    if (!m_pending.empty() || m_discarding) {
+        const char *newline = static_cast<const char *>(std::memchr(data, '\n', size));
+        const char *stop = newline ? newline : end;
+        if (!m_discarding) {
+            if (m_pending.size() + std::size_t(stop - data) > MAX_LINE_LENGTH) {
+                m_discarding = true;
+                m_pending.clear();
+            } else {
+                m_pending.insert(m_pending.end(), data, stop);
+            }
+        }
+        if (!newline) {
+            return;
+        }
+
+        if (!m_discarding) {
+            parse(m_pending.data(), m_pending.data() + m_pending.size(), onLine);
+        } else {
+            m_invalidLines.fetch_add(1, std::memory_order_relaxed);
+        }
+        m_pending.clear();
+        m_discarding = false;
+        data = newline + 1;
+    }
+
+    // Whole lines are parsed where they lie
+    while (data < end) {
+        const char *newline = static_cast<const char *>(std::memchr(data, '\n', std::size_t(end - data)));
+        if (!newline) {
+            if (std::size_t(end - data) > MAX_LINE_LENGTH) {
+                m_discarding = true;
+            } else {
+                m_pending.assign(data, end);
+            }
+            return;
+        }
+        parse(data, newline, onLine);
+        data = newline + 1;
+    }
+}
+
+template <typename OnLine>
+void EcgTextParser::parse(const char *begin, const char *end, OnLine &onLine)
+{
+    double values[MAX_LEADS];
+    std::size_t count = parseLine(begin, end, values, MAX_LEADS);
+    if (count > 0) {
+        onLine(static_cast<const double *>(values), count);
+    } else if (begin != end && !(end - begin == 1 && *begin == '\r')) {
+        m_invalidLines.fetch_add(1, std::memory_order_relaxed);
+    }
+}
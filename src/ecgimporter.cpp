@@ -0,0 +1,135 @@
+#include "ecgimporter.h"
+#include "ecgfileformats.h"
+#include "ecgpyramid.h"
+#include "ecgsegment.h"
+
+#include <QDebug>
+#include <QList>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QtMath>
+
+EcgImporter::EcgImporter(const QString &filePath, const QString &databasePath, QObject *parent)
+    : QObject(parent)
+    , m_filePath(filePath)
+    , m_databasePath(databasePath)
+    , m_cancelled(false)
+{
+    setAutoDelete(false);
+}
+
+void EcgImporter::run()
+{
+    QString message;
+    bool success = importFile(message);
+    emit finished(success, message);
+}
+
+bool EcgImporter::importFile(QString &message)
+{
+    EcgFileReader reader;
+    if (!reader.open(m_filePath)) {
+        message = "Failed to open import file: " + reader.errorString();
+        return false;
+    }
+    if (reader.sampleCount() <= 0) {
+        message = "Import file contains no samples";
+        return false;
+    }
+
+    QString connectionName = QString("ecg_import_%1").arg(reinterpret_cast<quintptr>(this), 0, 16);
+    bool success = false;
+
+    {
+        QSqlDatabase database = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        database.setDatabaseName(m_databasePath);
+
+        if (!database.open()) {
+            message = "Failed to open database: " + database.lastError().text();
+        } else {
+            qint64 sampleCount = reader.sampleCount();
+            qint64 endTime = reader.sampleTime(sampleCount - 1);
+
+            // Each import becomes its own recording session
+            QSqlQuery session(database);
+            session.prepare("INSERT INTO ecg_sessions (start_time, end_time) VALUES (?, ?)");
+            session.addBindValue(reader.startTime());
+            session.addBindValue(endTime);
+            qint64 sessionId = session.exec() ? session.lastInsertId().toLongLong() : 0;
+
+            QSqlQuery insert(database);
+            insert.prepare(EcgSegment::INSERT_STATEMENT);
+            EcgPyramidBuilder pyramid(database);
+
+            // Segments store voltage / scale around zero, so keep the file's
+            // quantisation (samples round-trip exactly) when its physical range
+            // is symmetric, and widen it to cover offset +/- 32768 * scale when not
+            const double scale = reader.offset() == 0.0
+                ? reader.scale()
+                : (qAbs(reader.offset()) + 32768.0 * reader.scale()) / 32767.0;
+            EcgSegmentBuilder builder(reader.sampleRate(), scale);
+            QList<EcgSegment> segments;
+            QList<qint16> block(READ_BLOCK_SIZE);
+            qint64 position = 0;
+            int lastPercent = -1;
+            bool ok = sessionId > 0;
+
+            if (!ok) {
+                message = "Failed to create import session: " + session.lastError().text();
+            }
+
+            while (ok && position < sampleCount && !m_cancelled.load(std::memory_order_relaxed)) {
+                qsizetype count = reader.readSamples(position, block.data(), block.size());
+                for (qsizetype i = 0; i < count; ++i) {
+                    // Gaps between EDF+D records split segments in the builder
+                    quint64 timestamp = reader.sampleTime(position + i);
+                    double voltage = reader.offset() + block.at(i) * reader.scale();
+                    builder.append(voltage, timestamp, 0, sessionId, segments);
+                }
+                position += count;
+
+                if (position >= sampleCount) {
+                    builder.finish(segments);
+                }
+
+                if (segments.size() >= SEGMENTS_PER_TRANSACTION || position >= sampleCount) {
+                    database.transaction();
+                    for (const EcgSegment &segment : std::as_const(segments)) {
+                        segment.bindInsert(insert);
+                        if (!insert.exec()) {
+                            message = "Failed to store imported samples: " + insert.lastError().text();
+                            ok = false;
+                            break;
+                        }
+                        pyramid.addSegment(segment);
+                    }
+                    ok = ok && pyramid.save();
+                    ok = ok ? database.commit() : (database.rollback(), false);
+                    if (ok) {
+                        pyramid.markSaved();
+                    }
+                    segments.clear();
+                }
+
+                int percent = int(position * 100 / qMax<qint64>(1, sampleCount));
+                if (percent != lastPercent) {
+                    lastPercent = percent;
+                    emit progressChanged(percent / 100.0);
+                }
+            }
+
+            if (ok && m_cancelled.load(std::memory_order_relaxed)) {
+                message = "Import cancelled after " + QString::number(position) + " samples";
+            } else if (ok) {
+                success = true;
+                message = QString("Imported %1 samples at %2 Hz").arg(sampleCount).arg(reader.sampleRate());
+            } else if (message.isEmpty()) {
+                message = "Failed to commit imported samples: " + database.lastError().text();
+            }
+        }
+    }
+
+    QSqlDatabase::removeDatabase(connectionName);
+    return success;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <QObject>
+#include <QRunnable>
+#include <QString>
+#include <atomic>
+
+// Imports an EDF/EDF+ or raw binary recording into the segment store as a
+// new recording session. Runs on a QThreadPool thread; the file is read
+// through a memory mapping and committed in bounded transactions.
+class EcgImporter : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+public:
+    EcgImporter(const QString &filePath, const QString &databasePath, QObject *parent = nullptr);
+
+    void run() override;
+    void cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+
+signals:
+    void progressChanged(double progress);
+    void finished(bool success, const QString &message);
+
+private:
+    bool importFile(QString &message);
+
+    QString m_filePath;
+    QString m_databasePath;
+    std::atomic<bool> m_cancelled;
+
+    static constexpr qsizetype READ_BLOCK_SIZE = 4096; // Samples per read
+    static constexpr int SEGMENTS_PER_TRANSACTION = 300;
+};
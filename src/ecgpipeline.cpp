@@ -0,0 +1,158 @@
+#include "ecgpipeline.h"
+#include "latencymonitor.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr double MIN_RR_MS = 300.0;  // Same validity range as ArrhythmiaDetector
+constexpr double MAX_RR_MS = 2000.0;
+}
+
+EcgPipeline::EcgPipeline(int streamId, double sampleRate, double mainsHz)
+    : m_streamId(streamId)
+    , m_ring(std::make_unique<EcgSampleRing>())
+    , m_scheduled(false)
+    , m_scheduledAtNs(0)
+    , m_filter(sampleRate, mainsHz)
+    , m_qrsDetector(sampleRate)
+    , m_windowExtractor(sampleRate)
+    , m_latencyMonitor(nullptr)
+    , m_lastBeatTime(0.0)
+    , m_samples(0)
+    , m_beats(0)
+    , m_pvcs(0)
+    , m_pacs(0)
+    , m_runs(0)
+    , m_heartRate(0)
+    , m_latencySumUs(0.0)
+    , m_maxLatencyUs(0.0)
+{
+}
+
+void EcgPipeline::setSampleSink(SampleSink sink)
+{
+    m_sink = std::move(sink);
+}
+
+void EcgPipeline::setLatencyMonitor(LatencyMonitor *monitor)
+{
+    m_latencyMonitor = monitor;
+}
+
+bool EcgPipeline::tryClaim()
+{
+    if (m_scheduled.exchange(true, std::memory_order_acq_rel)) {
+        return false;
+    }
+    m_scheduledAtNs.store(LatencyMonitor::nowNs(), std::memory_order_relaxed);
+    return true;
+}
+
+bool EcgPipeline::run()
+{
+    m_ring->acknowledgeWakeup();
+
+    EcgSample samples[DRAIN_BLOCK_SIZE];
+    double voltages[DRAIN_BLOCK_SIZE];
+    std::size_t count;
+    while ((count = m_ring->pop(samples, DRAIN_BLOCK_SIZE)) > 0) {
+        splitIntoBlocks(samples, voltages, count, MAX_BLOCK_GAP_MS,
+                        [this](const EcgSampleBlock &block) { processBlock(block); });
+    }
+
+    double latencyUs = double(LatencyMonitor::nowNs() - m_scheduledAtNs.load(std::memory_order_relaxed)) / 1000.0;
+    m_latencySumUs.fetch_add(latencyUs, std::memory_order_relaxed);
+    if (latencyUs > m_maxLatencyUs.load(std::memory_order_relaxed)) {
+        m_maxLatencyUs.store(latencyUs, std::memory_order_relaxed);
+    }
+    m_runs.fetch_add(1, std::memory_order_relaxed);
+
+    // Release, then catch samples whose wake-up arrived while we still held
+    // the claim: the producer's request was swallowed, so re-claim ourselves
+    m_scheduled.store(false, std::memory_order_release);
+    m_ring->acknowledgeWakeup();
+    return m_ring->size() > 0 && tryClaim();
+}
+
+void EcgPipeline::processBlock(const EcgSampleBlock &block)
+{
+    const bool timed = m_latencyMonitor && block.arrivalNs > 0;
+    if (timed) {
+        m_latencyMonitor->recordSince(LatencyStage::Ingest, block.arrivalNs);
+    }
+
+    if (m_sink) {
+        m_sink(block, m_heartRate.load(std::memory_order_relaxed));
+    }
+
+    // Blocks come from run(), so never longer than DRAIN_BLOCK_SIZE
+    double filtered[DRAIN_BLOCK_SIZE];
+    std::copy_n(block.samples, block.count, filtered);
+    m_filter.process(filtered, std::size_t(block.count));
+    m_windowExtractor.append(filtered, std::size_t(block.count));
+
+    const double period = 1000.0 / m_qrsDetector.sampleRate();
+    const double firstIndex = double(m_qrsDetector.sampleCount());
+    for (qsizetype i = 0; i < block.count; ++i) {
+        if (!m_qrsDetector.process(filtered[i])) {
+            continue;
+        }
+
+        const std::uint64_t beatIndex = m_qrsDetector.lastBeat().sampleIndex;
+        double beatTime = block.startTime + (double(beatIndex) - firstIndex) * period;
+        double rr = beatTime - m_lastBeatTime;
+        m_lastBeatTime = beatTime;
+        m_beats.fetch_add(1, std::memory_order_relaxed);
+
+        const bool validRR = rr >= MIN_RR_MS && rr <= MAX_RR_MS;
+        m_windowExtractor.addBeat(beatIndex, beatTime, validRR ? rr : 0.0);
+        if (!validRR) {
+            continue;
+        }
+
+        m_hrv.addBeat(beatTime, rr);
+
+        int heartRate = m_heartRate.load(std::memory_order_relaxed);
+        int newHeartRate = int(std::lround(60000.0 / rr));
+        heartRate = heartRate == 0 ? newHeartRate : int(std::lround((heartRate * 3 + newHeartRate) / 4.0));
+        m_heartRate.store(heartRate, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> locker(m_hrvMutex);
+        m_hrvSnapshot = m_hrv.metrics(HrvStatistics::ShortTerm);
+    }
+
+    // Classified inline: a beat costs well under a microsecond, so a worker
+    // hop would cost more than it saves
+    m_windowExtractor.takeReady([this](const BeatWindow &window) {
+        switch (m_beatClassifier.classify(window).type) {
+        case BeatClassifier::Pvc: m_pvcs.fetch_add(1, std::memory_order_relaxed); break;
+        case BeatClassifier::Pac: m_pacs.fetch_add(1, std::memory_order_relaxed); break;
+        default: break;
+        }
+    });
+
+    m_samples.fetch_add(std::uint64_t(block.count), std::memory_order_relaxed);
+    if (timed) {
+        m_latencyMonitor->recordSince(LatencyStage::Detect, block.arrivalNs);
+    }
+}
+
+EcgPipeline::Statistics EcgPipeline::statistics() const
+{
+    Statistics stats;
+    stats.streamId = m_streamId;
+    stats.samples = m_samples.load(std::memory_order_relaxed);
+    stats.beats = m_beats.load(std::memory_order_relaxed);
+    stats.pvcs = m_pvcs.load(std::memory_order_relaxed);
+    stats.pacs = m_pacs.load(std::memory_order_relaxed);
+    stats.runs = m_runs.load(std::memory_order_relaxed);
+    stats.overflows = m_ring->overflowCount();
+    stats.heartRate = m_heartRate.load(std::memory_order_relaxed);
+    stats.meanLatencyUs = stats.runs > 0 ? m_latencySumUs.load(std::memory_order_relaxed) / double(stats.runs) : 0.0;
+    stats.maxLatencyUs = m_maxLatencyUs.load(std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> locker(m_hrvMutex);
+    stats.hrv = m_hrvSnapshot;
+    return stats;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "beatclassifier.h"
+#include "ecgfilter.h"
+#include "ecgsample.h"
+#include "hrvstatistics.h"
+#include "qrsdetector.h"
+
+class LatencyMonitor;
+
+// Processing chain for one ECG stream (one device / patient): front-end
+// filtering, beat detection, beat morphology (PVC/PAC), heart rate and HRV,
+// with optional hand-off of the samples (as acquired) to storage.
+//
+// A producer pushes into ring() and asks the PipelineScheduler to run the
+// pipeline; run() then executes on one pool worker at a time, so the stages
+// need no locking of their own. Statistics can be read from any thread.
+class EcgPipeline
+{
+public:
+    struct Statistics {
+        int streamId = 0;
+        std::uint64_t samples = 0;
+        std::uint64_t beats = 0;
+        std::uint64_t pvcs = 0;
+        std::uint64_t pacs = 0;
+        std::uint64_t runs = 0;
+        std::uint64_t overflows = 0; // Samples the producer could not queue
+        int heartRate = 0;
+        double meanLatencyUs = 0.0;  // From being scheduled to finishing a run
+        double maxLatencyUs = 0.0;
+        HrvMetrics hrv;              // Short-term window
+    };
+
+    // Called from the worker running the pipeline, once per gap-free block
+    using SampleSink = std::function<void(const EcgSampleBlock &block, int heartRate)>;
+
+    explicit EcgPipeline(int streamId, double sampleRate = 250.0,
+                         double mainsHz = EcgFrontEndFilter::DEFAULT_MAINS_HZ);
+
+    int streamId() const { return m_streamId; }
+    double sampleRate() const { return m_qrsDetector.sampleRate(); }
+    EcgSampleRing &ring() { return *m_ring; }
+
+    // Set before samples flow, or while the pipeline is idle
+    void setSampleSink(SampleSink sink);
+    void setLatencyMonitor(LatencyMonitor *monitor); // Ingest and Detect stages
+
+    Statistics statistics() const;
+
+    // Scheduler interface. tryClaim() returns true for exactly one caller
+    // until run() releases the pipeline; run() returns true if it re-claimed
+    // itself because samples arrived while it was finishing.
+    bool tryClaim();
+    bool run();
+
+    static constexpr std::size_t DRAIN_BLOCK_SIZE = 256;
+    static constexpr quint64 MAX_BLOCK_GAP_MS = 100;
+
+private:
+    void processBlock(const EcgSampleBlock &block);
+
+    const int m_streamId;
+    std::unique_ptr<EcgSampleRing> m_ring;
+    std::atomic<bool> m_scheduled;
+    std::atomic<std::int64_t> m_scheduledAtNs;
+
+    // Owned by whichever worker is running the pipeline
+    EcgFrontEndFilter m_filter;
+    QrsDetector m_qrsDetector;
+    BeatWindowExtractor m_windowExtractor;
+    BeatClassifier m_beatClassifier;
+    HrvStatistics m_hrv;
+    SampleSink m_sink;
+    LatencyMonitor *m_latencyMonitor;
+    double m_lastBeatTime;
+
+    // Published results
+    std::atomic<std::uint64_t> m_samples;
+    std::atomic<std::uint64_t> m_beats;
+    std::atomic<std::uint64_t> m_pvcs;
+    std::atomic<std::uint64_t> m_pacs;
+    std::atomic<std::uint64_t> m_runs;
+    std::atomic<int> m_heartRate;
+    std::atomic<double> m_latencySumUs;
+    std::atomic<double> m_maxLatencyUs;
+    mutable std::mutex m_hrvMutex;
+    HrvMetrics m_hrvSnapshot;
+};
@@ -0,0 +1,261 @@
+#include "ecgpyramid.h"
+#include <QDebug>
+#include <QSqlError>
+#include <QtEndian>
+#include <QVariant>
+#include <algorithm>
+
+namespace {
+qint16 quantize(double value)
+{
+    return qint16(qRound(qBound(-32768.0, value / EcgPyramid::SCALE, 32767.0)));
+}
+}
+
+void EcgPyramidBucket::add(double value)
+{
+    min = std::min(min, float(value));
+    max = std::max(max, float(value));
+    sum += value;
+    ++count;
+}
+
+void EcgPyramidBucket::merge(const EcgPyramidBucket &other)
+{
+    if (other.isEmpty()) {
+        return;
+    }
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    sum += other.sum;
+    count += other.count;
+}
+
+QList<EcgPyramidColumn> EcgPyramid::query(QSqlDatabase &database, quint64 startTime, quint64 endTime,
+                                          int columns, qint64 sessionId)
+{
+    QList<EcgPyramidColumn> result;
+    if (columns <= 0 || endTime <= startTime) {
+        return result;
+    }
+
+    const double columnMs = double(endTime - startTime) / columns;
+    const int level = levelFor(columnMs);
+    const int shift = bucketShift(level);
+    const quint64 firstBucket = startTime >> shift;
+    const quint64 lastBucket = (endTime - 1) >> shift;
+
+    QString sql = "SELECT chunk, buckets FROM ecg_pyramid WHERE level = ? AND chunk BETWEEN ? AND ?";
+    if (sessionId >= 0) {
+        sql += " AND session_id = ?";
+    }
+    QSqlQuery query(database);
+    query.setForwardOnly(true);
+    query.prepare(sql);
+    query.addBindValue(level);
+    query.addBindValue(qint64(firstBucket >> CHUNK_SHIFT));
+    query.addBindValue(qint64(lastBucket >> CHUNK_SHIFT));
+    if (sessionId >= 0) {
+        query.addBindValue(sessionId);
+    }
+    if (!query.exec()) {
+        qWarning() << "Failed to read waveform overview:" << query.lastError().text();
+        return result;
+    }
+
+    std::vector<EcgPyramidBucket> merged(columns);
+    std::array<EcgPyramidBucket, CHUNK_BUCKETS> buckets;
+    while (query.next()) {
+        const quint64 chunkStart = quint64(query.value(0).toLongLong()) << CHUNK_SHIFT;
+        buckets.fill(EcgPyramidBucket());
+        unpack(query.value(1).toByteArray(), buckets.data(), CHUNK_BUCKETS);
+
+        for (int b = 0; b < CHUNK_BUCKETS; ++b) {
+            const quint64 bucket = chunkStart + quint64(b);
+            if (buckets[b].isEmpty() || bucket < firstBucket || bucket > lastBucket) {
+                continue;
+            }
+            // A bucket belongs to the column holding its midpoint
+            double middle = double(bucket << shift) + double(bucketMs(level)) / 2.0;
+            int column = qBound(0, int((middle - double(startTime)) / columnMs), columns - 1);
+            merged[column].merge(buckets[b]);
+        }
+    }
+
+    for (int column = 0; column < columns; ++column) {
+        if (merged[column].isEmpty()) {
+            continue;
+        }
+        EcgPyramidColumn out;
+        out.startTime = startTime + quint64(qRound64(column * columnMs));
+        out.endTime = startTime + quint64(qRound64((column + 1) * columnMs));
+        out.summary = merged[column];
+        result.append(out);
+    }
+    return result;
+}
+
+int EcgPyramid::levelFor(double columnMs)
+{
+    int level = 0;
+    while (level + 1 < LEVELS && double(bucketMs(level + 1)) <= columnMs) {
+        ++level;
+    }
+    return level;
+}
+
+QByteArray EcgPyramid::pack(const EcgPyramidBucket *buckets, int count)
+{
+    QByteArray blob(qsizetype(count) * PACKED_BUCKET_SIZE, Qt::Uninitialized);
+    char *out = blob.data();
+    for (int i = 0; i < count; ++i, out += PACKED_BUCKET_SIZE) {
+        const EcgPyramidBucket &bucket = buckets[i];
+        const bool empty = bucket.isEmpty();
+        qToLittleEndian<qint16>(empty ? 0 : quantize(bucket.min), out);
+        qToLittleEndian<qint16>(empty ? 0 : quantize(bucket.max), out + 2);
+        qToLittleEndian<qint16>(empty ? 0 : quantize(bucket.mean()), out + 4);
+        qToLittleEndian<quint32>(bucket.count, out + 6);
+    }
+    return blob;
+}
+
+void EcgPyramid::unpack(const QByteArray &blob, EcgPyramidBucket *buckets, int count)
+{
+    const char *in = blob.constData();
+    count = qMin(count, int(blob.size() / PACKED_BUCKET_SIZE));
+    for (int i = 0; i < count; ++i, in += PACKED_BUCKET_SIZE) {
+        const quint32 samples = qFromLittleEndian<quint32>(in + 6);
+        if (samples == 0) {
+            continue;
+        }
+        EcgPyramidBucket &bucket = buckets[i];
+        bucket.min = float(qFromLittleEndian<qint16>(in) * SCALE);
+        bucket.max = float(qFromLittleEndian<qint16>(in + 2) * SCALE);
+        bucket.sum = qFromLittleEndian<qint16>(in + 4) * SCALE * samples;
+        bucket.count = samples;
+    }
+}
+
+EcgPyramidBuilder::EcgPyramidBuilder(const QSqlDatabase &database)
+    : m_database(database)
+    , m_selectQuery(m_database)
+    , m_saveQuery(m_database)
+    , m_unsaved(false)
+{
+    m_selectQuery.setForwardOnly(true);
+    if (!m_selectQuery.prepare(EcgPyramid::SELECT_CHUNK) || !m_saveQuery.prepare(EcgPyramid::SAVE_CHUNK)) {
+        qWarning() << "Failed to prepare pyramid statements:" << m_database.lastError().text();
+    }
+}
+
+void EcgPyramidBuilder::addSegment(const EcgSegment &segment)
+{
+    if (segment.samples.isEmpty() || segment.sampleRate <= 0.0) {
+        return;
+    }
+
+    SessionChunks &chunks = m_sessions[segment.sessionId];
+    for (qsizetype i = 0; i < segment.samples.size(); ++i) {
+        const quint64 time = segment.sampleTime(i);
+        const double voltage = segment.voltageAt(i);
+        for (int level = 0; level < EcgPyramid::LEVELS; ++level) {
+            const quint64 bucket = time >> EcgPyramid::bucketShift(level);
+            const qint64 index = qint64(bucket >> EcgPyramid::CHUNK_SHIFT);
+            Chunk &chunk = chunks[level];
+            if (chunk.index != index) {
+                openChunk(segment.sessionId, level, index, chunk);
+            }
+            chunk.buckets[bucket & (EcgPyramid::CHUNK_BUCKETS - 1)].add(voltage);
+            chunk.dirty = true;
+        }
+    }
+    m_unsaved = true;
+}
+
+void EcgPyramidBuilder::openChunk(qint64 sessionId, int level, qint64 index, Chunk &chunk)
+{
+    if (chunk.index >= 0 && chunk.dirty) {
+        m_retired.push_back({sessionId, level, chunk});
+    }
+    chunk = Chunk();
+    chunk.index = index;
+
+    // Back to a chunk replaced since the last save (out-of-order segments)
+    for (auto it = m_retired.begin(); it != m_retired.end(); ++it) {
+        if (it->sessionId == sessionId && it->level == level && it->chunk.index == index) {
+            chunk = it->chunk;
+            m_retired.erase(it);
+            return;
+        }
+    }
+
+    // Extend what an earlier run stored
+    m_selectQuery.bindValue(0, sessionId);
+    m_selectQuery.bindValue(1, level);
+    m_selectQuery.bindValue(2, index);
+    if (m_selectQuery.exec() && m_selectQuery.next()) {
+        EcgPyramid::unpack(m_selectQuery.value(0).toByteArray(), chunk.buckets.data(), EcgPyramid::CHUNK_BUCKETS);
+    }
+    m_selectQuery.finish();
+}
+
+bool EcgPyramidBuilder::save()
+{
+    if (!m_unsaved) {
+        return true;
+    }
+
+    // Nothing is marked clean here: the caller rolls back if a write or its
+    // commit fails, and the chunks are written again next time
+    for (const RetiredChunk &retired : m_retired) {
+        if (!saveChunk(retired.sessionId, retired.level, retired.chunk)) {
+            return false;
+        }
+    }
+    for (auto it = m_sessions.cbegin(); it != m_sessions.cend(); ++it) {
+        for (int level = 0; level < EcgPyramid::LEVELS; ++level) {
+            const Chunk &chunk = it.value()[level];
+            if (chunk.index >= 0 && chunk.dirty && !saveChunk(it.key(), level, chunk)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void EcgPyramidBuilder::markSaved()
+{
+    m_retired.clear();
+    for (SessionChunks &chunks : m_sessions) {
+        for (Chunk &chunk : chunks) {
+            chunk.dirty = false;
+        }
+    }
+    m_unsaved = false;
+}
+
+void EcgPyramidBuilder::clear()
+{
+    m_sessions.clear();
+    m_retired.clear();
+    m_unsaved = false;
+}
+
+bool EcgPyramidBuilder::saveChunk(qint64 sessionId, int level, const Chunk &chunk)
+{
+    // Trailing empty buckets are implied
+    int used = EcgPyramid::CHUNK_BUCKETS;
+    while (used > 0 && chunk.buckets[used - 1].isEmpty()) {
+        --used;
+    }
+
+    m_saveQuery.bindValue(0, sessionId);
+    m_saveQuery.bindValue(1, level);
+    m_saveQuery.bindValue(2, chunk.index);
+    m_saveQuery.bindValue(3, EcgPyramid::pack(chunk.buckets.data(), used));
+    if (!m_saveQuery.exec()) {
+        qWarning() << "Failed to save waveform pyramid:" << m_saveQuery.lastError().text();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QtGlobal>
+#include <array>
+#include <limits>
+#include <vector>
+
+#include "ecgsegment.h"
+
+// Min, max and mean of the samples that fell into one pyramid bucket
+struct EcgPyramidBucket {
+    float min = std::numeric_limits<float>::infinity();
+    float max = -std::numeric_limits<float>::infinity();
+    double sum = 0.0;
+    quint32 count = 0;
+
+    void add(double value);
+    void merge(const EcgPyramidBucket &other);
+    bool isEmpty() const { return count == 0; }
+    double mean() const { return count > 0 ? sum / count : 0.0; }
+};
+
+// One display column of an overview query
+struct EcgPyramidColumn {
+    quint64 startTime = 0; // ms since epoch
+    quint64 endTime = 0;
+    EcgPyramidBucket summary;
+};
+
+// Multi-resolution min/max/mean summary of the stored signal, so any time
+// range from seconds to days can be drawn without reading raw segments.
+//
+// Level L buckets are BASE_BUCKET_MS * 4^L wide and aligned to the epoch:
+// bucket i of level L+1 covers buckets 4i..4i+3 of level L, so every level
+// is complete on its own. Buckets are stored per session and level in
+// chunks of CHUNK_BUCKETS, one row of the ecg_pyramid table each, packed as
+// little-endian int16 min/max/mean (at EcgSegmentBuilder::DEFAULT_SCALE)
+// plus a uint32 sample count; trailing empty buckets are not stored.
+class EcgPyramid
+{
+public:
+    // N columns over [startTime, endTime) from the coarsest level whose
+    // buckets are no wider than a column: each column merges at most four
+    // buckets and only the chunks overlapping the range are read. Columns
+    // without data are omitted. sessionId < 0 reads all sessions.
+    static QList<EcgPyramidColumn> query(QSqlDatabase &database, quint64 startTime, quint64 endTime,
+                                         int columns, qint64 sessionId = -1);
+
+    static int levelFor(double columnMs);
+    static int bucketShift(int level) { return BASE_BUCKET_SHIFT + 2 * level; }
+    static quint64 bucketMs(int level) { return quint64(1) << bucketShift(level); }
+
+    static QByteArray pack(const EcgPyramidBucket *buckets, int count);
+    static void unpack(const QByteArray &blob, EcgPyramidBucket *buckets, int count);
+
+    static constexpr int BASE_BUCKET_SHIFT = 6;               // 64 ms
+    static constexpr int LEVELS = 10;                         // Up to 4^9 * 64 ms, ~4.7 h
+    static constexpr int CHUNK_SHIFT = 8;
+    static constexpr int CHUNK_BUCKETS = 1 << CHUNK_SHIFT;    // Per stored row
+    static constexpr int PACKED_BUCKET_SIZE = 10;
+    static constexpr double SCALE = EcgSegmentBuilder::DEFAULT_SCALE;
+
+    static constexpr const char *SELECT_CHUNK =
+        "SELECT buckets FROM ecg_pyramid WHERE session_id = ? AND level = ? AND chunk = ?";
+    static constexpr const char *SAVE_CHUNK =
+        "INSERT OR REPLACE INTO ecg_pyramid (session_id, level, chunk, buckets) VALUES (?, ?, ?, ?)";
+};
+
+// Folds stored segments into the pyramid. Keeps the current chunk of every
+// level per session in memory and extends chunks already in the database
+// (an earlier run, another writer) rather than overwriting them. save()
+// writes what changed since the last save and is meant to run inside the
+// caller's transaction, next to the segments it summarises; markSaved()
+// follows once that transaction has committed.
+class EcgPyramidBuilder
+{
+public:
+    explicit EcgPyramidBuilder(const QSqlDatabase &database);
+
+    void addSegment(const EcgSegment &segment);
+    bool save();
+    void markSaved(); // After the transaction holding save() committed
+    void clear();     // Forgets in-memory chunks; save() first
+    bool hasUnsavedChanges() const { return m_unsaved; }
+
+private:
+    struct Chunk {
+        qint64 index = -1;
+        bool dirty = false;
+        std::array<EcgPyramidBucket, EcgPyramid::CHUNK_BUCKETS> buckets;
+    };
+    struct RetiredChunk {
+        qint64 sessionId;
+        int level;
+        Chunk chunk;
+    };
+    using SessionChunks = std::array<Chunk, EcgPyramid::LEVELS>;
+
+    void openChunk(qint64 sessionId, int level, qint64 index, Chunk &chunk);
+    bool saveChunk(qint64 sessionId, int level, const Chunk &chunk);
+
+    QSqlDatabase m_database;
+    QSqlQuery m_selectQuery;
+    QSqlQuery m_saveQuery;
+    QHash<qint64, SessionChunks> m_sessions;
+    std::vector<RetiredChunk> m_retired; // Replaced by a later chunk, not saved yet
+    bool m_unsaved;
+};
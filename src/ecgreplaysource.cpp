@@ -0,0 +1,194 @@
+#include "ecgreplaysource.h"
+#include "ecgfileformats.h"
+#include "latencymonitor.h"
+
+#include <QDebug>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTimer>
+#include <algorithm>
+
+EcgReplaySource::EcgReplaySource(const QString &source, const QString &databasePath, double speed,
+                                 EcgSampleRing *ring, QObject *parent)
+    : QObject(parent)
+    , m_source(source)
+    , m_databasePath(databasePath)
+    , m_speed(qMax(0.0, speed))
+    , m_ring(ring)
+    , m_sampleRate(0.0)
+    , m_totalSamples(0)
+    , m_pushedSamples(0)
+    , m_running(false)
+    , m_segmentPosition(0)
+    , m_block(MAX_BLOCK)
+{
+    // Created here, so it follows the object to the acquisition thread
+    m_timer = new QTimer(this);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    m_timer->setInterval(m_speed > 0.0 ? TICK_MS : 0);
+    connect(m_timer, &QTimer::timeout, this, &EcgReplaySource::pushDue);
+}
+
+EcgReplaySource::~EcgReplaySource()
+{
+    m_query.reset();
+    if (!m_connectionName.isEmpty()) {
+        QSqlDatabase::removeDatabase(m_connectionName);
+    }
+}
+
+void EcgReplaySource::start()
+{
+    // A plain number names a recorded session, anything else a file
+    QString message;
+    bool isSession = false;
+    qint64 sessionId = m_source.toLongLong(&isSession);
+    bool ok = isSession ? openSession(sessionId, message) : openFile(message);
+    if (!ok) {
+        finish(false, message);
+        return;
+    }
+
+    m_running = true;
+    m_pushedSamples = 0;
+    m_clock.start();
+    m_timer->start();
+    emit started(m_sampleRate, m_totalSamples);
+
+    qDebug() << "Replaying" << m_source << "at" << m_sampleRate << "Hz,"
+             << (m_speed > 0.0 ? QString("%1x").arg(m_speed) : QString("unthrottled"));
+}
+
+void EcgReplaySource::stop()
+{
+    if (m_running) {
+        finish(true, QString("Replay stopped after %1 samples").arg(m_pushedSamples));
+    }
+}
+
+bool EcgReplaySource::openFile(QString &message)
+{
+    m_file = std::make_unique<EcgFileReader>();
+    if (!m_file->open(m_source)) {
+        message = "Failed to open replay file: " + m_file->errorString();
+        return false;
+    }
+
+    m_sampleRate = m_file->sampleRate();
+    m_totalSamples = m_file->sampleCount();
+    m_rawBlock.resize(MAX_BLOCK);
+    return m_sampleRate > 0.0;
+}
+
+bool EcgReplaySource::openSession(qint64 sessionId, QString &message)
+{
+    m_connectionName = QString("ecg_replay_%1").arg(reinterpret_cast<quintptr>(this), 0, 16);
+    QSqlDatabase database = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    database.setDatabaseName(m_databasePath);
+    if (!database.open()) {
+        message = "Failed to open database: " + database.lastError().text();
+        return false;
+    }
+
+    QSqlQuery count(database);
+    count.prepare("SELECT SUM(sample_count), MIN(sample_rate) FROM ecg_segments WHERE session_id = ?");
+    count.addBindValue(sessionId);
+    if (!count.exec() || !count.next() || count.value(0).toLongLong() == 0) {
+        message = QString("Session %1 has no recorded samples").arg(sessionId);
+        return false;
+    }
+    m_totalSamples = count.value(0).toLongLong();
+    m_sampleRate = count.value(1).toDouble();
+
+    m_query = std::make_unique<QSqlQuery>(database);
+    m_query->setForwardOnly(true);
+    m_query->prepare(QString("SELECT %1 FROM ecg_segments WHERE session_id = ? ORDER BY start_time")
+                     .arg(EcgSegment::SELECT_COLUMNS));
+    m_query->addBindValue(sessionId);
+    if (!m_query->exec()) {
+        message = "Database query failed: " + m_query->lastError().text();
+        return false;
+    }
+    return m_sampleRate > 0.0;
+}
+
+qsizetype EcgReplaySource::readSamples(EcgSample *out, qsizetype maxCount)
+{
+    if (m_file) {
+        qsizetype count = m_file->readSamples(m_pushedSamples, m_rawBlock.data(), qMin(maxCount, MAX_BLOCK));
+        for (qsizetype i = 0; i < count; ++i) {
+            out[i].voltage = m_file->offset() + m_rawBlock[i] * m_file->scale();
+            out[i].timestamp = quint64(m_file->sampleTime(m_pushedSamples + i));
+            out[i].sampleIndex = quint64(m_pushedSamples + i);
+        }
+        return count;
+    }
+
+    qsizetype count = 0;
+    while (count < maxCount) {
+        if (m_segmentPosition >= m_segment.samples.size()) {
+            if (!m_query->next()) {
+                break;
+            }
+            m_segment = EcgSegment::fromQuery(*m_query);
+            m_segmentPosition = 0;
+            continue;
+        }
+
+        qsizetype take = qMin(maxCount - count, m_segment.samples.size() - m_segmentPosition);
+        for (qsizetype i = 0; i < take; ++i) {
+            out[count + i].voltage = m_segment.voltageAt(m_segmentPosition + i);
+            out[count + i].timestamp = m_segment.sampleTime(m_segmentPosition + i);
+            out[count + i].sampleIndex = quint64(m_pushedSamples + count + i);
+        }
+        m_segmentPosition += take;
+        count += take;
+    }
+    return count;
+}
+
+void EcgReplaySource::pushDue()
+{
+    // Never overrun the consumer: a replay that falls behind shows up as a
+    // lower realtime factor instead of dropped samples
+    qint64 due = qint64(m_ring->freeSpace());
+    if (m_speed > 0.0) {
+        qint64 target = qint64(double(m_clock.nsecsElapsed()) * m_sampleRate * m_speed / 1e9);
+        due = qMin(due, target - m_pushedSamples);
+    }
+
+    while (due > 0) {
+        qsizetype count = readSamples(m_block.data(), qsizetype(qMin<qint64>(due, MAX_BLOCK)));
+        if (count == 0) {
+            finish(true, QString("Replayed %1 samples").arg(m_pushedSamples));
+            return;
+        }
+
+        const qint64 arrivalNs = LatencyMonitor::nowNs();
+        for (qsizetype i = 0; i < count; ++i) {
+            m_block[i].arrivalNs = arrivalNs;
+        }
+        m_ring->push(m_block.data(), std::size_t(count));
+        m_pushedSamples += count;
+        due -= count;
+        if (m_ring->requestWakeup()) {
+            emit samplesAvailable(arrivalNs);
+        }
+    }
+}
+
+void EcgReplaySource::finish(bool success, const QString &message)
+{
+    m_running = false;
+    m_timer->stop();
+    m_query.reset();
+    m_file.reset();
+
+    if (success) {
+        qDebug() << message;
+    } else {
+        qWarning() << message;
+    }
+    emit finished(success, message);
+}
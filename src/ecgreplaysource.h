@@ -0,0 +1,78 @@
+#pragma once
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QString>
+#include <memory>
+#include <vector>
+
+#include "ecgsample.h"
+#include "ecgsegment.h"
+
+QT_FORWARD_DECLARE_CLASS(QTimer)
+QT_FORWARD_DECLARE_CLASS(QSqlQuery)
+class EcgFileReader;
+
+// Plays a stored recording back into an EcgSampleRing in place of a live
+// device, so it passes through the normal beat, HRV and rhythm pipeline.
+// The source is either an EDF/HMRAW file or a recorded session in the
+// segment store. Timestamps are the recording's own; pacing follows the
+// sample clock at `speed` times real time (gaps are not waited out), and
+// speed 0 pushes as fast as the consumer drains the ring. Lives on the
+// acquisition thread like BluetoothManager.
+class EcgReplaySource : public QObject
+{
+    Q_OBJECT
+
+public:
+    EcgReplaySource(const QString &source, const QString &databasePath, double speed,
+                    EcgSampleRing *ring, QObject *parent = nullptr);
+    ~EcgReplaySource();
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    void started(double sampleRate, qint64 totalSamples);
+    // Ring went from drained to non-empty; wakeupNs is the steady-clock time
+    // of that push, so the consumer can measure end-to-end latency
+    void samplesAvailable(qint64 wakeupNs);
+    void finished(bool success, const QString &message);
+
+private slots:
+    void pushDue();
+
+private:
+    bool openFile(QString &message);
+    bool openSession(qint64 sessionId, QString &message);
+    qsizetype readSamples(EcgSample *out, qsizetype maxCount);
+    void finish(bool success, const QString &message);
+
+    QString m_source;
+    QString m_databasePath;
+    QString m_connectionName;
+    double m_speed;
+    EcgSampleRing *m_ring;
+
+    QTimer *m_timer;
+    QElapsedTimer m_clock;
+    double m_sampleRate;
+    qint64 m_totalSamples;
+    qint64 m_pushedSamples;
+    bool m_running;
+
+    // File source
+    std::unique_ptr<EcgFileReader> m_file;
+    std::vector<qint16> m_rawBlock;
+
+    // Session source: segments are read lazily as the ring drains
+    std::unique_ptr<QSqlQuery> m_query;
+    EcgSegment m_segment;
+    qsizetype m_segmentPosition;
+
+    std::vector<EcgSample> m_block;
+
+    static constexpr int TICK_MS = 10;
+    static constexpr qsizetype MAX_BLOCK = 1024; // Samples per ring push
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <QtGlobal>
+#include <vector>
+#include "spscringbuffer.h"
+
+// One acquired sample as handed from the acquisition thread to processing
+struct EcgSample {
+    double voltage;
+    quint64 timestamp;   // ms since epoch
+    qint64 arrivalNs = 0; // LatencyMonitor::nowNs() when acquired, 0 if unknown
+    quint64 sampleIndex = 0; // Source's sample counter; +1 per sample, jumps where samples were lost
+};
+
+// ~32 s at 250 Hz, ~4 s at 2 kHz
+using EcgSampleRing = SpscRingBuffer<EcgSample, 8192>;
+
+// Non-owning view of contiguous samples on a regular sample clock. The
+// block path lets each pipeline stage pay its fixed costs (signals, locks,
+// model notifications) once per block instead of once per sample.
+struct EcgSampleBlock {
+    const double *samples = nullptr;
+    qsizetype count = 0;
+    double startTime = 0.0;    // ms since epoch of samples[0]
+    double samplePeriod = 0.0; // ms between consecutive samples
+    qint64 arrivalNs = 0;      // Arrival stamp of samples[0], the oldest
+    quint64 startIndex = 0;    // Source sample counter of samples[0]
+
+    double timeAt(qsizetype index) const { return startTime + index * samplePeriod; }
+    quint64 timestampAt(qsizetype index) const { return quint64(qRound64(timeAt(index))); }
+};
+
+// Owning copy of an EcgSampleBlock, for handing a block to another thread
+struct EcgSampleBuffer {
+    std::vector<double> samples;
+    double startTime = 0.0;
+    double samplePeriod = 0.0;
+    qint64 arrivalNs = 0;
+    quint64 startIndex = 0;
+
+    EcgSampleBuffer() = default;
+    explicit EcgSampleBuffer(const EcgSampleBlock &block)
+        : samples(block.samples, block.samples + block.count)
+        , startTime(block.startTime)
+        , samplePeriod(block.samplePeriod)
+        , arrivalNs(block.arrivalNs)
+        , startIndex(block.startIndex)
+    {
+    }
+
+    EcgSampleBlock block() const
+    {
+        EcgSampleBlock view;
+        view.samples = samples.data();
+        view.count = qsizetype(samples.size());
+        view.startTime = startTime;
+        view.samplePeriod = samplePeriod;
+        view.arrivalNs = arrivalNs;
+        view.startIndex = startIndex;
+        return view;
+    }
+};
+
+// Splits samples popped from a ring into EcgSampleBlocks where samples were
+// lost (sample counter jumps), at timestamp gaps larger than maxGapMs and at
+// backwards jumps, and calls process(block) for each. voltages must hold count values; it backs the blocks' sample data.
+template <typename Process>
+void splitIntoBlocks(const EcgSample *samples, double *voltages, std::size_t count, quint64 maxGapMs, Process &&process)
+{
+    std::size_t runStart = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        voltages[i] = samples[i].voltage;
+
+        bool lastInRun = (i + 1 == count)
+            || samples[i + 1].sampleIndex != samples[i].sampleIndex + 1
+            || samples[i + 1].timestamp < samples[i].timestamp
+            || samples[i + 1].timestamp - samples[i].timestamp > maxGapMs;
+        if (!lastInRun) {
+            continue;
+        }
+
+        EcgSampleBlock block;
+        block.samples = voltages + runStart;
+        block.count = qsizetype(i - runStart + 1);
+        block.startTime = double(samples[runStart].timestamp);
+        block.arrivalNs = samples[runStart].arrivalNs;
+        block.startIndex = samples[runStart].sampleIndex;
+        block.samplePeriod = block.count > 1
+            ? double(samples[i].timestamp - samples[runStart].timestamp) / double(block.count - 1)
+            : 0.0;
+        process(block);
+
+        runStart = i + 1;
+    }
+}
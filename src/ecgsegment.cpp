@@ -0,0 +1,102 @@
+#include "ecgsegment.h"
+#include <QtEndian>
+#include <QtMath>
+#include <QSqlQuery>
+#include <QVariant>
+
+quint64 EcgSegment::sampleTime(qsizetype index) const
+{
+    return startTime + static_cast<quint64>(qRound64(index * 1000.0 / sampleRate));
+}
+
+quint64 EcgSegment::endTime() const
+{
+    return samples.isEmpty() ? startTime : sampleTime(samples.size() - 1);
+}
+
+QByteArray EcgSegment::packedSamples() const
+{
+    QByteArray blob(samples.size() * qsizetype(sizeof(qint16)), Qt::Uninitialized);
+    qToLittleEndian<qint16>(samples.constData(), samples.size(), blob.data());
+    return blob;
+}
+
+QList<qint16> EcgSegment::unpackSamples(const QByteArray &blob)
+{
+    QList<qint16> samples(blob.size() / qsizetype(sizeof(qint16)));
+    qFromLittleEndian<qint16>(blob.constData(), samples.size(), samples.data());
+    return samples;
+}
+
+EcgSegment EcgSegment::fromQuery(const QSqlQuery &query)
+{
+    EcgSegment segment;
+    segment.startTime = query.value(0).toULongLong();
+    segment.sampleRate = query.value(1).toDouble();
+    segment.scale = query.value(2).toDouble();
+    segment.heartRate = query.value(3).toInt();
+    segment.samples = unpackSamples(query.value(4).toByteArray());
+    return segment;
+}
+
+void EcgSegment::bindInsert(QSqlQuery &query) const
+{
+    query.bindValue(0, startTime);
+    query.bindValue(1, endTime());
+    query.bindValue(2, sampleRate);
+    query.bindValue(3, scale);
+    query.bindValue(4, samples.size());
+    query.bindValue(5, heartRate > 0 ? heartRate : QVariant());
+    query.bindValue(6, sessionId > 0 ? sessionId : QVariant());
+    query.bindValue(7, packedSamples());
+}
+
+EcgSegmentBuilder::EcgSegmentBuilder(double sampleRate, double scale)
+    : m_sampleRate(sampleRate > 0.0 ? sampleRate : DEFAULT_SAMPLE_RATE)
+    , m_scale(scale)
+    , m_samplesPerSegment(qMax(1, qRound(m_sampleRate * SEGMENT_DURATION_S)))
+{
+}
+
+void EcgSegmentBuilder::append(double voltage, quint64 timestamp, int heartRate, qint64 sessionId, QList<EcgSegment> &completed)
+{
+    if (!m_current.samples.isEmpty()) {
+        double expected = m_current.startTime + m_current.samples.size() * 1000.0 / m_sampleRate;
+        if (sessionId != m_current.sessionId || qAbs(double(timestamp) - expected) > GAP_TOLERANCE_MS) {
+            finish(completed);
+        }
+    }
+
+    if (m_current.samples.isEmpty()) {
+        startSegment(timestamp, sessionId);
+    }
+
+    double raw = qBound(-32768.0, voltage / m_scale, 32767.0);
+    m_current.samples.append(static_cast<qint16>(qRound(raw)));
+    if (heartRate > 0) {
+        m_current.heartRate = heartRate;
+    }
+
+    if (m_current.samples.size() >= m_samplesPerSegment) {
+        finish(completed);
+    }
+}
+
+void EcgSegmentBuilder::finish(QList<EcgSegment> &completed)
+{
+    if (m_current.samples.isEmpty()) {
+        return;
+    }
+    completed.append(std::move(m_current));
+    m_current = EcgSegment();
+}
+
+void EcgSegmentBuilder::startSegment(quint64 timestamp, qint64 sessionId)
+{
+    m_current.startTime = timestamp;
+    m_current.sessionId = sessionId;
+    m_current.sampleRate = m_sampleRate;
+    m_current.scale = m_scale;
+    m_current.heartRate = 0;
+    m_current.samples.reserve(m_samplesPerSegment);
+}
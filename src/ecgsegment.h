@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QtGlobal>
+
+QT_FORWARD_DECLARE_CLASS(QSqlQuery)
+
+// A fixed-duration block of recorded samples. Stored as one row of the
+// ecg_segments table with the samples packed as little-endian int16.
+struct EcgSegment {
+    quint64 startTime = 0;   // ms since epoch of the first sample
+    double sampleRate = 0.0; // Hz
+    double scale = 0.0;      // Volts per LSB
+    int heartRate = 0;
+    qint64 sessionId = 0;    // Recording session, 0 if none
+    QList<qint16> samples;
+
+    quint64 sampleTime(qsizetype index) const;
+    quint64 endTime() const;
+    double voltageAt(qsizetype index) const { return samples.at(index) * scale; }
+
+    QByteArray packedSamples() const;
+    static QList<qint16> unpackSamples(const QByteArray &blob);
+
+    // Reads the current row of a query selecting SELECT_COLUMNS
+    static EcgSegment fromQuery(const QSqlQuery &query);
+    static constexpr const char *SELECT_COLUMNS = "start_time, sample_rate, scale, heart_rate, samples";
+
+    // Binds this segment to a query prepared from INSERT_STATEMENT
+    void bindInsert(QSqlQuery &query) const;
+    static constexpr const char *INSERT_STATEMENT =
+        "INSERT INTO ecg_segments (start_time, end_time, sample_rate, scale, sample_count, heart_rate, session_id, samples) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?)";
+};
+
+// Groups a stream of samples into EcgSegments. A segment is closed when it
+// holds SEGMENT_DURATION_S worth of samples, when the recording session
+// changes, or when a sample arrives too far from its expected position on
+// the sample clock (gap or clock jump).
+class EcgSegmentBuilder
+{
+public:
+    explicit EcgSegmentBuilder(double sampleRate = DEFAULT_SAMPLE_RATE, double scale = DEFAULT_SCALE);
+
+    void append(double voltage, quint64 timestamp, int heartRate, qint64 sessionId, QList<EcgSegment> &completed);
+    void finish(QList<EcgSegment> &completed);
+    bool isEmpty() const { return m_current.samples.isEmpty(); }
+    const EcgSegment &current() const { return m_current; } // The open, partially filled segment
+    double sampleRate() const { return m_sampleRate; }
+
+    static constexpr double DEFAULT_SAMPLE_RATE = 250.0; // Hz
+    static constexpr double DEFAULT_SCALE = 0.0001; // 0.1 mV per LSB, +/-3.27 V range
+    static constexpr double SEGMENT_DURATION_S = 1.0;
+    static constexpr double GAP_TOLERANCE_MS = 100.0;
+
+private:
+    void startSegment(quint64 timestamp, qint64 sessionId);
+
+    EcgSegment m_current;
+    double m_sampleRate;
+    double m_scale;
+    int m_samplesPerSegment;
+};
@@ -0,0 +1,276 @@
+#include "ecgsimulator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+namespace {
+constexpr double PI = 3.14159265358979323846;
+constexpr double FIRST_BEAT_S = 0.3;        // Leaves room for the first P wave
+constexpr double BEAT_EXTENT_BEFORE_S = 0.3; // Waves outside this span are negligible
+constexpr double BEAT_EXTENT_AFTER_S = 0.7;
+constexpr double PVC_PROBABILITY = 0.12;
+constexpr double PVC_COUPLING = 0.6;        // Of the sinus interval
+constexpr double FIBRILLATION_HZ = 6.0;
+constexpr double WANDER_HZ = 0.3;
+constexpr double RESPIRATION_HZ = 0.25;
+
+struct Wave {
+    double amplitude; // mV
+    double centre;    // s from the R peak
+    double width;     // s, Gaussian sigma
+};
+
+// Lead II-like morphology; T wave position is scaled with sqrt(RR) below
+constexpr Wave P_WAVE = {0.15, -0.16, 0.025};
+constexpr Wave SINUS_QRST[] = {
+    {-0.12, -0.025, 0.010},
+    { 1.00,  0.000, 0.010},
+    {-0.25,  0.025, 0.010},
+    { 0.30,  0.260, 0.045},
+};
+constexpr Wave VENTRICULAR_QRST[] = {
+    { 1.10,  0.000, 0.030},
+    {-0.35,  0.060, 0.030},
+    {-0.35,  0.320, 0.070},
+};
+
+inline double gaussian(const Wave &wave, double dt, double centre)
+{
+    const double x = (dt - centre) / wave.width;
+    return wave.amplitude * std::exp(-0.5 * x * x);
+}
+
+struct RhythmName {
+    const char *name;
+    EcgSimulator::Rhythm rhythm;
+};
+
+constexpr RhythmName RHYTHM_NAMES[] = {
+    {"normal", EcgSimulator::NormalSinus},
+    {"brady", EcgSimulator::Bradycardia},
+    {"tachy", EcgSimulator::Tachycardia},
+    {"afib", EcgSimulator::AtrialFibrillation},
+    {"pvc", EcgSimulator::Pvc},
+};
+}
+
+EcgSimulator::EcgSimulator(double sampleRate, std::uint32_t seed)
+    : m_sampleRate(std::clamp(sampleRate, MIN_SAMPLE_RATE, MAX_SAMPLE_RATE))
+    , m_sampleIndex(0)
+    , m_startTimeMs(0)
+    , m_scriptLength(0.0)
+    , m_rhythm(NormalSinus)
+    , m_pendingCompensation(false)
+    , m_amplitude(1.0)
+    , m_noise(0.02)
+    , m_fibrillationPhase(0.0)
+    , m_random(seed)
+    , m_uniform(0.0, 1.0)
+    , m_gaussian(0.0, 1.0)
+{
+    m_script.push_back({NormalSinus, 0.0});
+    reset(0);
+}
+
+void EcgSimulator::reset(quint64 startTimeMs)
+{
+    m_startTimeMs = startTimeMs;
+    m_sampleIndex = 0;
+    m_pendingCompensation = false;
+    m_fibrillationPhase = 0.0;
+
+    m_rhythm = rhythmAt(0.0);
+    m_previousBeat = Beat{-1000.0, 0.0, false, false};
+    m_nextBeat = Beat{FIRST_BEAT_S, FIRST_BEAT_S, false, m_rhythm != AtrialFibrillation};
+}
+
+void EcgSimulator::setSampleRate(double sampleRate)
+{
+    m_sampleRate = std::clamp(sampleRate, MIN_SAMPLE_RATE, MAX_SAMPLE_RATE);
+}
+
+void EcgSimulator::setRhythm(Rhythm rhythm)
+{
+    setScript({{rhythm, 0.0}});
+}
+
+void EcgSimulator::setScript(const std::vector<Step> &script)
+{
+    if (script.empty()) {
+        return;
+    }
+
+    m_script = script;
+    m_scriptLength = 0.0;
+    for (const Step &step : m_script) {
+        if (step.seconds <= 0.0) {
+            m_scriptLength = 0.0; // Open-ended: the script never loops
+            break;
+        }
+        m_scriptLength += step.seconds;
+    }
+}
+
+EcgSimulator::Rhythm EcgSimulator::rhythmAt(double seconds) const
+{
+    if (m_scriptLength > 0.0) {
+        seconds = std::fmod(seconds, m_scriptLength);
+    }
+    for (const Step &step : m_script) {
+        if (step.seconds <= 0.0 || seconds < step.seconds) {
+            return step.rhythm;
+        }
+        seconds -= step.seconds;
+    }
+    return m_script.back().rhythm;
+}
+
+EcgSimulator::Rhythm EcgSimulator::currentRhythm() const
+{
+    return rhythmAt(double(m_sampleIndex) / m_sampleRate);
+}
+
+void EcgSimulator::scheduleNextBeat()
+{
+    m_previousBeat = m_nextBeat;
+    const double t = m_previousBeat.rTime;
+    m_rhythm = rhythmAt(t);
+
+    const double respiration = std::sin(2.0 * PI * RESPIRATION_HZ * t);
+    const double jitter = uniform() - 0.5;
+
+    Beat beat;
+    switch (m_rhythm) {
+    case NormalSinus:
+        beat.rr = 60.0 / 72.0 * (1.0 + 0.05 * respiration + 0.02 * jitter);
+        break;
+    case Bradycardia:
+        beat.rr = 60.0 / 45.0 * (1.0 + 0.03 * respiration + 0.02 * jitter);
+        break;
+    case Tachycardia:
+        beat.rr = 60.0 / 130.0 * (1.0 + 0.01 * respiration + 0.01 * jitter);
+        break;
+    case AtrialFibrillation:
+        beat.rr = 0.6 * (0.6 + 0.8 * uniform());
+        beat.hasP = false;
+        break;
+    case Pvc: {
+        const double sinus = 60.0 / 75.0 * (1.0 + 0.02 * jitter);
+        if (m_pendingCompensation) {
+            beat.rr = 2.0 * sinus - m_previousBeat.rr; // Full compensatory pause
+            m_pendingCompensation = false;
+        } else if (!m_previousBeat.ventricular && uniform() < PVC_PROBABILITY) {
+            beat.rr = PVC_COUPLING * sinus;
+            beat.ventricular = true;
+            beat.hasP = false;
+            m_pendingCompensation = true;
+        } else {
+            beat.rr = sinus;
+        }
+        break;
+    }
+    }
+
+    if (m_rhythm != Pvc) {
+        m_pendingCompensation = false;
+    }
+    beat.rTime = t + beat.rr;
+    m_nextBeat = beat;
+}
+
+double EcgSimulator::beatValue(const Beat &beat, double t) const
+{
+    const double dt = t - beat.rTime;
+    if (dt < -BEAT_EXTENT_BEFORE_S || dt > BEAT_EXTENT_AFTER_S) {
+        return 0.0;
+    }
+
+    double value = 0.0;
+    if (beat.ventricular) {
+        for (const Wave &wave : VENTRICULAR_QRST) {
+            value += gaussian(wave, dt, wave.centre);
+        }
+        return value;
+    }
+
+    if (beat.hasP) {
+        value += gaussian(P_WAVE, dt, P_WAVE.centre);
+    }
+    const double tScale = std::sqrt(std::max(beat.rr, 0.3)); // Bazett-like QT
+    for (const Wave &wave : SINUS_QRST) {
+        const double centre = wave.centre > 0.1 ? wave.centre * tScale : wave.centre;
+        value += gaussian(wave, dt, centre);
+    }
+    return value;
+}
+
+void EcgSimulator::generate(EcgSample *out, std::size_t count)
+{
+    const double period = 1.0 / m_sampleRate;
+    const double fibrillationStep = 2.0 * PI * FIBRILLATION_HZ * period;
+
+    for (std::size_t i = 0; i < count; ++i, ++m_sampleIndex) {
+        const double t = double(m_sampleIndex) * period;
+        while (t >= m_nextBeat.rTime) {
+            scheduleNextBeat();
+        }
+
+        double value = beatValue(m_previousBeat, t) + beatValue(m_nextBeat, t);
+        value += 0.05 * std::sin(2.0 * PI * WANDER_HZ * t);
+        if (m_rhythm == AtrialFibrillation) {
+            m_fibrillationPhase += fibrillationStep * (1.0 + 0.2 * (uniform() - 0.5));
+            value += 0.04 * std::sin(m_fibrillationPhase);
+        }
+
+        out[i].voltage = m_amplitude * value + m_noise * m_gaussian(m_random);
+        out[i].timestamp = m_startTimeMs + quint64(std::llround(t * 1000.0));
+        out[i].sampleIndex = m_sampleIndex;
+    }
+}
+
+bool EcgSimulator::parseScript(const std::string &text, std::vector<Step> &script)
+{
+    std::vector<Step> parsed;
+    std::istringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        const std::size_t colon = item.find(':');
+        const std::string name = item.substr(0, colon);
+
+        Step step{NormalSinus, 0.0};
+        const auto found = std::find_if(std::begin(RHYTHM_NAMES), std::end(RHYTHM_NAMES),
+                                        [&name](const RhythmName &entry) { return name == entry.name; });
+        if (found == std::end(RHYTHM_NAMES)) {
+            return false;
+        }
+        step.rhythm = found->rhythm;
+
+        if (colon != std::string::npos) {
+            char *end = nullptr;
+            const std::string seconds = item.substr(colon + 1);
+            step.seconds = std::strtod(seconds.c_str(), &end);
+            if (end == seconds.c_str() || *end != '\0' || step.seconds <= 0.0) {
+                return false;
+            }
+        }
+        parsed.push_back(step);
+    }
+
+    if (parsed.empty()) {
+        return false;
+    }
+    script = std::move(parsed);
+    return true;
+}
+
+const char *EcgSimulator::rhythmName(Rhythm rhythm)
+{
+    for (const RhythmName &entry : RHYTHM_NAMES) {
+        if (entry.rhythm == rhythm) {
+            return entry.name;
+        }
+    }
+    return "unknown";
+}
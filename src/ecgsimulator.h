@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ecgsample.h"
+
+// Synthetic ECG driven by a sample counter rather than a wall clock: sample
+// n is stamped startTime + n / sampleRate, so timestamps are exact and
+// regular at any rate and the caller decides the pacing (real time on a
+// timer, or as fast as the consumer drains). Beats are sums of Gaussian
+// P/Q/R/S/T waves; the rhythm follows a looping script of timed steps.
+class EcgSimulator
+{
+public:
+    enum Rhythm {
+        NormalSinus,        // ~72 bpm with respiratory sinus arrhythmia
+        Bradycardia,        // ~45 bpm
+        Tachycardia,        // ~130 bpm
+        AtrialFibrillation, // Irregularly irregular ~100 bpm, no P waves
+        Pvc                 // Sinus with premature wide ventricular beats
+    };
+
+    struct Step {
+        Rhythm rhythm;
+        double seconds; // <= 0: stay in this rhythm forever
+    };
+
+    explicit EcgSimulator(double sampleRate = 250.0, std::uint32_t seed = 1);
+
+    // Restarts the sample clock at startTimeMs (ms since epoch)
+    void reset(quint64 startTimeMs);
+
+    // Clamped to MIN/MAX_SAMPLE_RATE; takes effect at the next reset()
+    void setSampleRate(double sampleRate);
+    void setRhythm(Rhythm rhythm);
+    void setScript(const std::vector<Step> &script);
+    void setAmplitude(double amplitude) { m_amplitude = amplitude; }
+    void setNoise(double noise) { m_noise = noise; }
+
+    // Fills out with the next count samples
+    void generate(EcgSample *out, std::size_t count);
+
+    double sampleRate() const { return m_sampleRate; }
+    std::uint64_t sampleIndex() const { return m_sampleIndex; }
+    Rhythm currentRhythm() const;
+
+    // "normal", "brady", "tachy", "afib", "pvc", or a script such as
+    // "normal:60,afib:30,pvc:60" (seconds per step, looping)
+    static bool parseScript(const std::string &text, std::vector<Step> &script);
+    static const char *rhythmName(Rhythm rhythm);
+
+    static constexpr double MIN_SAMPLE_RATE = 250.0;
+    static constexpr double MAX_SAMPLE_RATE = 2000.0;
+
+private:
+    struct Beat {
+        double rTime = 0.0; // s since reset
+        double rr = 0.0;    // s from the previous beat
+        bool ventricular = false;
+        bool hasP = true;
+    };
+
+    Rhythm rhythmAt(double seconds) const;
+    void scheduleNextBeat();
+    double beatValue(const Beat &beat, double t) const;
+    double uniform() { return m_uniform(m_random); }
+
+    double m_sampleRate;
+    std::uint64_t m_sampleIndex;
+    quint64 m_startTimeMs;
+
+    std::vector<Step> m_script;
+    double m_scriptLength;      // s per loop, 0 if the last step is open-ended
+
+    Beat m_previousBeat;
+    Beat m_nextBeat;
+    Rhythm m_rhythm;            // Of the interval being generated
+    bool m_pendingCompensation; // A PVC was placed; the next interval pays it back
+
+    double m_amplitude;
+    double m_noise;
+    double m_fibrillationPhase;
+    std::mt19937 m_random;
+    std::uniform_real_distribution<double> m_uniform;
+    std::normal_distribution<double> m_gaussian;
+};
@@ -0,0 +1,372 @@
+#include "ecgstoragewriter.h"
+#include "ecgpyramid.h"
+#include "latencymonitor.h"
+#include <QDebug>
+#include <QTimer>
+#include <QSqlError>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QVariant>
+
+EcgStorageWriter::EcgStorageWriter(const QString &databasePath, QObject *parent)
+    : QObject(parent)
+    , m_databasePath(databasePath)
+    , m_connectionName(QString("ecg_writer_%1").arg(reinterpret_cast<quintptr>(this), 0, 16))
+    , m_insertQuery(nullptr)
+    , m_flushTimer(nullptr)
+    , m_latencyMonitor(nullptr)
+    , m_oldestUncommittedArrivalNs(0)
+    , m_flushRequested(false)
+    , m_queueCapacity(DEFAULT_QUEUE_CAPACITY)
+    , m_queueDepth(0)
+    , m_lastCommitLatencyUs(0)
+    , m_maxCommitLatencyUs(0)
+    , m_writtenSamples(0)
+    , m_droppedSamples(0)
+{
+    m_queue.reserve(MAX_BATCH_SIZE);
+}
+
+EcgStorageWriter::~EcgStorageWriter()
+{
+    close();
+}
+
+qsizetype EcgStorageWriter::enqueueBlock(const EcgSampleBlock &block, double sampleRate, int heartRate, qint64 sessionId)
+{
+    if (!(sampleRate > 0.0)) {
+        sampleRate = EcgSegmentBuilder::DEFAULT_SAMPLE_RATE;
+    }
+
+    qsizetype accepted = 0;
+    int depth = 0;
+    {
+        QMutexLocker locker(&m_queueMutex);
+        qsizetype capacity = m_queueCapacity.load(std::memory_order_relaxed);
+        accepted = qBound<qsizetype>(0, capacity - m_queue.size(), block.count);
+        for (qsizetype i = 0; i < accepted; ++i) {
+            m_queue.append({block.samples[i], block.timestampAt(i), heartRate, sessionId, block.arrivalNs, sampleRate});
+        }
+        depth = m_queue.size();
+    }
+    m_queueDepth.store(depth, std::memory_order_relaxed);
+
+    if (accepted < block.count) {
+        m_droppedSamples.fetch_add(block.count - accepted, std::memory_order_relaxed);
+    }
+
+    if (depth >= MAX_BATCH_SIZE && !m_flushRequested.exchange(true)) {
+        QMetaObject::invokeMethod(this, &EcgStorageWriter::flush, Qt::QueuedConnection);
+    }
+    return accepted;
+}
+
+bool EcgStorageWriter::enqueue(double voltage, quint64 timestamp, double sampleRate, int heartRate, qint64 sessionId)
+{
+    EcgSampleBlock block;
+    block.samples = &voltage;
+    block.count = 1;
+    block.startTime = timestamp;
+    return enqueueBlock(block, sampleRate, heartRate, sessionId) == 1;
+}
+
+void EcgStorageWriter::open()
+{
+    m_database = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    m_database.setDatabaseName(m_databasePath);
+
+    if (!m_database.open()) {
+        QString message = "Failed to open database for writing: " + m_database.lastError().text();
+        qWarning() << message;
+        emit error(message);
+        return;
+    }
+
+    // WAL lets readers (export, history) run while we append;
+    // NORMAL sync is durable across application crashes in WAL mode.
+    QSqlQuery pragma(m_database);
+    pragma.exec("PRAGMA journal_mode=WAL");
+    pragma.exec("PRAGMA synchronous=NORMAL");
+
+    m_insertQuery = new QSqlQuery(m_database);
+    if (!m_insertQuery->prepare(EcgSegment::INSERT_STATEMENT)) {
+        qWarning() << "Failed to prepare insert statement:" << m_insertQuery->lastError().text();
+    }
+    m_pyramid = std::make_unique<EcgPyramidBuilder>(m_database);
+    m_pyramidSaveClock.start();
+
+    // Time-bounded commit
+    m_flushTimer = new QTimer(this);
+    m_flushTimer->setInterval(FLUSH_INTERVAL_MS);
+    connect(m_flushTimer, &QTimer::timeout, this, &EcgStorageWriter::flush);
+    m_flushTimer->start();
+
+    qDebug() << "Storage writer started";
+}
+
+void EcgStorageWriter::flush()
+{
+    m_flushRequested.store(false);
+
+    if (!m_insertQuery) {
+        return;
+    }
+
+    drainQueue();
+
+    if (!m_completedSegments.isEmpty()) {
+        if (commitSegments(m_completedSegments) && m_latencyMonitor && m_oldestUncommittedArrivalNs > 0) {
+            m_latencyMonitor->recordSince(LatencyStage::Store, m_oldestUncommittedArrivalNs);
+        }
+        m_oldestUncommittedArrivalNs = 0;
+        m_completedSegments.clear();
+    }
+
+    emit statisticsChanged();
+}
+
+void EcgStorageWriter::sync()
+{
+    if (!m_insertQuery) {
+        return;
+    }
+
+    // Recording sessions keep their builders, so segments are not cut short
+    flush();
+    writeOpenSegments();
+
+    if (m_pyramid && savePyramid()) {
+        m_pyramid->clear();
+    }
+}
+
+void EcgStorageWriter::finish()
+{
+    if (!m_insertQuery) {
+        return;
+    }
+
+    drainQueue();
+    for (EcgSegmentBuilder &builder : m_segmentBuilders) {
+        builder.finish(m_completedSegments);
+    }
+    m_segmentBuilders.clear();
+    flush();
+
+    if (m_pyramid && savePyramid()) {
+        m_pyramid->clear();
+    }
+}
+
+void EcgStorageWriter::endSession(qint64 sessionId)
+{
+    if (!m_insertQuery) {
+        return;
+    }
+
+    // Its last samples are queued ahead of this call
+    drainQueue();
+    auto found = m_segmentBuilders.find(sessionId);
+    if (found != m_segmentBuilders.end()) {
+        found.value().finish(m_completedSegments);
+        m_segmentBuilders.erase(found);
+    }
+    flush();
+}
+
+void EcgStorageWriter::close()
+{
+    if (m_flushTimer) {
+        m_flushTimer->stop();
+    }
+
+    if (m_database.isOpen()) {
+        finish();
+    }
+
+    delete m_insertQuery;
+    m_insertQuery = nullptr;
+    m_pyramid.reset();
+
+    if (m_database.isValid()) {
+        m_database.close();
+        m_database = QSqlDatabase();
+        QSqlDatabase::removeDatabase(m_connectionName);
+    }
+}
+
+void EcgStorageWriter::drainQueue()
+{
+    QList<PendingEcgReading> pending;
+    {
+        QMutexLocker locker(&m_queueMutex);
+        pending.swap(m_queue);
+        m_queue.reserve(MAX_BATCH_SIZE);
+    }
+    m_queueDepth.store(0, std::memory_order_relaxed);
+
+    // Readings arrive in runs per producer, so the builder lookup is cached
+    EcgSegmentBuilder *builder = nullptr;
+    qint64 builderSession = 0;
+    for (const PendingEcgReading &reading : pending) {
+        if (reading.arrivalNs > 0 && (m_oldestUncommittedArrivalNs == 0 || reading.arrivalNs < m_oldestUncommittedArrivalNs)) {
+            m_oldestUncommittedArrivalNs = reading.arrivalNs;
+        }
+        if (!builder || reading.sessionId != builderSession) {
+            auto found = m_segmentBuilders.find(reading.sessionId);
+            if (found == m_segmentBuilders.end()) {
+                found = m_segmentBuilders.insert(reading.sessionId, EcgSegmentBuilder(reading.sampleRate));
+            }
+            builder = &found.value();
+            builderSession = reading.sessionId;
+        }
+        if (builder->sampleRate() != reading.sampleRate) {
+            // A session's rate only changes between streams (e.g. a replay)
+            builder->finish(m_completedSegments);
+            *builder = EcgSegmentBuilder(reading.sampleRate);
+        }
+        builder->append(reading.voltage, reading.timestamp, reading.heartRate, reading.sessionId, m_completedSegments);
+    }
+}
+
+bool EcgStorageWriter::commitSegments(const QList<EcgSegment> &segments)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    qsizetype sampleCount = 0;
+    for (const EcgSegment &segment : segments) {
+        sampleCount += segment.samples.size();
+    }
+
+    if (!m_database.transaction()) {
+        qWarning() << "Failed to begin transaction:" << m_database.lastError().text();
+        m_droppedSamples.fetch_add(sampleCount, std::memory_order_relaxed);
+        return false;
+    }
+
+    QSqlQuery deleteProvisional(m_database);
+    for (const EcgSegment &segment : segments) {
+        // The segment sync() wrote while it was open is replaced. Forgotten
+        // either way: after a rollback the provisional row is all there is
+        auto provisional = m_provisionalRows.find(segment.sessionId);
+        if (provisional != m_provisionalRows.end() && provisional->startTime == segment.startTime) {
+            deleteProvisional.prepare("DELETE FROM ecg_segments WHERE id = ?");
+            deleteProvisional.addBindValue(provisional->rowId);
+            m_provisionalRows.erase(provisional);
+            if (!deleteProvisional.exec()) {
+                qWarning() << "Failed to replace ECG segment:" << deleteProvisional.lastError().text();
+                m_database.rollback();
+                m_droppedSamples.fetch_add(sampleCount, std::memory_order_relaxed);
+                return false;
+            }
+        }
+
+        segment.bindInsert(*m_insertQuery);
+
+        if (!m_insertQuery->exec()) {
+            qWarning() << "Failed to save ECG segment:" << m_insertQuery->lastError().text();
+            m_database.rollback();
+            m_droppedSamples.fetch_add(sampleCount, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    // Chunks hold only committed segments, so they are rewritten in this
+    // transaction without running ahead of the data. Not on every commit:
+    // a partial chunk changes each time
+    const bool savingPyramid = m_pyramidSaveClock.elapsed() >= PYRAMID_SAVE_INTERVAL_MS;
+    if (savingPyramid && !m_pyramid->save()) {
+        m_database.rollback();
+        m_droppedSamples.fetch_add(sampleCount, std::memory_order_relaxed);
+        return false;
+    }
+
+    if (!m_database.commit()) {
+        qWarning() << "Failed to commit ECG segments:" << m_database.lastError().text();
+        m_database.rollback();
+        m_droppedSamples.fetch_add(sampleCount, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Only now: a rollback must not leave rolled-back samples in the chunks
+    // or chunks marked saved
+    if (savingPyramid) {
+        m_pyramid->markSaved();
+        m_pyramidSaveClock.restart();
+    }
+    for (const EcgSegment &segment : segments) {
+        m_pyramid->addSegment(segment);
+    }
+
+    qint64 latencyUs = timer.nsecsElapsed() / 1000;
+    m_lastCommitLatencyUs.store(latencyUs, std::memory_order_relaxed);
+    if (latencyUs > m_maxCommitLatencyUs.load(std::memory_order_relaxed)) {
+        m_maxCommitLatencyUs.store(latencyUs, std::memory_order_relaxed);
+    }
+    m_writtenSamples.fetch_add(sampleCount, std::memory_order_relaxed);
+    return true;
+}
+
+void EcgStorageWriter::writeOpenSegments()
+{
+    if (!m_database.transaction()) {
+        qWarning() << "Failed to begin transaction:" << m_database.lastError().text();
+        return;
+    }
+
+    // Not counted as written and not in the pyramid until they complete
+    QSqlQuery deleteProvisional(m_database);
+    QHash<qint64, ProvisionalRow> written;
+    for (auto it = m_segmentBuilders.cbegin(); it != m_segmentBuilders.cend(); ++it) {
+        const EcgSegment &segment = it.value().current();
+        if (segment.samples.isEmpty()) {
+            continue;
+        }
+
+        auto previous = m_provisionalRows.constFind(it.key());
+        if (previous != m_provisionalRows.cend()) {
+            deleteProvisional.prepare("DELETE FROM ecg_segments WHERE id = ?");
+            deleteProvisional.addBindValue(previous->rowId);
+            if (!deleteProvisional.exec()) {
+                qWarning() << "Failed to replace open ECG segment:" << deleteProvisional.lastError().text();
+                m_database.rollback();
+                return;
+            }
+        }
+
+        segment.bindInsert(*m_insertQuery);
+        if (!m_insertQuery->exec()) {
+            qWarning() << "Failed to save open ECG segment:" << m_insertQuery->lastError().text();
+            m_database.rollback();
+            return;
+        }
+        written.insert(it.key(), {m_insertQuery->lastInsertId().toLongLong(), segment.startTime});
+    }
+
+    if (!m_database.commit()) {
+        qWarning() << "Failed to commit open ECG segments:" << m_database.lastError().text();
+        m_database.rollback();
+        return;
+    }
+    m_provisionalRows.insert(written);
+}
+
+bool EcgStorageWriter::savePyramid()
+{
+    if (!m_pyramid->hasUnsavedChanges()) {
+        return true;
+    }
+
+    if (!m_database.transaction()) {
+        qWarning() << "Failed to begin transaction:" << m_database.lastError().text();
+        return false;
+    }
+    if (!m_pyramid->save() || !m_database.commit()) {
+        m_database.rollback();
+        return false;
+    }
+    m_pyramid->markSaved();
+    m_pyramidSaveClock.restart();
+    return true;
+}
\ No newline at end of file
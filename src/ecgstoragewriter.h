@@ -0,0 +1,125 @@
+#pragma once
+
+#include <QObject>
+#include <QMutex>
+#include <QList>
+#include <QHash>
+#include <QString>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QElapsedTimer>
+#include <atomic>
+#include <memory>
+
+#include "ecgsegment.h"
+#include "ecgsample.h"
+
+class EcgPyramidBuilder;
+class LatencyMonitor;
+
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+struct PendingEcgReading {
+    double voltage;
+    quint64 timestamp;
+    int heartRate;
+    qint64 sessionId;
+    qint64 arrivalNs;
+    double sampleRate; // Nominal rate of the producing stream, Hz
+};
+
+// Writes recorded samples to SQLite from a dedicated thread.
+// Producers call enqueue() from any thread; the writer packs the queue into
+// one-second EcgSegments and commits them in bounded transactions using a
+// single prepared statement on its own WAL-mode connection. Several streams
+// may record at once: samples are segmented per session, so interleaved
+// producers do not fragment each other's segments. Committed segments are
+// also folded into the waveform overview pyramid (see ecgpyramid.h).
+// sync() makes everything queued readable without closing open segments:
+// their samples so far are written as a provisional row, which the
+// completed segment replaces.
+class EcgStorageWriter : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(int queueDepth READ queueDepth NOTIFY statisticsChanged)
+    Q_PROPERTY(double lastCommitLatencyMs READ lastCommitLatencyMs NOTIFY statisticsChanged)
+    Q_PROPERTY(double maxCommitLatencyMs READ maxCommitLatencyMs NOTIFY statisticsChanged)
+    Q_PROPERTY(quint64 writtenSamples READ writtenSamples NOTIFY statisticsChanged)
+    Q_PROPERTY(quint64 droppedSamples READ droppedSamples NOTIFY statisticsChanged)
+
+public:
+    explicit EcgStorageWriter(const QString &databasePath, QObject *parent = nullptr);
+    ~EcgStorageWriter();
+
+    // Thread-safe, called by the producer. Returns false if the sample was dropped.
+    // sampleRate is the stream's nominal rate; segments are stored at it.
+    bool enqueue(double voltage, quint64 timestamp, double sampleRate, int heartRate, qint64 sessionId = 0);
+    // Thread-safe block variant, takes the queue lock once. Returns the number queued.
+    qsizetype enqueueBlock(const EcgSampleBlock &block, double sampleRate, int heartRate, qint64 sessionId = 0);
+
+    // Statistics getters (thread-safe)
+    int queueDepth() const { return m_queueDepth.load(std::memory_order_relaxed); }
+    double lastCommitLatencyMs() const { return m_lastCommitLatencyUs.load(std::memory_order_relaxed) / 1000.0; }
+    double maxCommitLatencyMs() const { return m_maxCommitLatencyUs.load(std::memory_order_relaxed) / 1000.0; }
+    quint64 writtenSamples() const { return m_writtenSamples.load(std::memory_order_relaxed); }
+    quint64 droppedSamples() const { return m_droppedSamples.load(std::memory_order_relaxed); }
+
+    // Queue limit in samples; raise it with the number of recording streams
+    void setQueueCapacity(int samples) { m_queueCapacity.store(qMax(1, samples), std::memory_order_relaxed); }
+
+    // Records the Store stage; set before the writer is moved to its thread
+    void setLatencyMonitor(LatencyMonitor *monitor) { m_latencyMonitor = monitor; }
+
+public slots:
+    // Must run in the writer thread
+    void open();
+    void flush();
+    void sync();   // flush() plus the open segments, written provisionally
+    void finish(); // flush() plus the open segments, closed
+    void endSession(qint64 sessionId); // Closes the session's open segment; its builder is retired
+    void close();
+
+signals:
+    void statisticsChanged();
+    void error(const QString &message);
+
+private:
+    void drainQueue();
+    bool commitSegments(const QList<EcgSegment> &segments);
+    void writeOpenSegments();
+    bool savePyramid();
+
+    QString m_databasePath;
+    QString m_connectionName;
+    QSqlDatabase m_database;
+    QSqlQuery *m_insertQuery;
+    QTimer *m_flushTimer;
+    QHash<qint64, EcgSegmentBuilder> m_segmentBuilders; // Per session, at its stream's rate
+    struct ProvisionalRow {
+        qint64 rowId;
+        quint64 startTime;
+    };
+    QHash<qint64, ProvisionalRow> m_provisionalRows; // Per session: its open segment as sync() wrote it
+    QList<EcgSegment> m_completedSegments;
+    std::unique_ptr<EcgPyramidBuilder> m_pyramid;
+    QElapsedTimer m_pyramidSaveClock;
+    LatencyMonitor *m_latencyMonitor;
+    qint64 m_oldestUncommittedArrivalNs; // Of the readings drained since the last commit
+
+    QMutex m_queueMutex;
+    QList<PendingEcgReading> m_queue;
+    std::atomic<bool> m_flushRequested;
+    std::atomic<int> m_queueCapacity;
+
+    std::atomic<int> m_queueDepth;
+    std::atomic<qint64> m_lastCommitLatencyUs;
+    std::atomic<qint64> m_maxCommitLatencyUs;
+    std::atomic<quint64> m_writtenSamples;
+    std::atomic<quint64> m_droppedSamples;
+
+    static constexpr int DEFAULT_QUEUE_CAPACITY = 250 * 60; // One minute at 250 Hz
+    static constexpr int MAX_BATCH_SIZE = 1000; // Queued samples that trigger an early commit
+    static constexpr int FLUSH_INTERVAL_MS = 500; // Max time before a commit
+    static constexpr int PYRAMID_SAVE_INTERVAL_MS = 5000; // Partially filled pyramid chunks are rewritten this often
+};
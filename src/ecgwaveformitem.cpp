@@ -0,0 +1,551 @@
+#include "ecgwaveformitem.h"
+#include <QMatrix4x4>
+#include <QQuickWindow>
+#include <QSGFlatColorMaterial>
+#include <QSGGeometryNode>
+#include <QSGSimpleRectNode>
+#include <QSGTransformNode>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr float PARKED_X = -1.0e7f; // Unused segments, far left of any window
+
+// QSGGeometry::setLineWidth() is only honoured by the OpenGL backend, so
+// lines wider than a pixel are drawn as two triangles each
+bool isWide(double width)
+{
+    return width > 1.0;
+}
+
+int verticesPerLine(double width)
+{
+    return isWide(width) ? 6 : 2;
+}
+
+// The quad of line a-b, halfWidth pixels either side, as two triangles.
+// scaleX and scaleY take vertex units to pixels.
+void writeQuad(QSGGeometry::Point2D *out, const QSGGeometry::Point2D &a, const QSGGeometry::Point2D &b,
+               float halfWidth, float scaleX, float scaleY)
+{
+    const float dx = (b.x - a.x) * scaleX;
+    const float dy = (b.y - a.y) * scaleY;
+    const float length = std::sqrt(dx * dx + dy * dy);
+    float nx = 0.0f;
+    float ny = 0.0f;
+    if (length > 0.0f && scaleX != 0.0f && scaleY != 0.0f) {
+        nx = -dy / length * halfWidth / scaleX;
+        ny = dx / length * halfWidth / scaleY;
+    }
+    out[0].set(a.x + nx, a.y + ny);
+    out[1].set(a.x - nx, a.y - ny);
+    out[2].set(b.x + nx, b.y + ny);
+    out[3] = out[2];
+    out[4] = out[1];
+    out[5].set(b.x - nx, b.y - ny);
+}
+
+QSGGeometryNode *createLineNode()
+{
+    auto *node = new QSGGeometryNode;
+    auto *geometry = new QSGGeometry(QSGGeometry::defaultAttributes_Point2D(), 0);
+    geometry->setDrawingMode(QSGGeometry::DrawLines);
+    node->setGeometry(geometry);
+    node->setMaterial(new QSGFlatColorMaterial);
+    node->setFlags(QSGNode::OwnsGeometry | QSGNode::OwnsMaterial);
+    return node;
+}
+
+void setLineColor(QSGGeometryNode *node, const QColor &color)
+{
+    static_cast<QSGFlatColorMaterial *>(node->material())->setColor(color);
+    node->markDirty(QSGNode::DirtyMaterial);
+}
+
+// points holds the two ends of each line, in item pixels
+void setLines(QSGGeometryNode *node, const std::vector<QPointF> &points, double width)
+{
+    QSGGeometry *geometry = node->geometry();
+    const int perLine = verticesPerLine(width);
+    geometry->setDrawingMode(isWide(width) ? QSGGeometry::DrawTriangles : QSGGeometry::DrawLines);
+    geometry->setLineWidth(float(width));
+    geometry->allocate(int(points.size() / 2) * perLine);
+    QSGGeometry::Point2D *vertices = geometry->vertexDataAsPoint2D();
+    for (size_t i = 0; i + 1 < points.size(); i += 2) {
+        QSGGeometry::Point2D a;
+        QSGGeometry::Point2D b;
+        a.set(float(points[i].x()), float(points[i].y()));
+        b.set(float(points[i + 1].x()), float(points[i + 1].y()));
+        QSGGeometry::Point2D *line = vertices + i / 2 * perLine;
+        if (isWide(width)) {
+            writeQuad(line, a, b, float(width / 2.0), 1.0f, 1.0f);
+        } else {
+            line[0] = a;
+            line[1] = b;
+        }
+    }
+    node->markDirty(QSGNode::DirtyGeometry);
+}
+
+// Multiples of step, the first at zero; exact for the usual decimal steps
+bool isMultiple(double value, double step)
+{
+    const double ratio = value / step;
+    return std::abs(ratio - std::round(ratio)) < 1e-6;
+}
+}
+
+// Background, grid in item pixels, then the trace in (ms, V) under a transform
+class EcgWaveformNode : public QSGNode
+{
+public:
+    EcgWaveformNode()
+        : background(new QSGSimpleRectNode)
+        , minorGrid(createLineNode())
+        , majorGrid(createLineNode())
+        , zeroLine(createLineNode())
+        , transform(new QSGTransformNode)
+        , trace(createLineNode())
+        , cursor(new QSGSimpleRectNode)
+    {
+        appendChildNode(background);
+        appendChildNode(minorGrid);
+        appendChildNode(majorGrid);
+        appendChildNode(zeroLine);
+        appendChildNode(transform);
+        transform->appendChildNode(trace);
+        appendChildNode(cursor);
+
+        // Rewritten in place every frame
+        trace->geometry()->setVertexDataPattern(QSGGeometry::StreamPattern);
+    }
+
+    QSGSimpleRectNode *background;
+    QSGGeometryNode *minorGrid;
+    QSGGeometryNode *majorGrid;
+    QSGGeometryNode *zeroLine;
+    QSGTransformNode *transform;
+    QSGGeometryNode *trace;
+    QSGSimpleRectNode *cursor;
+};
+
+EcgWaveformItem::EcgWaveformItem(QQuickItem *parent)
+    : QQuickItem(parent)
+    , m_backgroundColor("#1e1e1e")
+    , m_gridColor("#555555")
+    , m_signalColor("#e74c3c")
+    , m_signalWidth(2.0)
+    , m_gridLineWidth(0.5)
+    , m_timeWindow(10000.0)
+    , m_voltageRange(2.0)
+    , m_majorGridInterval(1000.0)
+    , m_minorGridInterval(200.0)
+    , m_voltageGridInterval(0.5)
+    , m_capacity(DEFAULT_CAPACITY)
+    , m_source(nullptr)
+    , m_sourceCursor(0)
+    , m_times(DEFAULT_CAPACITY)
+    , m_voltages(DEFAULT_CAPACITY)
+    , m_appended(0)
+    , m_latestMs(0.0)
+    , m_originMs(0.0)
+    , m_uploaded(0)
+    , m_expired(0)
+    , m_traceWidth(0.0)
+    , m_traceScaleX(0.0f)
+    , m_traceScaleY(0.0f)
+    , m_rewriteAll(true)
+    , m_staticDirty(true)
+    , m_framePending(false)
+    , m_visibleSamples(0)
+    , m_sampleCount(0)
+{
+    setFlag(ItemHasContents);
+}
+
+void EcgWaveformItem::setBackgroundColor(const QColor &color)
+{
+    if (color != m_backgroundColor) {
+        m_backgroundColor = color;
+        invalidateStatic();
+        emit appearanceChanged();
+    }
+}
+
+void EcgWaveformItem::setGridColor(const QColor &color)
+{
+    if (color != m_gridColor) {
+        m_gridColor = color;
+        invalidateStatic();
+        emit appearanceChanged();
+    }
+}
+
+void EcgWaveformItem::setSignalColor(const QColor &color)
+{
+    if (color != m_signalColor) {
+        m_signalColor = color;
+        invalidateStatic();
+        emit appearanceChanged();
+    }
+}
+
+void EcgWaveformItem::setSignalWidth(double width)
+{
+    if (width > 0.0 && width != m_signalWidth) {
+        m_signalWidth = width;
+        invalidateStatic();
+        emit appearanceChanged();
+    }
+}
+
+void EcgWaveformItem::setGridLineWidth(double width)
+{
+    if (width > 0.0 && width != m_gridLineWidth) {
+        m_gridLineWidth = width;
+        invalidateStatic();
+        emit appearanceChanged();
+    }
+}
+
+void EcgWaveformItem::setTimeWindow(double ms)
+{
+    if (ms > 0.0 && ms != m_timeWindow) {
+        // Segments already parked stay parked; widening shows new data only
+        m_timeWindow = ms;
+        invalidateScale();
+    }
+}
+
+void EcgWaveformItem::setVoltageRange(double volts)
+{
+    if (volts > 0.0 && volts != m_voltageRange) {
+        m_voltageRange = volts;
+        invalidateScale();
+    }
+}
+
+void EcgWaveformItem::setMajorGridInterval(double ms)
+{
+    if (ms > 0.0 && ms != m_majorGridInterval) {
+        m_majorGridInterval = ms;
+        invalidateScale();
+    }
+}
+
+void EcgWaveformItem::setMinorGridInterval(double ms)
+{
+    if (ms > 0.0 && ms != m_minorGridInterval) {
+        m_minorGridInterval = ms;
+        invalidateScale();
+    }
+}
+
+void EcgWaveformItem::setVoltageGridInterval(double volts)
+{
+    if (volts > 0.0 && volts != m_voltageGridInterval) {
+        m_voltageGridInterval = volts;
+        invalidateScale();
+    }
+}
+
+void EcgWaveformItem::setCapacity(int samples)
+{
+    samples = qBound(2, samples, MAX_CAPACITY);
+    if (samples == m_capacity) {
+        return;
+    }
+    m_capacity = samples;
+    m_times.assign(samples, 0.0);
+    m_voltages.assign(samples, 0.0f);
+    clearData();
+    emit capacityChanged();
+}
+
+void EcgWaveformItem::setSource(LiveWaveformBuffer *source)
+{
+    if (source == m_source) {
+        return;
+    }
+    if (m_source) {
+        disconnect(m_source, nullptr, this, nullptr);
+    }
+    m_source = source;
+    if (m_source) {
+        // Only what arrives from now on; the buffer holds no history
+        m_sourceCursor = m_source->written();
+        connect(m_source, &LiveWaveformBuffer::samplesAppended, this, &EcgWaveformItem::polish);
+        connect(m_source, &QObject::destroyed, this, &EcgWaveformItem::onSourceDestroyed);
+        polish();
+    }
+    emit sourceChanged();
+}
+
+void EcgWaveformItem::onSourceDestroyed()
+{
+    m_source = nullptr;
+    emit sourceChanged();
+}
+
+void EcgWaveformItem::updatePolish()
+{
+    // Once per frame, before the scene graph syncs: everything the source
+    // received since the last frame becomes one update
+    if (!m_source) {
+        return;
+    }
+    const qsizetype count = m_source->read(m_sourceCursor, [this](double voltage, double timestamp) {
+        appendSample(voltage, timestamp);
+    });
+    if (count > 0) {
+        update();
+    }
+}
+
+void EcgWaveformItem::addDataPoint(double voltage, double timestamp)
+{
+    appendSample(voltage, timestamp);
+    update();
+}
+
+void EcgWaveformItem::appendSample(double voltage, double timestamp)
+{
+    if (m_appended > 0 && timestamp < m_latestMs) {
+        clearData();
+    }
+    const bool started = m_appended == 0;
+    if (started || timestamp - m_originMs > REBASE_MS) {
+        m_originMs = timestamp;
+        m_rewriteAll = true;
+    }
+
+    const qsizetype i = slot(m_appended);
+    m_times[i] = timestamp;
+    m_voltages[i] = float(voltage);
+    m_latestMs = timestamp;
+    ++m_appended;
+
+    if (started) {
+        emit runningChanged();
+    }
+}
+
+void EcgWaveformItem::clearData()
+{
+    const bool wasRunning = isRunning();
+    m_appended = 0;
+    m_latestMs = 0.0;
+    m_rewriteAll = true;
+    m_visibleSamples.store(0, std::memory_order_relaxed);
+    if (m_sampleCount != 0) {
+        m_sampleCount = 0;
+        emit sampleCountChanged();
+    }
+    if (wasRunning) {
+        emit runningChanged();
+    }
+    update();
+}
+
+void EcgWaveformItem::invalidateStatic()
+{
+    m_staticDirty = true;
+    update();
+}
+
+void EcgWaveformItem::invalidateScale()
+{
+    invalidateStatic();
+    emit scaleChanged();
+}
+
+void EcgWaveformItem::geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry)
+{
+    QQuickItem::geometryChange(newGeometry, oldGeometry);
+    if (newGeometry.size() != oldGeometry.size()) {
+        invalidateStatic();
+    }
+}
+
+void EcgWaveformItem::itemChange(ItemChange change, const ItemChangeData &value)
+{
+    QQuickItem::itemChange(change, value);
+    if (change == ItemSceneChange) {
+        disconnect(m_frameSwappedConnection);
+        if (value.window) {
+            // Emitted on the render thread; queued to ours
+            m_frameSwappedConnection = connect(value.window, &QQuickWindow::frameSwapped,
+                                               this, &EcgWaveformItem::onFrameSwapped, Qt::QueuedConnection);
+        }
+    }
+    // The source stops notifying until someone reads it
+    if ((change == ItemSceneChange || change == ItemVisibleHasChanged) && m_source) {
+        polish();
+    }
+}
+
+void EcgWaveformItem::onFrameSwapped()
+{
+    if (m_framePending.exchange(false)) {
+        emit framePainted();
+    }
+    const int visible = m_visibleSamples.load(std::memory_order_relaxed);
+    if (visible != m_sampleCount) {
+        m_sampleCount = visible;
+        emit sampleCountChanged();
+    }
+}
+
+QSGGeometry::Point2D EcgWaveformItem::point(quint64 sample) const
+{
+    const qsizetype i = slot(sample);
+    QSGGeometry::Point2D p;
+    p.set(float(m_times[i] - m_originMs), m_voltages[i]);
+    return p;
+}
+
+void EcgWaveformItem::writeSegment(QSGGeometry::Point2D *vertices, quint64 sample,
+                                   const QSGGeometry::Point2D &from, const QSGGeometry::Point2D &to) const
+{
+    QSGGeometry::Point2D *segment = vertices + verticesPerLine(m_traceWidth) * slot(sample);
+    if (isWide(m_traceWidth)) {
+        writeQuad(segment, from, to, float(m_traceWidth / 2.0), m_traceScaleX, m_traceScaleY);
+    } else {
+        segment[0] = from;
+        segment[1] = to;
+    }
+}
+
+bool EcgWaveformItem::writeSegments(QSGGeometry::Point2D *vertices)
+{
+    const quint64 oldest = m_appended > quint64(m_capacity) ? m_appended - quint64(m_capacity) : 0;
+    bool changed = false;
+
+    if (m_rewriteAll) {
+        for (int i = 0; i < verticesPerLine(m_traceWidth) * m_capacity; ++i) {
+            vertices[i].set(PARKED_X, 0.0f);
+        }
+        m_uploaded = m_expired = oldest;
+        m_rewriteAll = false;
+        changed = true;
+    }
+
+    // Slots of segments older than the ring are taken by newer ones
+    m_uploaded = std::max(m_uploaded, oldest);
+    m_expired = std::max(m_expired, oldest);
+
+    for (; m_uploaded < m_appended; ++m_uploaded) {
+        const quint64 n = m_uploaded;
+        const QSGGeometry::Point2D to = point(n);
+        const bool joined = n > oldest && m_times[slot(n)] - m_times[slot(n - 1)] <= MAX_GAP_MS;
+        writeSegment(vertices, n, joined ? point(n - 1) : to, to);
+        changed = true;
+    }
+
+    // Park what scrolled out, so nothing is drawn outside the item
+    const double cutoff = m_latestMs - m_timeWindow;
+    QSGGeometry::Point2D parked;
+    parked.set(PARKED_X, 0.0f);
+    for (; m_expired < m_appended && m_times[slot(m_expired)] < cutoff; ++m_expired) {
+        writeSegment(vertices, m_expired, parked, parked);
+        changed = true;
+    }
+
+    m_visibleSamples.store(int(m_appended - m_expired), std::memory_order_relaxed);
+    return changed;
+}
+
+void EcgWaveformItem::updateStaticNodes(EcgWaveformNode *node) const
+{
+    const double w = width();
+    const double h = height();
+    const double halfRange = m_voltageRange / 2.0;
+    auto voltageToY = [&](double voltage) { return h * (0.5 - voltage / m_voltageRange); };
+
+    node->background->setRect(boundingRect());
+    node->background->setColor(m_backgroundColor);
+
+    // Time lines step back from the newest sample at the right edge
+    std::vector<QPointF> minor;
+    std::vector<QPointF> major;
+    for (double t = 0.0; t <= m_timeWindow; t += m_minorGridInterval) {
+        const double x = w * (1.0 - t / m_timeWindow);
+        auto &lines = isMultiple(t, m_majorGridInterval) ? major : minor;
+        lines.emplace_back(x, 0.0);
+        lines.emplace_back(x, h);
+    }
+    const double voltageStep = m_voltageGridInterval / 2.0;
+    for (double v = -halfRange; v <= halfRange + 1e-9; v += voltageStep) {
+        const double y = voltageToY(v);
+        auto &lines = isMultiple(v, m_voltageGridInterval) ? major : minor;
+        lines.emplace_back(0.0, y);
+        lines.emplace_back(w, y);
+    }
+    setLines(node->minorGrid, minor, m_gridLineWidth);
+    setLines(node->majorGrid, major, m_gridLineWidth * 2.0);
+    setLines(node->zeroLine, {QPointF(0.0, voltageToY(0.0)), QPointF(w, voltageToY(0.0))}, m_gridLineWidth * 1.5);
+
+    setLineColor(node->minorGrid, m_gridColor);
+    setLineColor(node->majorGrid, m_gridColor.lighter(150));
+    setLineColor(node->zeroLine, m_gridColor.lighter(200));
+    setLineColor(node->trace, m_signalColor);
+    node->cursor->setColor(m_signalColor);
+}
+
+QSGNode *EcgWaveformItem::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
+{
+    auto *node = static_cast<EcgWaveformNode *>(oldNode);
+    if (!node) {
+        node = new EcgWaveformNode;
+        m_staticDirty = true;
+        m_rewriteAll = true;
+        m_traceWidth = 0.0; // Sets up the new geometry's drawing mode
+    }
+
+    if (m_staticDirty) {
+        updateStaticNodes(node);
+        m_staticDirty = false;
+    }
+
+    // (ms since origin, V) -> pixels, newest sample at the right edge
+    const double sx = width() / m_timeWindow;
+    const double sy = -height() / m_voltageRange;
+
+    // Wide segments are expanded in pixels, so a new width or scale
+    // rewrites them; scrolling is still only the transform
+    QSGGeometry *geometry = node->trace->geometry();
+    if (m_signalWidth != m_traceWidth
+        || (isWide(m_signalWidth) && (float(sx) != m_traceScaleX || float(sy) != m_traceScaleY))) {
+        m_traceWidth = m_signalWidth;
+        m_traceScaleX = float(sx);
+        m_traceScaleY = float(sy);
+        geometry->setDrawingMode(isWide(m_traceWidth) ? QSGGeometry::DrawTriangles : QSGGeometry::DrawLines);
+        geometry->setLineWidth(float(m_traceWidth));
+        m_rewriteAll = true;
+    }
+    if (geometry->vertexCount() != verticesPerLine(m_traceWidth) * m_capacity) {
+        geometry->allocate(verticesPerLine(m_traceWidth) * m_capacity);
+        m_rewriteAll = true;
+    }
+    if (writeSegments(geometry->vertexDataAsPoint2D())) {
+        node->trace->markDirty(QSGNode::DirtyGeometry);
+        if (m_appended > 0) {
+            m_framePending.store(true);
+        }
+    }
+
+    const double tx = width() - (m_latestMs - m_originMs) * sx;
+    const double ty = height() / 2.0;
+    node->transform->setMatrix(QMatrix4x4(float(sx), 0.0f, 0.0f, float(tx),
+                                          0.0f, float(sy), 0.0f, float(ty),
+                                          0.0f, 0.0f, 1.0f, 0.0f,
+                                          0.0f, 0.0f, 0.0f, 1.0f));
+
+    if (m_appended > 0) {
+        const float y = float(ty + m_voltages[slot(m_appended - 1)] * sy);
+        node->cursor->setRect(QRectF(width() - 3.0, y - 3.0, 6.0, 6.0));
+    } else {
+        node->cursor->setRect(QRectF());
+    }
+    return node;
+}
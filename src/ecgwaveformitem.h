@@ -0,0 +1,149 @@
+#pragma once
+
+#include <QColor>
+#include <QQuickItem>
+#include <QSGGeometry>
+#include <atomic>
+#include <vector>
+
+#include "livewaveformbuffer.h"
+
+class EcgWaveformNode;
+
+// Scrolling ECG trace drawn straight into the scene graph, newest sample at
+// the right edge. Samples are kept in a fixed-capacity ring and sample n is
+// the line segment from sample n-1, stored at slot n % capacity of a vertex
+// buffer in (time, voltage) units: a frame only writes the segments appended
+// or scrolled out since the previous frame, and scrolling and scaling are a
+// single transform. Lines wider than a pixel are drawn as triangles, since
+// only the OpenGL backend honours line widths; their segments are also
+// rewritten when the scale changes. The grid is static geometry, rebuilt
+// only when the size, scales or colours change. Samples come from a LiveWaveformBuffer source,
+// drained once per frame in updatePolish(), or from addDataPoint(); either
+// way any sample rate costs one render per vsync. One item draws one lead.
+class EcgWaveformItem : public QQuickItem
+{
+    Q_OBJECT
+    Q_PROPERTY(QColor backgroundColor READ backgroundColor WRITE setBackgroundColor NOTIFY appearanceChanged)
+    Q_PROPERTY(QColor gridColor READ gridColor WRITE setGridColor NOTIFY appearanceChanged)
+    Q_PROPERTY(QColor signalColor READ signalColor WRITE setSignalColor NOTIFY appearanceChanged)
+    Q_PROPERTY(double signalWidth READ signalWidth WRITE setSignalWidth NOTIFY appearanceChanged)
+    Q_PROPERTY(double gridLineWidth READ gridLineWidth WRITE setGridLineWidth NOTIFY appearanceChanged)
+    Q_PROPERTY(double timeWindow READ timeWindow WRITE setTimeWindow NOTIFY scaleChanged)
+    Q_PROPERTY(double voltageRange READ voltageRange WRITE setVoltageRange NOTIFY scaleChanged)
+    Q_PROPERTY(double majorGridInterval READ majorGridInterval WRITE setMajorGridInterval NOTIFY scaleChanged)
+    Q_PROPERTY(double minorGridInterval READ minorGridInterval WRITE setMinorGridInterval NOTIFY scaleChanged)
+    Q_PROPERTY(double voltageGridInterval READ voltageGridInterval WRITE setVoltageGridInterval NOTIFY scaleChanged)
+    Q_PROPERTY(int capacity READ capacity WRITE setCapacity NOTIFY capacityChanged)
+    Q_PROPERTY(LiveWaveformBuffer* source READ source WRITE setSource NOTIFY sourceChanged)
+    Q_PROPERTY(bool running READ isRunning NOTIFY runningChanged)
+    Q_PROPERTY(double currentTime READ currentTime NOTIFY runningChanged)
+    Q_PROPERTY(int sampleCount READ sampleCount NOTIFY sampleCountChanged)
+
+public:
+    explicit EcgWaveformItem(QQuickItem *parent = nullptr);
+
+    QColor backgroundColor() const { return m_backgroundColor; }
+    QColor gridColor() const { return m_gridColor; }
+    QColor signalColor() const { return m_signalColor; }
+    double signalWidth() const { return m_signalWidth; }
+    double gridLineWidth() const { return m_gridLineWidth; }
+    double timeWindow() const { return m_timeWindow; }
+    double voltageRange() const { return m_voltageRange; }
+    double majorGridInterval() const { return m_majorGridInterval; }
+    double minorGridInterval() const { return m_minorGridInterval; }
+    double voltageGridInterval() const { return m_voltageGridInterval; }
+    int capacity() const { return m_capacity; }
+    LiveWaveformBuffer *source() const { return m_source; }
+    bool isRunning() const { return m_appended > 0; }
+    double currentTime() const { return m_latestMs; }
+    int sampleCount() const { return m_sampleCount; }
+
+    void setBackgroundColor(const QColor &color);
+    void setGridColor(const QColor &color);
+    void setSignalColor(const QColor &color);
+    void setSignalWidth(double width);
+    void setGridLineWidth(double width);
+    void setTimeWindow(double ms);
+    void setVoltageRange(double volts);
+    void setMajorGridInterval(double ms);
+    void setMinorGridInterval(double ms);
+    void setVoltageGridInterval(double volts);
+    void setCapacity(int samples);
+    void setSource(LiveWaveformBuffer *source);
+
+    // timestamp in ms; an earlier timestamp than the last one starts over
+    Q_INVOKABLE void addDataPoint(double voltage, double timestamp);
+    Q_INVOKABLE void clearData();
+
+    static constexpr int DEFAULT_CAPACITY = 10000;  // 10 s at 1000 Hz
+    static constexpr int MAX_CAPACITY = 1 << 20;
+    static constexpr double MAX_GAP_MS = 250.0;     // Longer silences break the trace
+    static constexpr double REBASE_MS = 1 << 21;    // ~35 min of float time keeps 0.25 ms resolution
+
+signals:
+    void appearanceChanged();
+    void scaleChanged();
+    void capacityChanged();
+    void sourceChanged();
+    void runningChanged();
+    void sampleCountChanged();
+    // Emitted after each frame that showed new samples (latency measurement)
+    void framePainted();
+
+protected:
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data) override;
+    void geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry) override;
+    void itemChange(ItemChange change, const ItemChangeData &value) override;
+    void updatePolish() override;
+
+private slots:
+    void onFrameSwapped();
+    void onSourceDestroyed();
+
+private:
+    qsizetype slot(quint64 sample) const { return qsizetype(sample % quint64(m_capacity)); }
+    QSGGeometry::Point2D point(quint64 sample) const;
+    void appendSample(double voltage, double timestamp);
+    void updateStaticNodes(EcgWaveformNode *node) const;
+    void writeSegment(QSGGeometry::Point2D *vertices, quint64 sample,
+                      const QSGGeometry::Point2D &from, const QSGGeometry::Point2D &to) const;
+    bool writeSegments(QSGGeometry::Point2D *vertices);
+    void invalidateStatic();
+    void invalidateScale();
+
+    QColor m_backgroundColor;
+    QColor m_gridColor;
+    QColor m_signalColor;
+    double m_signalWidth;
+    double m_gridLineWidth;
+    double m_timeWindow;
+    double m_voltageRange;
+    double m_majorGridInterval;
+    double m_minorGridInterval;
+    double m_voltageGridInterval;
+    int m_capacity;
+    LiveWaveformBuffer *m_source;
+    quint64 m_sourceCursor;
+
+    // Sample ring; sample n (counted since the last clear) lives at slot(n)
+    std::vector<double> m_times;
+    std::vector<float> m_voltages;
+    quint64 m_appended;
+    double m_latestMs;
+    double m_originMs; // Vertex x is ms since this, rebased before float precision runs out
+
+    // Vertex buffer state, touched only while the render thread syncs
+    quint64 m_uploaded; // Segments below this are written
+    quint64 m_expired;  // Segments below this are parked off-screen
+    double m_traceWidth; // Line width and scale the vertex buffer was written for
+    float m_traceScaleX;
+    float m_traceScaleY;
+    bool m_rewriteAll;
+    bool m_staticDirty;
+
+    std::atomic<bool> m_framePending;
+    std::atomic<int> m_visibleSamples;
+    int m_sampleCount;
+    QMetaObject::Connection m_frameSwappedConnection;
+};
@@ -0,0 +1,197 @@
+#include "headlessrunner.h"
+#include "hmcontroller.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QTimer>
+#include <atomic>
+#include <csignal>
+
+namespace {
+std::atomic<bool> s_shutdownRequested(false);
+
+void requestShutdown(int)
+{
+    s_shutdownRequested.store(true);
+}
+}
+
+HeadlessRunner::HeadlessRunner(HMController *controller, const HeadlessOptions &options, QObject *parent)
+    : QObject(parent)
+    , m_controller(controller)
+    , m_options(options)
+{
+    m_statusTimer = new QTimer(this);
+    m_statusTimer->setInterval(qMax(1, m_options.statusIntervalS) * 1000);
+    connect(m_statusTimer, &QTimer::timeout, this, &HeadlessRunner::logStatus);
+
+    // Signal handlers only set a flag; the event loop picks it up here
+    m_shutdownTimer = new QTimer(this);
+    m_shutdownTimer->setInterval(200);
+    connect(m_shutdownTimer, &QTimer::timeout, this, &HeadlessRunner::checkForShutdown);
+
+    connect(m_controller, &HMController::connectionStatusChanged,
+            this, &HeadlessRunner::onConnectionStatusChanged);
+    connect(m_controller, &HMController::replayFinished,
+            this, &HeadlessRunner::onReplayFinished);
+}
+
+void HeadlessRunner::start()
+{
+    m_uptime.start();
+    if (!m_options.latencyJsonPath.isEmpty()) {
+        m_controller->setLatencyDumpPath(m_options.latencyJsonPath);
+    }
+    m_controller->setMainsFrequency(m_options.mainsHz);
+    std::signal(SIGINT, requestShutdown);
+    std::signal(SIGTERM, requestShutdown);
+    m_shutdownTimer->start();
+    if (m_options.statusIntervalS > 0) {
+        m_statusTimer->start();
+    }
+
+    if (m_options.replaySource.isEmpty()) {
+        m_controller->startConnection();
+    } else if (!m_controller->startReplay(m_options.replaySource, m_options.replaySpeed)) {
+        QCoreApplication::exit(1);
+        return;
+    }
+    if (m_options.streams > 0) {
+        int added = m_controller->addSimulatedStreams(m_options.streams, m_options.sampleRate,
+                                                      m_options.scenario, m_options.unthrottled);
+        qInfo().noquote() << QString("Added %1 simulated streams at %2 Hz, scenario %3%4")
+                                 .arg(added)
+                                 .arg(m_options.sampleRate)
+                                 .arg(m_options.scenario, m_options.unthrottled ? ", unthrottled" : "");
+    }
+}
+
+void HeadlessRunner::onConnectionStatusChanged()
+{
+    qInfo().noquote() << "Connection:" << m_controller->connectionStatus();
+
+    if (m_options.record && m_controller->isConnected() && !m_controller->isRecording()) {
+        m_controller->startRecording();
+    }
+}
+
+void HeadlessRunner::onReplayFinished(bool success, const QString &message)
+{
+    qInfo().noquote() << "Replay finished:" << message;
+    if (!success) {
+        QCoreApplication::exit(1);
+        return;
+    }
+    s_shutdownRequested.store(true); // Shut down through the normal path
+}
+
+void HeadlessRunner::logStatus()
+{
+    QVariantMap storage = m_controller->storageStatistics();
+    QVariantMap acquisition = m_controller->acquisitionStatistics();
+
+    int streamHeartRateSum = 0;
+    const QVariantList streams = m_controller->streamStatistics();
+    for (const QVariant &stream : streams) {
+        streamHeartRateSum += stream.toMap().value("heartRate").toInt();
+    }
+
+    qInfo().noquote() << QString("Status: up %1 s, %2, HR %3 bpm, recording %4, written %5, dropped %6, "
+                                 "queue %7, commit %8 ms, ring overflow %9, streams %10 (mean HR %11)")
+                             .arg(m_uptime.elapsed() / 1000)
+                             .arg(m_controller->connectionStatus())
+                             .arg(m_controller->currentHeartRate())
+                             .arg(m_controller->isRecording() ? "yes" : "no")
+                             .arg(storage.value("writtenSamples").toULongLong())
+                             .arg(storage.value("droppedSamples").toULongLong())
+                             .arg(storage.value("queueDepth").toInt())
+                             .arg(storage.value("lastCommitLatencyMs").toDouble(), 0, 'f', 1)
+                             .arg(acquisition.value("overflowCount").toULongLong())
+                             .arg(streams.size())
+                             .arg(streams.isEmpty() ? 0 : streamHeartRateSum / streams.size());
+
+    if (m_controller->isReplaying()) {
+        QVariantMap replay = m_controller->replayStatistics();
+        qInfo().noquote() << QString("Replay: %1% done, %2 samples/s (%3x real time), latency mean %4 ms, max %5 ms")
+                                 .arg(replay.value("progress").toDouble() * 100.0, 0, 'f', 1)
+                                 .arg(replay.value("samplesPerSecond").toDouble(), 0, 'f', 0)
+                                 .arg(replay.value("realtimeFactor").toDouble(), 0, 'f', 1)
+                                 .arg(replay.value("meanLatencyMs").toDouble(), 0, 'f', 3)
+                                 .arg(replay.value("maxLatencyMs").toDouble(), 0, 'f', 3);
+    }
+}
+
+void HeadlessRunner::checkForShutdown()
+{
+    bool expired = m_options.durationS > 0 && m_uptime.elapsed() >= qint64(m_options.durationS) * 1000;
+    if (!s_shutdownRequested.load() && !expired) {
+        return;
+    }
+
+    m_shutdownTimer->stop();
+    qInfo() << "Shutting down";
+    logStatus();
+    if (m_controller->isRecording()) {
+        m_controller->stopRecording();
+    }
+    m_controller->removeStreams();
+    QCoreApplication::quit();
+}
+
+bool HeadlessRunner::isRequested(int argc, char *argv[])
+{
+    // Checked before any application object exists
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--headless") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int HeadlessRunner::run(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("Heart Monitor");
+    app.setApplicationVersion("1.0");
+    app.setOrganizationName("DevOnline");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Heart Monitor headless ingest and analysis");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOption({"headless", "Run without GUI."});
+    parser.addOption({"record", "Record as soon as the device connects."});
+    parser.addOption({"streams", "Additional simulated streams to run.", "count", "0"});
+    parser.addOption({"sample-rate", "Sample rate of the simulated streams (250-2000 Hz).", "hz", "250"});
+    parser.addOption({"mains", "Mains frequency removed by the front-end filter (50 or 60 Hz).", "hz", "50"});
+    parser.addOption({"scenario", "Rhythm script of the simulated streams: normal, brady, tachy, afib, pvc, "
+                                  "or timed steps such as normal:60,afib:30.", "script", "normal"});
+    parser.addOption({"unthrottled", "Simulated streams generate as fast as the pipeline consumes."});
+    parser.addOption({"replay", "Replay an EDF/HMRAW file or a recorded session id instead of the device.", "source"});
+    parser.addOption({"replay-speed", "Replay speed as a multiple of real time (0 = unthrottled).", "factor", "1"});
+    parser.addOption({"latency-json", "Write per-stage latency histograms to this file periodically.", "file"});
+    parser.addOption({"status-interval", "Seconds between status log lines (0 = off).", "seconds", "10"});
+    parser.addOption({"duration", "Exit after this many seconds (0 = run until signalled).", "seconds", "0"});
+    parser.process(app);
+
+    HeadlessOptions options;
+    options.record = parser.isSet("record");
+    options.streams = parser.value("streams").toInt();
+    options.sampleRate = parser.value("sample-rate").toInt();
+    options.mainsHz = parser.value("mains").toDouble();
+    options.scenario = parser.value("scenario");
+    options.unthrottled = parser.isSet("unthrottled");
+    options.replaySource = parser.value("replay");
+    options.replaySpeed = parser.value("replay-speed").toDouble();
+    options.latencyJsonPath = parser.value("latency-json");
+    options.statusIntervalS = parser.value("status-interval").toInt();
+    options.durationS = parser.value("duration").toInt();
+
+    HMController controller;
+    HeadlessRunner runner(&controller, options);
+    runner.start();
+
+    return app.exec();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QString>
+
+class HMController;
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+struct HeadlessOptions {
+    int streams = 0;            // Additional simulated streams
+    int sampleRate = 250;       // Of the simulated streams
+    double mainsHz = 50.0;      // Notched by the front-end filters
+    QString scenario = "normal"; // EcgSimulator script
+    bool unthrottled = false;   // Simulated streams run as fast as they drain
+    bool record = false;        // Record as soon as the device connects
+    QString replaySource;       // File or session id to replay instead of the device
+    double replaySpeed = 1.0;   // 0 = as fast as processing keeps up
+    QString latencyJsonPath;    // Periodic latency histogram dump, empty = off
+    int statusIntervalS = 10;   // 0 disables the periodic status line
+    int durationS = 0;          // 0 = run until SIGINT/SIGTERM
+};
+
+// Drives HMController without QML or widgets for recording servers:
+// connects, optionally records, logs a status line periodically and shuts
+// down cleanly on SIGINT/SIGTERM or after a fixed duration.
+class HeadlessRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    HeadlessRunner(HMController *controller, const HeadlessOptions &options, QObject *parent = nullptr);
+
+    void start();
+
+    // Entry point for --headless: builds a QCoreApplication and runs
+    static int run(int argc, char *argv[]);
+    static bool isRequested(int argc, char *argv[]);
+
+private slots:
+    void onConnectionStatusChanged();
+    void onReplayFinished(bool success, const QString &message);
+    void logStatus();
+    void checkForShutdown();
+
+private:
+    HMController *m_controller;
+    HeadlessOptions m_options;
+    QTimer *m_statusTimer;
+    QTimer *m_shutdownTimer;
+    QElapsedTimer m_uptime;
+};
@@ -2,40 +2,90 @@
 #include "ecgdatamodel.h"
 #include "bluetoothmanager.h"
 #include "arrhythmiadetector.h"
+#include "beatdetector.h"
+#include "ecgstoragewriter.h"
+#include "ecgpyramid.h"
+#include "ecgsegment.h"
+#include "ecgexporter.h"
+#include "ecgimporter.h"
+#include "ecgpipeline.h"
+#include "ecgreplaysource.h"
+#include "latencymonitor.h"
+#include "livewaveformbuffer.h"
+#include "pipelinescheduler.h"
 
 #include <QDebug>
-#include <QTextStream>
-#include <QFile>
+#include <QThread>
+#include <QThreadPool>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
 #include <QUrl>
 #include <QtMath>
+#include <QTimeZone>
+#include <atomic>
+
+// One additional stream: its simulated source on the acquisition thread,
+// its pipeline on the scheduler's pool and the session it records into
+struct EcgStream {
+    std::unique_ptr<EcgPipeline> pipeline;
+    BluetoothManager* source = nullptr;
+    std::atomic<qint64> sessionId{0};
+};
 
 HMController::HMController(QObject *parent)
     : QObject(parent)
+    , m_acquisitionThread(nullptr)
+    , m_sampleRing(std::make_unique<EcgSampleRing>())
+    , m_latencyMonitor(std::make_unique<LatencyMonitor>())
+    , m_latencyReportTimer(nullptr)
+    , m_sampleRate(BeatDetector::DEFAULT_SAMPLE_RATE)
+    , m_oldestUnpaintedArrivalNs(0)
+    , m_storageWriter(nullptr)
+    , m_storageThread(nullptr)
+    , m_exporter(nullptr)
+    , m_importer(nullptr)
+    , m_exportProgress(0.0)
+    , m_importProgress(0.0)
+    , m_currentSessionId(0)
+    , m_replaySource(nullptr)
+    , m_replaySpeed(0.0)
+    , m_replaySampleRate(0.0)
+    , m_replayTotalSamples(0)
+    , m_replayProcessedSamples(0)
+    , m_replayWakeups(0)
+    , m_replayLatencySumNs(0)
+    , m_replayMaxLatencyNs(0)
+    , m_replayElapsedMs(0)
     , m_isConnected(false)
     , m_isRecording(false)
-    , m_currentHeartRate(0)
     , m_connectionStatus("Disconnected")
     , m_alertLevel(0)
-    , m_lastHeartRateCalculation(0)
 {
     // Initialize components
     m_ecgDataModel = new EcgDataModel(this);
-    m_bluetoothManager = new BluetoothManager(this);
+    m_liveWaveform = new LiveWaveformBuffer(LiveWaveformBuffer::DEFAULT_CAPACITY, this);
     m_arrhythmiaDetector = new ArrhythmiaDetector(this);
+    m_arrhythmiaDetector->setLatencyMonitor(m_latencyMonitor.get());
     
     // Initialize database
     initializeDatabase();
+    loadHistory();
+    startStorageWriter();
     
-    // Setup heart rate calculation timer
-    m_heartRateTimer = new QTimer(this);
-    m_heartRateTimer->setInterval(2000); // Update every 2 seconds
-    connect(m_heartRateTimer, &QTimer::timeout, this, &HMController::updateHeartRate);
+    startAcquisitionThread();
     
-    // Connect signals
-    connect(m_bluetoothManager, &BluetoothManager::newEcgData,
-            this, &HMController::onNewEcgReading);
-    connect(m_bluetoothManager, &BluetoothManager::connectionStateChanged,
-            this, &HMController::onConnectionStateChanged);
+    m_latencyReportTimer = new QTimer(this);
+    m_latencyReportTimer->setInterval(LATENCY_REPORT_INTERVAL_MS);
+    connect(m_latencyReportTimer, &QTimer::timeout, this, &HMController::onLatencyReportTimer);
+    m_latencyReportTimer->start();
+    
+    // Connect signals: filtering, beats, heart rate and rhythm come back from
+    // the analysis thread
+    connect(m_arrhythmiaDetector, &ArrhythmiaDetector::samplesFiltered,
+            this, &HMController::onSamplesFiltered);
+    connect(m_arrhythmiaDetector, &ArrhythmiaDetector::heartRateChanged,
+            this, &HMController::heartRateChanged);
     connect(m_arrhythmiaDetector, &ArrhythmiaDetector::arrhythmiaDetected,
             this, &HMController::onArrhythmiaDetected);
     
@@ -44,6 +94,20 @@ HMController::HMController(QObject *parent)
 
 HMController::~HMController()
 {
+    if (m_exporter || m_importer) {
+        if (m_exporter) {
+            m_exporter->cancel();
+        }
+        if (m_importer) {
+            m_importer->cancel();
+        }
+        QThreadPool::globalInstance()->waitForDone();
+    }
+    removeStreams();
+    stopAcquisitionThread();
+    stopStorageWriter();
+    delete m_arrhythmiaDetector; // Its worker records into m_latencyMonitor
+
     if (m_database.isOpen()) {
         m_database.close();
     }
@@ -54,8 +118,9 @@ void HMController::initializeDatabase()
     QString dataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
     QDir().mkpath(dataPath);
     
+    m_databasePath = dataPath + "/heartmonitor.db";
     m_database = QSqlDatabase::addDatabase("QSQLITE");
-    m_database.setDatabaseName(dataPath + "/heartmonitor.db");
+    m_database.setDatabaseName(m_databasePath);
     
     if (!m_database.open()) {
         qWarning() << "Failed to open database:" << m_database.lastError().text();
@@ -63,13 +128,23 @@ void HMController::initializeDatabase()
     }
     
     QSqlQuery query;
+    
+    // WAL is persistent in the database file and lets this connection read
+    // while the storage writer thread appends
+    query.exec("PRAGMA journal_mode=WAL");
+    
+    // One row per fixed-duration block of packed int16 samples
     QString createTable = R"(
-        CREATE TABLE IF NOT EXISTS ecg_readings (
-            id INTEGER PRIMARY KEY AUTOINCREMENT,
-            timestamp INTEGER NOT NULL,
-            voltage REAL NOT NULL,
+        CREATE TABLE IF NOT EXISTS ecg_segments (
+            id INTEGER PRIMARY KEY,
+            start_time INTEGER NOT NULL,
+            end_time INTEGER NOT NULL,
+            sample_rate REAL NOT NULL,
+            scale REAL NOT NULL,
+            sample_count INTEGER NOT NULL,
             heart_rate INTEGER,
-            created_at DATETIME DEFAULT CURRENT_TIMESTAMP
+            session_id INTEGER,
+            samples BLOB NOT NULL
         )
     )";
     
@@ -77,12 +152,239 @@ void HMController::initializeDatabase()
         qWarning() << "Failed to create table:" << query.lastError().text();
     }
     
-    // Create index for performance
-    query.exec("CREATE INDEX IF NOT EXISTS idx_timestamp ON ecg_readings(timestamp)");
+    // Segment tables created before recording sessions existed
+    query.exec("SELECT 1 FROM pragma_table_info('ecg_segments') WHERE name='session_id'");
+    if (!query.next()) {
+        query.exec("ALTER TABLE ecg_segments ADD COLUMN session_id INTEGER");
+    }
+    
+    QString createSessions = R"(
+        CREATE TABLE IF NOT EXISTS ecg_sessions (
+            id INTEGER PRIMARY KEY,
+            start_time INTEGER NOT NULL,
+            end_time INTEGER
+        )
+    )";
+    
+    if (!query.exec(createSessions)) {
+        qWarning() << "Failed to create sessions table:" << query.lastError().text();
+    }
+    
+    // Time index over segments (one entry per second of signal)
+    query.exec("CREATE INDEX IF NOT EXISTS idx_segments_start_time ON ecg_segments(start_time)");
+    query.exec("CREATE INDEX IF NOT EXISTS idx_segments_session ON ecg_segments(session_id)");
+    
+    // Min/max/mean overview pyramid, one row per chunk of buckets
+    QString createPyramid = R"(
+        CREATE TABLE IF NOT EXISTS ecg_pyramid (
+            session_id INTEGER NOT NULL,
+            level INTEGER NOT NULL,
+            chunk INTEGER NOT NULL,
+            buckets BLOB NOT NULL,
+            PRIMARY KEY (session_id, level, chunk)
+        )
+    )";
+    
+    if (!query.exec(createPyramid)) {
+        qWarning() << "Failed to create pyramid table:" << query.lastError().text();
+    }
+    query.exec("CREATE INDEX IF NOT EXISTS idx_pyramid_level_chunk ON ecg_pyramid(level, chunk)");
+    
+    migrateLegacyReadings();
+    rebuildPyramid();
     
     qDebug() << "Database initialized successfully";
 }
 
+void HMController::migrateLegacyReadings()
+{
+    // Databases created before segment storage kept one row per sample
+    QSqlQuery query;
+    query.exec("SELECT name FROM sqlite_master WHERE type='table' AND name='ecg_readings'");
+    if (!query.next()) {
+        return;
+    }
+    
+    if (!query.exec("SELECT timestamp, voltage, heart_rate FROM ecg_readings ORDER BY timestamp")) {
+        qWarning() << "Failed to read legacy readings:" << query.lastError().text();
+        return;
+    }
+    
+    EcgSegmentBuilder builder;
+    QList<EcgSegment> segments;
+    while (query.next()) {
+        builder.append(query.value(1).toDouble(), query.value(0).toULongLong(), query.value(2).toInt(), 0, segments);
+    }
+    builder.finish(segments);
+    
+    m_database.transaction();
+    
+    QSqlQuery insert;
+    insert.prepare(EcgSegment::INSERT_STATEMENT);
+    EcgPyramidBuilder pyramid(m_database);
+    for (const EcgSegment &segment : segments) {
+        segment.bindInsert(insert);
+        if (!insert.exec()) {
+            qWarning() << "Failed to migrate legacy readings:" << insert.lastError().text();
+            m_database.rollback();
+            return;
+        }
+        pyramid.addSegment(segment);
+    }
+    pyramid.save();
+    
+    query.exec("DROP TABLE ecg_readings");
+    m_database.commit();
+    
+    qDebug() << "Migrated" << segments.size() << "legacy segments";
+}
+
+void HMController::rebuildPyramid()
+{
+    // Recordings made before the pyramid existed
+    QSqlQuery query;
+    query.exec("SELECT EXISTS (SELECT 1 FROM ecg_pyramid), EXISTS (SELECT 1 FROM ecg_segments)");
+    if (!query.next() || query.value(0).toBool() || !query.value(1).toBool()) {
+        return;
+    }
+    
+    query.setForwardOnly(true);
+    if (!query.exec(QString("SELECT %1, session_id FROM ecg_segments ORDER BY session_id, start_time")
+                    .arg(EcgSegment::SELECT_COLUMNS))) {
+        qWarning() << "Failed to read segments for the pyramid:" << query.lastError().text();
+        return;
+    }
+    
+    m_database.transaction();
+    EcgPyramidBuilder pyramid(m_database);
+    qsizetype segments = 0;
+    while (query.next()) {
+        EcgSegment segment = EcgSegment::fromQuery(query);
+        segment.sessionId = query.value(5).toLongLong();
+        pyramid.addSegment(segment);
+        ++segments;
+    }
+    
+    if (pyramid.save() && m_database.commit()) {
+        qDebug() << "Built waveform pyramid from" << segments << "segments";
+    } else {
+        m_database.rollback();
+    }
+}
+
+void HMController::loadHistory()
+{
+    if (!m_database.isOpen()) {
+        return;
+    }
+    
+    // Fill the model with the most recent stored samples, newest segments first
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT %1 FROM ecg_segments ORDER BY start_time DESC LIMIT ?")
+                  .arg(EcgSegment::SELECT_COLUMNS));
+    query.addBindValue(HISTORY_SEGMENTS);
+    
+    if (!query.exec()) {
+        qWarning() << "Failed to load history:" << query.lastError().text();
+        return;
+    }
+    
+    QList<EcgSegment> segments;
+    while (query.next()) {
+        segments.prepend(EcgSegment::fromQuery(query));
+    }
+    
+    QList<double> voltages;
+    for (const EcgSegment &segment : segments) {
+        voltages.resize(segment.samples.size());
+        for (qsizetype i = 0; i < segment.samples.size(); ++i) {
+            voltages[i] = segment.voltageAt(i);
+        }
+        
+        EcgSampleBlock block;
+        block.samples = voltages.constData();
+        block.count = voltages.size();
+        block.startTime = segment.startTime;
+        block.samplePeriod = 1000.0 / segment.sampleRate;
+        m_ecgDataModel->addReadings(block, segment.heartRate);
+    }
+}
+
+void HMController::startAcquisitionThread()
+{
+    // The manager owns the socket/simulator timers and pushes samples into
+    // the SPSC ring from its own thread; processing drains it on this thread
+    m_acquisitionThread = new QThread(this);
+    m_acquisitionThread->setObjectName("EcgAcquisition");
+    
+    m_bluetoothManager = new BluetoothManager;
+    m_bluetoothManager->setSampleRing(m_sampleRing.get());
+    m_bluetoothManager->setLatencyMonitor(m_latencyMonitor.get());
+    m_bluetoothManager->moveToThread(m_acquisitionThread);
+    
+    connect(m_acquisitionThread, &QThread::finished, m_bluetoothManager, &QObject::deleteLater);
+    connect(m_bluetoothManager, &BluetoothManager::samplesAvailable,
+            this, &HMController::drainSamples);
+    connect(m_bluetoothManager, &BluetoothManager::connectionStateChanged,
+            this, &HMController::onConnectionStateChanged);
+    
+    m_acquisitionThread->start(QThread::HighPriority);
+}
+
+void HMController::stopAcquisitionThread()
+{
+    if (!m_acquisitionThread) {
+        return;
+    }
+    
+    if (m_replaySource) {
+        QMetaObject::invokeMethod(m_replaySource, &EcgReplaySource::stop, Qt::BlockingQueuedConnection);
+    }
+    QMetaObject::invokeMethod(m_bluetoothManager, &BluetoothManager::disconnectFromDevice, Qt::BlockingQueuedConnection);
+    m_acquisitionThread->quit();
+    m_acquisitionThread->wait();
+    
+    m_bluetoothManager = nullptr;
+    m_acquisitionThread = nullptr;
+}
+
+void HMController::startStorageWriter()
+{
+    if (!m_database.isOpen()) {
+        return;
+    }
+
+    m_storageThread = new QThread(this);
+    m_storageThread->setObjectName("EcgStorageWriter");
+
+    m_storageWriter = new EcgStorageWriter(m_databasePath);
+    m_storageWriter->setLatencyMonitor(m_latencyMonitor.get());
+    m_storageWriter->moveToThread(m_storageThread);
+
+    connect(m_storageThread, &QThread::started, m_storageWriter, &EcgStorageWriter::open);
+    connect(m_storageThread, &QThread::finished, m_storageWriter, &QObject::deleteLater);
+    connect(m_storageWriter, &EcgStorageWriter::statisticsChanged,
+            this, &HMController::storageStatisticsChanged);
+
+    m_storageThread->start();
+}
+
+void HMController::stopStorageWriter()
+{
+    if (!m_storageThread) {
+        return;
+    }
+
+    // Commit whatever is still queued before the thread goes away
+    QMetaObject::invokeMethod(m_storageWriter, &EcgStorageWriter::close, Qt::BlockingQueuedConnection);
+    m_storageThread->quit();
+    m_storageThread->wait();
+
+    m_storageWriter = nullptr;
+    m_storageThread = nullptr;
+}
+
 // Property getters
 bool HMController::isConnected() const
 {
@@ -91,7 +393,7 @@ bool HMController::isConnected() const
 
 int HMController::currentHeartRate() const
 {
-    return m_currentHeartRate;
+    return m_arrhythmiaDetector->heartRate();
 }
 
 QString HMController::connectionStatus() const
@@ -109,6 +411,11 @@ EcgDataModel* HMController::ecgDataModel() const
     return m_ecgDataModel;
 }
 
+LiveWaveformBuffer* HMController::liveWaveform() const
+{
+    return m_liveWaveform;
+}
+
 QString HMController::alertMessage() const
 {
     return m_alertMessage;
@@ -119,20 +426,52 @@ int HMController::alertLevel() const
     return m_alertLevel;
 }
 
+bool HMController::isExporting() const
+{
+    return m_exporter != nullptr;
+}
+
+double HMController::exportProgress() const
+{
+    return m_exportProgress;
+}
+
+bool HMController::isImporting() const
+{
+    return m_importer != nullptr;
+}
+
+double HMController::importProgress() const
+{
+    return m_importProgress;
+}
+
+QVariantMap HMController::storageStatistics() const
+{
+    QVariantMap stats;
+    if (m_storageWriter) {
+        stats["queueDepth"] = m_storageWriter->queueDepth();
+        stats["lastCommitLatencyMs"] = m_storageWriter->lastCommitLatencyMs();
+        stats["maxCommitLatencyMs"] = m_storageWriter->maxCommitLatencyMs();
+        stats["writtenSamples"] = m_storageWriter->writtenSamples();
+        stats["droppedSamples"] = m_storageWriter->droppedSamples();
+    }
+    return stats;
+}
+
 // Invokable methods
 void HMController::startConnection()
 {
-    m_bluetoothManager->startScanning();
+    QMetaObject::invokeMethod(m_bluetoothManager, &BluetoothManager::startScanning);
     m_connectionStatus = "Connecting...";
     emit connectionStatusChanged();
 }
 
 void HMController::stopConnection()
 {
-    m_bluetoothManager->disconnectFromDevice();
+    QMetaObject::invokeMethod(m_bluetoothManager, &BluetoothManager::disconnectFromDevice);
     m_isConnected = false;
     m_connectionStatus = "Disconnected";
-    m_heartRateTimer->stop();
     emit connectionStatusChanged();
 }
 
@@ -143,8 +482,12 @@ void HMController::startRecording()
         return;
     }
     
+    m_currentSessionId = beginSession();
+    for (const auto& stream : m_streams) {
+        stream->sessionId.store(beginSession());
+    }
+    
     m_isRecording = true;
-    m_heartRateTimer->start();
     emit recordingStatusChanged();
     
     qDebug() << "Recording started";
@@ -152,51 +495,447 @@ void HMController::startRecording()
 
 void HMController::stopRecording()
 {
+    endSession(m_currentSessionId);
+    m_currentSessionId = 0;
+    for (const auto& stream : m_streams) {
+        endSession(stream->sessionId.exchange(0));
+    }
+    
     m_isRecording = false;
-    m_heartRateTimer->stop();
     emit recordingStatusChanged();
     
     qDebug() << "Recording stopped";
 }
 
+qint64 HMController::beginSession()
+{
+    QSqlQuery query;
+    query.prepare("INSERT INTO ecg_sessions (start_time) VALUES (?)");
+    query.addBindValue(QDateTime::currentMSecsSinceEpoch());
+    return query.exec() ? query.lastInsertId().toLongLong() : 0;
+}
+
+void HMController::endSession(qint64 sessionId)
+{
+    if (sessionId <= 0) {
+        return;
+    }
+    
+    QSqlQuery query;
+    query.prepare("UPDATE ecg_sessions SET end_time = ? WHERE id = ?");
+    query.addBindValue(QDateTime::currentMSecsSinceEpoch());
+    query.addBindValue(sessionId);
+    query.exec();
+    
+    // Queued behind the session's last samples
+    if (m_storageWriter) {
+        QMetaObject::invokeMethod(m_storageWriter, &EcgStorageWriter::endSession, sessionId);
+    }
+}
+
+int HMController::addSimulatedStreams(int count, int sampleRate, const QString& scenario, bool unthrottled)
+{
+    count = qBound(0, count, MAX_STREAMS - int(m_streams.size()));
+    if (count == 0) {
+        return 0;
+    }
+    
+    BluetoothManager::SimulationOptions options;
+    options.sampleRate = qBound(EcgSimulator::MIN_SAMPLE_RATE, double(sampleRate), EcgSimulator::MAX_SAMPLE_RATE);
+    options.unthrottled = unthrottled;
+    if (!EcgSimulator::parseScript(scenario.toStdString(), options.script)) {
+        qWarning() << "Unknown simulation scenario:" << scenario;
+        return 0;
+    }
+    
+    if (!m_pipelineScheduler) {
+        m_pipelineScheduler = std::make_unique<PipelineScheduler>();
+        qDebug() << "Pipeline pool started with" << m_pipelineScheduler->threadCount() << "threads";
+    }
+    
+    for (int i = 0; i < count; ++i) {
+        auto stream = std::make_unique<EcgStream>();
+        const int streamId = int(m_streams.size()) + 1;
+        stream->pipeline = std::make_unique<EcgPipeline>(streamId, options.sampleRate, mainsFrequency());
+        if (m_isRecording) {
+            stream->sessionId.store(beginSession());
+        }
+        
+        // Samples go to the shared writer under the stream's own session
+        EcgStream* context = stream.get();
+        EcgStorageWriter* writer = m_storageWriter;
+        stream->pipeline->setSampleSink([context, writer](const EcgSampleBlock& block, int heartRate) {
+            qint64 sessionId = context->sessionId.load(std::memory_order_relaxed);
+            if (writer && sessionId > 0) {
+                // Unstamped, so the Store histogram stays device-only
+                EcgSampleBlock untimed = block;
+                untimed.arrivalNs = 0;
+                writer->enqueueBlock(untimed, context->pipeline->sampleRate(), heartRate, sessionId);
+            }
+        });
+        
+        stream->source = new BluetoothManager;
+        stream->source->setSampleRing(&stream->pipeline->ring());
+        options.seed = quint32(streamId); // Streams must not beat in lockstep
+        stream->source->setSimulationOptions(options);
+        stream->source->moveToThread(m_acquisitionThread);
+        connect(m_acquisitionThread, &QThread::finished, stream->source, &QObject::deleteLater);
+        
+        // The source already won the ring's wake-up; hand the pipeline to the pool
+        PipelineScheduler* scheduler = m_pipelineScheduler.get();
+        EcgPipeline* pipeline = stream->pipeline.get();
+        connect(stream->source, &BluetoothManager::samplesAvailable, stream->source,
+                [scheduler, pipeline]() { scheduler->schedule(pipeline); }, Qt::DirectConnection);
+        
+        QMetaObject::invokeMethod(stream->source, &BluetoothManager::startScanning);
+        m_streams.push_back(std::move(stream));
+    }
+    
+    updateStorageCapacity();
+    emit streamsChanged();
+    return count;
+}
+
+void HMController::removeStreams()
+{
+    if (m_streams.empty()) {
+        return;
+    }
+    
+    // Stop the sources first so nothing schedules work, then let the pool drain
+    for (const auto& stream : m_streams) {
+        QMetaObject::invokeMethod(stream->source, &BluetoothManager::disconnectFromDevice, Qt::BlockingQueuedConnection);
+        stream->source->deleteLater();
+        endSession(stream->sessionId.exchange(0));
+    }
+    m_pipelineScheduler->waitForIdle();
+    m_streams.clear();
+    
+    updateStorageCapacity();
+    emit streamsChanged();
+}
+
+int HMController::streamCount() const
+{
+    return int(m_streams.size());
+}
+
+QVariantList HMController::streamStatistics() const
+{
+    QVariantList list;
+    for (const auto& stream : m_streams) {
+        EcgPipeline::Statistics stats = stream->pipeline->statistics();
+        QVariantMap map;
+        map["streamId"] = stats.streamId;
+        map["sessionId"] = stream->sessionId.load(std::memory_order_relaxed);
+        map["samples"] = qulonglong(stats.samples);
+        map["beats"] = qulonglong(stats.beats);
+        map["pvcs"] = qulonglong(stats.pvcs);
+        map["pacs"] = qulonglong(stats.pacs);
+        map["overflows"] = qulonglong(stats.overflows);
+        map["heartRate"] = stats.heartRate;
+        map["meanLatencyUs"] = stats.meanLatencyUs;
+        map["maxLatencyUs"] = stats.maxLatencyUs;
+        map["rmssd"] = stats.hrv.rmssd;
+        map["sdnn"] = stats.hrv.sdnn;
+        list.append(map);
+    }
+    return list;
+}
+
+void HMController::updateStorageCapacity()
+{
+    if (!m_storageWriter) {
+        return;
+    }
+    
+    // The device plus every stream, each at its own sample rate
+    double samplesPerSecond = m_sampleRate;
+    for (const auto& stream : m_streams) {
+        samplesPerSecond += stream->pipeline->sampleRate();
+    }
+    m_storageWriter->setQueueCapacity(int(STORAGE_QUEUE_SECONDS * samplesPerSecond));
+}
+
+QVariantMap HMController::latencyStatistics() const
+{
+    QVariantMap stats;
+    for (int i = 0; i < int(LatencyStage::Count); ++i) {
+        LatencyStage stage = LatencyStage(i);
+        LatencyHistogram::Snapshot snapshot = m_latencyMonitor->snapshot(stage);
+        
+        QVariantMap stageStats;
+        stageStats["count"] = qulonglong(snapshot.count);
+        stageStats["meanUs"] = snapshot.meanNs / 1000.0;
+        stageStats["p50Us"] = snapshot.p50Ns / 1000.0;
+        stageStats["p90Us"] = snapshot.p90Ns / 1000.0;
+        stageStats["p99Us"] = snapshot.p99Ns / 1000.0;
+        stageStats["p999Us"] = snapshot.p999Ns / 1000.0;
+        stageStats["maxUs"] = snapshot.maxNs / 1000.0;
+        stats[LatencyMonitor::stageName(stage)] = stageStats;
+    }
+    return stats;
+}
+
+QString HMController::latencyStatisticsJson() const
+{
+    QJsonObject report = QJsonObject::fromVariantMap(latencyStatistics());
+    report["timestamp"] = QDateTime::currentMSecsSinceEpoch();
+    return QString::fromUtf8(QJsonDocument(report).toJson(QJsonDocument::Compact));
+}
+
+void HMController::resetLatencyStatistics()
+{
+    m_latencyMonitor->reset();
+    m_oldestUnpaintedArrivalNs = 0;
+    emit latencyStatisticsChanged();
+}
+
+void HMController::setLatencyDumpPath(const QString& filePath)
+{
+    m_latencyDumpPath = filePath;
+}
+
+void HMController::reportFramePainted()
+{
+    if (m_oldestUnpaintedArrivalNs > 0) {
+        m_latencyMonitor->recordSince(LatencyStage::UiDelivery, m_oldestUnpaintedArrivalNs);
+        m_oldestUnpaintedArrivalNs = 0;
+    }
+}
+
+void HMController::onLatencyReportTimer()
+{
+    emit latencyStatisticsChanged();
+    if (m_latencyDumpPath.isEmpty()) {
+        return;
+    }
+    
+    // Replaced atomically so a reader never sees a half-written snapshot
+    QSaveFile file(m_latencyDumpPath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(latencyStatisticsJson().toUtf8() + '\n') < 0 || !file.commit()) {
+        qWarning() << "Failed to write latency statistics to" << m_latencyDumpPath << ":" << file.errorString();
+    }
+}
+
+bool HMController::startReplay(const QString& source, double speed)
+{
+    if (m_replaySource || !m_acquisitionThread) {
+        qWarning() << "Cannot start replay: a replay is already running";
+        return false;
+    }
+    
+    // The replay takes the device's place on the ring
+    QMetaObject::invokeMethod(m_bluetoothManager, &BluetoothManager::disconnectFromDevice, Qt::BlockingQueuedConnection);
+    drainRing();
+    
+    m_replaySpeed = qMax(0.0, speed);
+    m_replaySource = new EcgReplaySource(source, m_databasePath, m_replaySpeed, m_sampleRing.get());
+    m_replaySource->moveToThread(m_acquisitionThread);
+    connect(m_acquisitionThread, &QThread::finished, m_replaySource, &QObject::deleteLater);
+    connect(m_replaySource, &EcgReplaySource::started, this, &HMController::onReplayStarted);
+    connect(m_replaySource, &EcgReplaySource::samplesAvailable, this, &HMController::onReplaySamples);
+    connect(m_replaySource, &EcgReplaySource::finished, this, &HMController::onReplayFinished);
+    
+    QMetaObject::invokeMethod(m_replaySource, &EcgReplaySource::start);
+    m_connectionStatus = "Opening replay...";
+    emit connectionStatusChanged();
+    emit replayStatusChanged();
+    return true;
+}
+
+void HMController::stopReplay()
+{
+    if (m_replaySource) {
+        QMetaObject::invokeMethod(m_replaySource, &EcgReplaySource::stop);
+    }
+}
+
+QVariantMap HMController::replayStatistics() const
+{
+    qint64 elapsedMs = m_replaySource && m_replayClock.isValid() ? m_replayClock.elapsed() : m_replayElapsedMs;
+    double samplesPerSecond = elapsedMs > 0 ? m_replayProcessedSamples * 1000.0 / elapsedMs : 0.0;
+    
+    QVariantMap stats;
+    stats["running"] = m_replaySource != nullptr;
+    stats["speed"] = m_replaySpeed;
+    stats["sampleRate"] = m_replaySampleRate;
+    stats["totalSamples"] = m_replayTotalSamples;
+    stats["processedSamples"] = m_replayProcessedSamples;
+    stats["progress"] = m_replayTotalSamples > 0 ? double(m_replayProcessedSamples) / m_replayTotalSamples : 0.0;
+    stats["elapsedMs"] = elapsedMs;
+    stats["samplesPerSecond"] = samplesPerSecond;
+    stats["realtimeFactor"] = m_replaySampleRate > 0.0 ? samplesPerSecond / m_replaySampleRate : 0.0;
+    stats["meanLatencyMs"] = m_replayWakeups > 0 ? m_replayLatencySumNs / 1e6 / m_replayWakeups : 0.0;
+    stats["maxLatencyMs"] = m_replayMaxLatencyNs / 1e6;
+    return stats;
+}
+
+void HMController::onReplayStarted(double sampleRate, qint64 totalSamples)
+{
+    m_replaySampleRate = sampleRate;
+    m_replayTotalSamples = totalSamples;
+    m_replayProcessedSamples = 0;
+    m_replayWakeups = 0;
+    m_replayLatencySumNs = 0;
+    m_replayMaxLatencyNs = 0;
+    m_replayElapsedMs = 0;
+    m_replayClock.start();
+    
+    setSampleRate(sampleRate);
+    onConnectionStateChanged(true);
+    m_connectionStatus = "Replaying";
+    emit connectionStatusChanged();
+}
+
+void HMController::onReplaySamples(qint64 wakeupNs)
+{
+    m_replayProcessedSamples += drainRing();
+    
+    // From the push that woke us to the samples being stored and queued to analysis
+    qint64 latencyNs = LatencyMonitor::nowNs() - wakeupNs;
+    m_replayLatencySumNs += latencyNs;
+    m_replayMaxLatencyNs = qMax(m_replayMaxLatencyNs, latencyNs);
+    ++m_replayWakeups;
+}
+
+void HMController::onReplayFinished(bool success, const QString& message)
+{
+    m_replayProcessedSamples += drainRing();
+    m_replayElapsedMs = m_replayClock.isValid() ? m_replayClock.elapsed() : 0;
+    
+    if (m_replaySource) {
+        m_replaySource->deleteLater();
+        m_replaySource = nullptr;
+    }
+    
+    QVariantMap stats = replayStatistics();
+    qInfo().noquote() << QString("Replay: %1 samples in %2 ms, %3 samples/s (%4x real time), latency mean %5 ms, max %6 ms")
+                             .arg(m_replayProcessedSamples)
+                             .arg(m_replayElapsedMs)
+                             .arg(stats["samplesPerSecond"].toDouble(), 0, 'f', 0)
+                             .arg(stats["realtimeFactor"].toDouble(), 0, 'f', 1)
+                             .arg(stats["meanLatencyMs"].toDouble(), 0, 'f', 3)
+                             .arg(stats["maxLatencyMs"].toDouble(), 0, 'f', 3);
+    
+    setSampleRate(BeatDetector::DEFAULT_SAMPLE_RATE);
+    if (m_isConnected) {
+        onConnectionStateChanged(false);
+    } else {
+        m_connectionStatus = "Disconnected";
+        emit connectionStatusChanged();
+    }
+    
+    emit replayStatusChanged();
+    emit replayFinished(success, message);
+}
+
 void HMController::exportData(const QString& filePath)
 {
-    QFile file(QUrl(filePath).toLocalFile());
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        emit dataExported(false, "Failed to open file for writing");
+    exportRange(filePath, 0, 0, 0);
+}
+
+void HMController::exportRange(const QString& filePath, qint64 fromTime, qint64 toTime, qint64 sessionId)
+{
+    if (m_exporter) {
+        emit dataExported(false, "An export is already in progress");
         return;
     }
     
-    QTextStream out(&file);
-    out << "Timestamp,Voltage,HeartRate,DateTime\n";
+    // Make sure queued samples are committed before reading them back
+    if (m_storageWriter) {
+        QMetaObject::invokeMethod(m_storageWriter, &EcgStorageWriter::sync, Qt::BlockingQueuedConnection);
+    }
     
-    QSqlQuery query;
-    query.prepare("SELECT timestamp, voltage, heart_rate, created_at FROM ecg_readings ORDER BY timestamp");
+    EcgExportRequest request;
+    request.filePath = QUrl(filePath).toLocalFile();
+    request.databasePath = m_databasePath;
+    request.fromTime = fromTime;
+    request.toTime = toTime;
+    request.sessionId = sessionId;
     
-    if (!query.exec()) {
-        emit dataExported(false, "Database query failed: " + query.lastError().text());
+    m_exporter = new EcgExporter(request, this);
+    connect(m_exporter, &EcgExporter::progressChanged, this, &HMController::onExportProgress);
+    connect(m_exporter, &EcgExporter::finished, this, &HMController::onExportFinished);
+    
+    m_exportProgress = 0.0;
+    emit exportProgressChanged();
+    emit exportStatusChanged();
+    
+    QThreadPool::globalInstance()->start(m_exporter);
+}
+
+void HMController::cancelExport()
+{
+    if (m_exporter) {
+        m_exporter->cancel();
+    }
+}
+
+void HMController::importData(const QString& filePath)
+{
+    if (m_importer) {
+        emit dataImported(false, "An import is already in progress");
         return;
     }
     
-    int recordCount = 0;
+    m_importer = new EcgImporter(QUrl(filePath).toLocalFile(), m_databasePath, this);
+    connect(m_importer, &EcgImporter::progressChanged, this, &HMController::onImportProgress);
+    connect(m_importer, &EcgImporter::finished, this, &HMController::onImportFinished);
+    m_importProgress = 0.0;
+    emit importProgressChanged();
+    emit importStatusChanged();
+    
+    QThreadPool::globalInstance()->start(m_importer);
+}
+
+QVariantList HMController::getSessions()
+{
+    QVariantList sessions;
+    QSqlQuery query("SELECT id, start_time, end_time FROM ecg_sessions ORDER BY start_time DESC");
     while (query.next()) {
-        quint64 timestamp = query.value(0).toULongLong();
-        double voltage = query.value(1).toDouble();
-        int heartRate = query.value(2).toInt();
-        QString dateTime = query.value(3).toString();
-        
-        out << timestamp << "," << voltage << "," << heartRate << "," << dateTime << "\n";
-        recordCount++;
+        QVariantMap session;
+        session["id"] = query.value(0).toLongLong();
+        session["startTime"] = query.value(1).toLongLong();
+        session["endTime"] = query.value(2).toLongLong();
+        sessions.append(session);
+    }
+    return sessions;
+}
+
+QVariantList HMController::waveformOverview(qint64 fromTime, qint64 toTime, int columns, qint64 sessionId)
+{
+    QVariantList overview;
+    if (fromTime < 0 || toTime <= fromTime) {
+        return overview;
     }
     
-    file.close();
-    emit dataExported(true, QString("Exported %1 records successfully").arg(recordCount));
+    const QList<EcgPyramidColumn> result = EcgPyramid::query(m_database, quint64(fromTime), quint64(toTime),
+                                                             qMin(columns, MAX_OVERVIEW_COLUMNS), sessionId);
+    overview.reserve(result.size());
+    for (const EcgPyramidColumn &column : result) {
+        QVariantMap entry;
+        entry["startTime"] = qint64(column.startTime);
+        entry["endTime"] = qint64(column.endTime);
+        entry["min"] = double(column.summary.min);
+        entry["max"] = double(column.summary.max);
+        entry["mean"] = column.summary.mean();
+        entry["count"] = qulonglong(column.summary.count);
+        overview.append(entry);
+    }
+    return overview;
 }
 
 void HMController::clearHistory()
 {
+    // Commit pending samples and close open segments first so none reappear
+    // after the delete
+    if (m_storageWriter) {
+        QMetaObject::invokeMethod(m_storageWriter, &EcgStorageWriter::finish, Qt::BlockingQueuedConnection);
+    }
+    
     QSqlQuery query;
-    if (query.exec("DELETE FROM ecg_readings")) {
+    if (query.exec("DELETE FROM ecg_segments") && query.exec("DELETE FROM ecg_pyramid")) {
         m_ecgDataModel->clearData();
         qDebug() << "History cleared";
     } else {
@@ -206,33 +945,120 @@ void HMController::clearHistory()
 
 QVariantList HMController::getAvailableDevices()
 {
-    return m_bluetoothManager->getAvailableDevices();
+    QVariantList devices;
+    QMetaObject::invokeMethod(m_bluetoothManager, &BluetoothManager::getAvailableDevices,
+                              Qt::BlockingQueuedConnection, &devices);
+    return devices;
 }
 
 // Private slots
 void HMController::onNewEcgReading(double voltage, quint64 timestamp)
 {
-    // Store recent data for heart rate calculation
-    m_recentEcgData.append(voltage);
-    m_recentTimestamps.append(timestamp);
+    EcgSampleBlock block;
+    block.samples = &voltage;
+    block.count = 1;
+    block.startTime = timestamp;
+    processBlock(block);
+}
+
+void HMController::processBlock(const EcgSampleBlock& block)
+{
+    if (block.count <= 0) {
+        return;
+    }
     
-    // Keep only recent samples
-    while (m_recentEcgData.size() > MAX_RECENT_SAMPLES) {
-        m_recentEcgData.removeFirst();
-        m_recentTimestamps.removeFirst();
+    if (block.arrivalNs > 0) {
+        m_latencyMonitor->recordSince(LatencyStage::Ingest, block.arrivalNs);
     }
     
-    // Save to database if recording
+    // Save to database if recording; storage keeps the signal as acquired
     if (m_isRecording) {
-        saveEcgReading(voltage, timestamp, m_currentHeartRate);
-        m_ecgDataModel->addReading(voltage, timestamp, m_currentHeartRate);
+        saveEcgBlock(block, currentHeartRate());
+        m_ecgDataModel->addReadings(block, currentHeartRate());
     }
     
-    // Send to arrhythmia detector
-    m_arrhythmiaDetector->processEcgSample(voltage, timestamp);
+    // Filtering, beat detection and rhythm analysis run on the analysis
+    // thread; the filtered samples come back through onSamplesFiltered()
+    m_arrhythmiaDetector->processBlock(block);
+}
+
+void HMController::onSamplesFiltered(const EcgSampleBuffer& filtered)
+{
+    if (filtered.arrivalNs > 0 && m_oldestUnpaintedArrivalNs == 0) {
+        m_oldestUnpaintedArrivalNs = filtered.arrivalNs;
+    }
     
-    // Emit for real-time graph
-    emit newEcgData(voltage, timestamp);
+    // Real-time graph; drained by the view once per frame
+    m_liveWaveform->append(filtered.block());
+}
+
+void HMController::setSampleRate(double sampleRate)
+{
+    if (sampleRate > 0.0) {
+        m_sampleRate = sampleRate;
+    }
+    m_arrhythmiaDetector->setSampleRate(m_sampleRate);
+    updateStorageCapacity();
+}
+
+void HMController::setMainsFrequency(double hz)
+{
+    if (hz != 50.0 && hz != 60.0) {
+        qWarning() << "Unsupported mains frequency:" << hz;
+        return;
+    }
+    m_arrhythmiaDetector->setMainsFrequency(hz);
+}
+
+double HMController::mainsFrequency() const
+{
+    return m_arrhythmiaDetector->mainsFrequency();
+}
+
+void HMController::drainSamples()
+{
+    drainRing();
+}
+
+qint64 HMController::drainRing()
+{
+    // Acknowledge first so a push racing with this drain triggers a new wake-up
+    m_sampleRing->acknowledgeWakeup();
+    
+    EcgSample samples[DRAIN_BLOCK_SIZE];
+    double voltages[DRAIN_BLOCK_SIZE];
+    std::size_t count;
+    qint64 drained = 0;
+    while ((count = m_sampleRing->pop(samples, DRAIN_BLOCK_SIZE)) > 0) {
+        // Runs without timestamp gaps become blocks
+        splitIntoBlocks(samples, voltages, count, MAX_BLOCK_GAP_MS,
+                        [this](const EcgSampleBlock& block) { processBlock(block); });
+        drained += qint64(count);
+    }
+    return drained;
+}
+
+QVariantMap HMController::acquisitionStatistics() const
+{
+    QVariantMap stats;
+    stats["capacity"] = qulonglong(m_sampleRing->capacity());
+    stats["size"] = qulonglong(m_sampleRing->size());
+    stats["highWaterMark"] = qulonglong(m_sampleRing->highWaterMark());
+    stats["overflowCount"] = qulonglong(m_sampleRing->overflowCount());
+    
+    // Device protocol counters (all zero in simulation)
+    BluetoothManager::ProtocolStatistics protocol;
+    if (m_bluetoothManager) {
+        protocol = m_bluetoothManager->protocolStatistics();
+    }
+    stats["framesReceived"] = qulonglong(protocol.frames);
+    stats["crcErrors"] = qulonglong(protocol.crcErrors);
+    stats["lostFrames"] = qulonglong(protocol.lostFrames);
+    stats["discardedBytes"] = qulonglong(protocol.discardedBytes);
+    stats["invalidLines"] = qulonglong(protocol.invalidLines);
+    stats["samplePeriodMs"] = protocol.samplePeriodMs;
+    stats["clockDriftPpm"] = protocol.clockDriftPpm;
+    return stats;
 }
 
 void HMController::onConnectionStateChanged(bool connected)
@@ -240,17 +1066,21 @@ void HMController::onConnectionStateChanged(bool connected)
     m_isConnected = connected;
     m_connectionStatus = connected ? "Connected" : "Disconnected";
     
-    if (!connected) {
+    if (connected) {
+        m_arrhythmiaDetector->resetAnalysis();
+        m_arrhythmiaDetector->startMonitoring();
+    } else {
         m_isRecording = false;
-        m_heartRateTimer->stop();
+        m_arrhythmiaDetector->stopMonitoring();
         emit recordingStatusChanged();
     }
     
     emit connectionStatusChanged();
 }
 
-void HMController::onArrhythmiaDetected(const QString& type, int severity)
+void HMController::onArrhythmiaDetected(RhythmType rhythm, int severity)
 {
+    const QString type = QString::fromLatin1(rhythmName(rhythm));
     m_alertMessage = QString("Arrhythmia detected: %1").arg(type);
     m_alertLevel = severity;
     emit alertTriggered();
@@ -258,76 +1088,47 @@ void HMController::onArrhythmiaDetected(const QString& type, int severity)
     qWarning() << "Arrhythmia alert:" << type << "severity:" << severity;
 }
 
-void HMController::updateHeartRate()
+void HMController::onExportProgress(double progress)
 {
-    if (m_recentEcgData.size() < 100) {
-        return; // Need more data
-    }
-    
-    calculateHeartRate(m_recentEcgData);
+    m_exportProgress = progress;
+    emit exportProgressChanged();
+}
+
+void HMController::onExportFinished(bool success, const QString& message)
+{
+    // finished is emitted as the last thing run() does; the pool thread may
+    // still be unwinding, so let the event loop delete the exporter
+    m_exporter->deleteLater();
+    m_exporter = nullptr;
+    emit exportStatusChanged();
+    emit dataExported(success, message);
+}
+
+void HMController::onImportProgress(double progress)
+{
+    m_importProgress = progress;
+    emit importProgressChanged();
+}
+
+void HMController::onImportFinished(bool success, const QString& message)
+{
+    m_importer->deleteLater();
+    m_importer = nullptr;
+    emit importStatusChanged();
+    emit dataImported(success, message);
 }
 
 void HMController::saveEcgReading(double voltage, quint64 timestamp, int heartRate)
 {
-    QSqlQuery query;
-    query.prepare("INSERT INTO ecg_readings (timestamp, voltage, heart_rate) VALUES (?, ?, ?)");
-    query.addBindValue(timestamp);
-    query.addBindValue(voltage);
-    query.addBindValue(heartRate > 0 ? heartRate : QVariant());
-    
-    if (!query.exec()) {
-        qWarning() << "Failed to save ECG reading:" << query.lastError().text();
+    // Committed in batches by the storage writer thread
+    if (m_storageWriter) {
+        m_storageWriter->enqueue(voltage, timestamp, m_sampleRate, heartRate, m_currentSessionId);
     }
 }
 
-void HMController::calculateHeartRate(const QList<double>& ecgData)
+void HMController::saveEcgBlock(const EcgSampleBlock& block, int heartRate)
 {
-    if (ecgData.size() < 100 || m_recentTimestamps.size() != ecgData.size()) {
-        return;
-    }
-    
-    // Simple R-peak detection algorithm
-    QList<int> rPeaks;
-    double threshold = 0.5; // Adjust based on your ECG signal characteristics
-    
-    // Find peaks that are above threshold and local maxima
-    for (int i = 2; i < ecgData.size() - 2; ++i) {
-        if (ecgData[i] > threshold &&
-            ecgData[i] > ecgData[i-1] && ecgData[i] > ecgData[i+1] &&
-            ecgData[i] > ecgData[i-2] && ecgData[i] > ecgData[i+2]) {
-            
-            // Check if this peak is far enough from the last one (minimum 300ms)
-            if (rPeaks.isEmpty() || (m_recentTimestamps[i] - m_recentTimestamps[rPeaks.last()]) > 300) {
-                rPeaks.append(i);
-            }
-        }
-    }
-    
-    // Calculate heart rate from R-R intervals
-    if (rPeaks.size() >= 3) {
-        double totalInterval = 0;
-        int intervalCount = 0;
-        
-        for (int i = 1; i < rPeaks.size(); ++i) {
-            double interval = m_recentTimestamps[rPeaks[i]] - m_recentTimestamps[rPeaks[i-1]];
-            if (interval > 300 && interval < 2000) { // Valid R-R interval (30-200 BPM range)
-                totalInterval += interval;
-                intervalCount++;
-            }
-        }
-        
-        if (intervalCount > 0) {
-            double avgInterval = totalInterval / intervalCount;
-            int newHeartRate = qRound(60000.0 / avgInterval); // Convert to BPM
-            
-            // Smooth the heart rate to avoid rapid fluctuations
-            if (m_currentHeartRate == 0) {
-                m_currentHeartRate = newHeartRate;
-            } else {
-                m_currentHeartRate = (m_currentHeartRate * 3 + newHeartRate) / 4;
-            }
-            
-            emit heartRateChanged();
-        }
+    if (m_storageWriter) {
+        m_storageWriter->enqueueBlock(block, m_sampleRate, heartRate, m_currentSessionId);
     }
-}
\ No newline at end of file
+}
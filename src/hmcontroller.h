@@ -1,6 +1,7 @@
 
 #include <QObject>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QDateTime>
 #include <QQmlEngine>
 #include <QtQml>
@@ -10,10 +11,25 @@
 #include <QSqlError>
 #include <QDir>
 #include <QStandardPaths>
+#include <QVariantMap>
+#include <memory>
+#include <vector>
+
+#include "arrhythmiaworker.h"
+#include "ecgsample.h"
 
 class EcgDataModel;
+class LiveWaveformBuffer;
 class BluetoothManager;
 class ArrhythmiaDetector;
+class EcgStorageWriter;
+class EcgExporter;
+class EcgImporter;
+class EcgReplaySource;
+class LatencyMonitor;
+class PipelineScheduler;
+struct EcgStream;
+QT_FORWARD_DECLARE_CLASS(QThread)
 
 class HMController : public QObject
 {
@@ -25,8 +41,17 @@ class HMController : public QObject
     Q_PROPERTY(QString connectionStatus READ connectionStatus NOTIFY connectionStatusChanged)
     Q_PROPERTY(bool isRecording READ isRecording NOTIFY recordingStatusChanged)
     Q_PROPERTY(EcgDataModel* ecgDataModel READ ecgDataModel CONSTANT)
+    Q_PROPERTY(LiveWaveformBuffer* liveWaveform READ liveWaveform CONSTANT)
     Q_PROPERTY(QString alertMessage READ alertMessage NOTIFY alertTriggered)
     Q_PROPERTY(int alertLevel READ alertLevel NOTIFY alertTriggered)
+    Q_PROPERTY(QVariantMap storageStatistics READ storageStatistics NOTIFY storageStatisticsChanged)
+    Q_PROPERTY(bool isExporting READ isExporting NOTIFY exportStatusChanged)
+    Q_PROPERTY(double exportProgress READ exportProgress NOTIFY exportProgressChanged)
+    Q_PROPERTY(bool isImporting READ isImporting NOTIFY importStatusChanged)
+    Q_PROPERTY(double importProgress READ importProgress NOTIFY importProgressChanged)
+    Q_PROPERTY(int streamCount READ streamCount NOTIFY streamsChanged)
+    Q_PROPERTY(bool isReplaying READ isReplaying NOTIFY replayStatusChanged)
+    Q_PROPERTY(QVariantMap latencyStatistics READ latencyStatistics NOTIFY latencyStatisticsChanged)
 
 public:
     explicit HMController(QObject* parent = nullptr);
@@ -38,8 +63,17 @@ public:
     QString connectionStatus() const;
     bool isRecording() const;
     EcgDataModel* ecgDataModel() const;
+    // Live samples for the waveform view, read once per frame
+    LiveWaveformBuffer* liveWaveform() const;
     QString alertMessage() const;
     int alertLevel() const;
+    QVariantMap storageStatistics() const;
+    QVariantMap latencyStatistics() const;
+    bool isExporting() const;
+    double exportProgress() const;
+    bool isImporting() const;
+    double importProgress() const;
+    int streamCount() const;
 
     // Invokable methods for QML
     Q_INVOKABLE void startConnection();
@@ -47,8 +81,52 @@ public:
     Q_INVOKABLE void startRecording();
     Q_INVOKABLE void stopRecording();
     Q_INVOKABLE void exportData(const QString& filePath);
+    Q_INVOKABLE void exportRange(const QString& filePath, qint64 fromTime, qint64 toTime, qint64 sessionId = 0);
+    Q_INVOKABLE void cancelExport();
+    Q_INVOKABLE void importData(const QString& filePath);
+    Q_INVOKABLE QVariantList getSessions();
+    // Zoomable history: up to `columns` {startTime, endTime, min, max, mean,
+    // count} maps over [fromTime, toTime) from the min/max pyramid, at any
+    // zoom and without reading raw samples. sessionId < 0 covers all sessions.
+    Q_INVOKABLE QVariantList waveformOverview(qint64 fromTime, qint64 toTime, int columns, qint64 sessionId = -1);
+    Q_INVOKABLE QVariantMap acquisitionStatistics() const;
     Q_INVOKABLE void clearHistory();
     Q_INVOKABLE QVariantList getAvailableDevices();
+    
+    // Additional streams (central-station mode), processed on the pipeline pool.
+    // scenario is an EcgSimulator script such as "afib" or "normal:60,pvc:30";
+    // unthrottled streams generate as fast as their pipelines drain.
+    Q_INVOKABLE int addSimulatedStreams(int count, int sampleRate = 250, const QString& scenario = "normal",
+                                        bool unthrottled = false);
+    Q_INVOKABLE void removeStreams();
+    Q_INVOKABLE QVariantList streamStatistics() const;
+
+    // Replays an EDF/HMRAW file or a recorded session id through the live
+    // analysis path in place of the device. speed is a multiple of real
+    // time; 0 runs as fast as processing keeps up.
+    Q_INVOKABLE bool startReplay(const QString& source, double speed = 1.0);
+    Q_INVOKABLE void stopReplay();
+    Q_INVOKABLE QVariantMap replayStatistics() const;
+    bool isReplaying() const { return m_replaySource != nullptr; }
+
+    // Per-stage latency histograms (ingest, parse, detect, store, UI delivery)
+    // in microseconds, for the device path only: simulated streams report
+    // their run latency in streamStatistics(). The JSON form is also written
+    // to the dump file, if one is set, every LATENCY_REPORT_INTERVAL_MS.
+    Q_INVOKABLE QString latencyStatisticsJson() const;
+    Q_INVOKABLE void resetLatencyStatistics();
+    Q_INVOKABLE void setLatencyDumpPath(const QString& filePath);
+    // Mains frequency notched by the front-end filters (50 or 60 Hz); applies
+    // to the device stream now and to streams added later
+    Q_INVOKABLE void setMainsFrequency(double hz);
+    Q_INVOKABLE double mainsFrequency() const;
+    // Called by the graph after painting; closes the UI delivery stage
+    Q_INVOKABLE void reportFramePainted();
+
+    // Block-based sample path: storage and model handle the whole block at
+    // once, and it is queued to analysis as one. onNewEcgReading() adapts
+    // single samples to it.
+    void processBlock(const EcgSampleBlock& block);
 
 signals:
     void connectionStatusChanged();
@@ -56,37 +134,96 @@ signals:
     void recordingStatusChanged();
     void alertTriggered();
     void dataExported(bool success, const QString& message);
-    void newEcgData(double value, double timestamp);
+    void dataImported(bool success, const QString& message);
+    void storageStatisticsChanged();
+    void exportStatusChanged();
+    void exportProgressChanged();
+    void importStatusChanged();
+    void importProgressChanged();
+    void streamsChanged();
+    void replayStatusChanged();
+    void replayFinished(bool success, const QString& message);
+    void latencyStatisticsChanged();
 
 private slots:
     void onNewEcgReading(double voltage, quint64 timestamp);
+    void drainSamples();
     void onConnectionStateChanged(bool connected);
-    void onArrhythmiaDetected(const QString& type, int severity);
-    void updateHeartRate();
+    void onArrhythmiaDetected(RhythmType rhythm, int severity);
+    void onSamplesFiltered(const EcgSampleBuffer& filtered);
+    void onExportProgress(double progress);
+    void onExportFinished(bool success, const QString& message);
+    void onImportProgress(double progress);
+    void onImportFinished(bool success, const QString& message);
+    void onReplayStarted(double sampleRate, qint64 totalSamples);
+    void onReplaySamples(qint64 wakeupNs);
+    void onReplayFinished(bool success, const QString& message);
+    void onLatencyReportTimer();
 
 private:
     void initializeDatabase();
+    void migrateLegacyReadings();
+    void rebuildPyramid();
+    void loadHistory();
+    void startStorageWriter();
+    void stopStorageWriter();
+    void startAcquisitionThread();
+    void stopAcquisitionThread();
     void saveEcgReading(double voltage, quint64 timestamp, int heartRate);
-    void calculateHeartRate(const QList<double>& ecgData);
+    void saveEcgBlock(const EcgSampleBlock& block, int heartRate);
+    qint64 beginSession();
+    void endSession(qint64 sessionId);
+    void updateStorageCapacity();
+    qint64 drainRing();
+    void setSampleRate(double sampleRate); // Of the device or replay feeding processBlock()
 
     EcgDataModel* m_ecgDataModel;
+    LiveWaveformBuffer* m_liveWaveform;
     BluetoothManager* m_bluetoothManager;
     ArrhythmiaDetector* m_arrhythmiaDetector;
+    QThread* m_acquisitionThread;
+    std::unique_ptr<EcgSampleRing> m_sampleRing;
+    std::unique_ptr<LatencyMonitor> m_latencyMonitor;
+    QTimer* m_latencyReportTimer;
+    QString m_latencyDumpPath;
+    double m_sampleRate; // Of the device or replay, as set by setSampleRate()
+    qint64 m_oldestUnpaintedArrivalNs; // Oldest sample handed to the graph since its last paint
+    EcgStorageWriter* m_storageWriter;
+    QThread* m_storageThread;
+    EcgExporter* m_exporter;
+    EcgImporter* m_importer;
+    double m_exportProgress;
+    double m_importProgress;
+    qint64 m_currentSessionId;
+    std::unique_ptr<PipelineScheduler> m_pipelineScheduler;
+    std::vector<std::unique_ptr<EcgStream>> m_streams;
+    
+    // Replay in place of the device, with its throughput and latency
+    EcgReplaySource* m_replaySource;
+    double m_replaySpeed;
+    double m_replaySampleRate;
+    qint64 m_replayTotalSamples;
+    qint64 m_replayProcessedSamples;
+    qint64 m_replayWakeups;
+    qint64 m_replayLatencySumNs;
+    qint64 m_replayMaxLatencyNs;
+    qint64 m_replayElapsedMs;
+    QElapsedTimer m_replayClock;
     
     QSqlDatabase m_database;
-    QTimer* m_heartRateTimer;
+    QString m_databasePath;
     
     bool m_isConnected;
     bool m_isRecording;
-    int m_currentHeartRate;
     QString m_connectionStatus;
     QString m_alertMessage;
     int m_alertLevel;
     
-    QList<double> m_recentEcgData;
-    QList<quint64> m_recentTimestamps;
-    quint64 m_lastHeartRateCalculation;
-    
-    static const int MAX_RECENT_SAMPLES = 500;
-    static const int HEART_RATE_WINDOW_MS = 10000; // 10 seconds
+    static const int HISTORY_SEGMENTS = 40; // Seconds of stored signal loaded at startup
+    static const int MAX_OVERVIEW_COLUMNS = 4096;
+    static const int DRAIN_BLOCK_SIZE = 256; // Samples taken from the ring per pop
+    static const int MAX_BLOCK_GAP_MS = 100; // Larger timestamp jumps start a new block
+    static const int MAX_STREAMS = 64;
+    static const int STORAGE_QUEUE_SECONDS = 60; // Storage queue headroom per stream, at its rate
+    static const int LATENCY_REPORT_INTERVAL_MS = 5000;
 };
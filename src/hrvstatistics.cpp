@@ -0,0 +1,223 @@
+#include "hrvstatistics.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr double MINUTE_MS = 60.0 * 1000.0;
+constexpr double NN50_THRESHOLD_MS = 50.0;
+constexpr double CONTIGUITY_TOLERANCE_MS = 1.0; // Rounding slack when chaining intervals
+}
+
+// Accumulator
+
+void HrvStatistics::Accumulator::add(double rr, bool hasDifference, double difference)
+{
+    ++count;
+    sum += rr;
+    sumSquares += rr * rr;
+    if (hasDifference) {
+        ++differenceCount;
+        differenceSquares += difference * difference;
+        nn50 += std::abs(difference) > NN50_THRESHOLD_MS ? 1 : 0;
+    }
+}
+
+void HrvStatistics::Accumulator::add(const Accumulator &other)
+{
+    count += other.count;
+    sum += other.sum;
+    sumSquares += other.sumSquares;
+    differenceCount += other.differenceCount;
+    differenceSquares += other.differenceSquares;
+    nn50 += other.nn50;
+}
+
+void HrvStatistics::Accumulator::subtract(const Accumulator &other)
+{
+    count -= other.count;
+    sum -= other.sum;
+    sumSquares -= other.sumSquares;
+    differenceCount -= other.differenceCount;
+    differenceSquares -= other.differenceSquares;
+    nn50 -= other.nn50;
+}
+
+HrvMetrics HrvStatistics::Accumulator::metrics() const
+{
+    HrvMetrics result;
+    result.beats = std::size_t(count);
+    if (count == 0) {
+        return result;
+    }
+
+    result.meanRR = sum / double(count);
+    if (count > 1) {
+        double variance = (sumSquares - sum * result.meanRR) / double(count - 1);
+        result.sdnn = std::sqrt(std::max(0.0, variance));
+    }
+    if (differenceCount > 0) {
+        result.rmssd = std::sqrt(std::max(0.0, differenceSquares) / double(differenceCount));
+        result.pnn50 = 100.0 * double(nn50) / double(differenceCount);
+    }
+    return result;
+}
+
+// BeatWindow
+
+void HrvStatistics::BeatWindow::add(double rr, bool hasDifference, double difference)
+{
+    Entry &entry = m_entries[m_position];
+    if (m_size == m_entries.size()) {
+        Accumulator expired;
+        expired.add(entry.rr, entry.hasDifference, entry.difference);
+        m_total.subtract(expired);
+    } else {
+        ++m_size;
+    }
+
+    entry.rr = rr;
+    entry.hasDifference = hasDifference;
+    entry.difference = difference;
+    m_total.add(rr, hasDifference, difference);
+
+    m_position = (m_position + 1) % m_entries.size();
+    if (m_position == 0) {
+        // Re-sum once per lap so subtraction rounding cannot accumulate
+        m_total = Accumulator();
+        for (const Entry &e : m_entries) {
+            m_total.add(e.rr, e.hasDifference, e.difference);
+        }
+    }
+}
+
+void HrvStatistics::BeatWindow::reset()
+{
+    m_entries.fill(Entry());
+    m_position = 0;
+    m_size = 0;
+    m_total = Accumulator();
+}
+
+// TimeWindow
+
+HrvStatistics::TimeWindow::TimeWindow(double durationMs)
+    : m_bucketWidth(durationMs / double(BUCKET_COUNT))
+    , m_buckets(BUCKET_COUNT)
+    , m_headBucket(0)
+    , m_empty(true)
+{
+}
+
+void HrvStatistics::TimeWindow::add(double time, double rr, bool hasDifference, double difference)
+{
+    const auto bucket = std::int64_t(std::floor(time / m_bucketWidth));
+    if (m_empty) {
+        m_headBucket = bucket;
+        m_empty = false;
+    } else if (bucket > m_headBucket) {
+        advanceTo(bucket);
+    } else if (bucket <= m_headBucket - std::int64_t(BUCKET_COUNT)) {
+        return; // Older than the window
+    }
+
+    Accumulator beat;
+    beat.add(rr, hasDifference, difference);
+    m_buckets[std::size_t(bucket % std::int64_t(BUCKET_COUNT))].add(beat);
+    m_total.add(beat);
+}
+
+void HrvStatistics::TimeWindow::advanceTo(std::int64_t bucket)
+{
+    if (bucket - m_headBucket >= std::int64_t(BUCKET_COUNT)) {
+        // The whole window has expired
+        std::fill(m_buckets.begin(), m_buckets.end(), Accumulator());
+        m_total = Accumulator();
+        m_headBucket = bucket;
+        return;
+    }
+
+    bool wrapped = false;
+    while (m_headBucket < bucket) {
+        ++m_headBucket;
+        Accumulator &expired = m_buckets[std::size_t(m_headBucket % std::int64_t(BUCKET_COUNT))];
+        m_total.subtract(expired);
+        expired = Accumulator();
+        wrapped = wrapped || m_headBucket % std::int64_t(BUCKET_COUNT) == 0;
+    }
+
+    // Re-sum once per lap so subtraction rounding cannot accumulate
+    if (wrapped) {
+        recomputeTotal();
+    }
+}
+
+void HrvStatistics::TimeWindow::recomputeTotal()
+{
+    m_total = Accumulator();
+    for (const Accumulator &bucket : m_buckets) {
+        m_total.add(bucket);
+    }
+}
+
+void HrvStatistics::TimeWindow::reset()
+{
+    std::fill(m_buckets.begin(), m_buckets.end(), Accumulator());
+    m_headBucket = 0;
+    m_empty = true;
+    m_total = Accumulator();
+}
+
+// HrvStatistics
+
+HrvStatistics::HrvStatistics()
+    : m_timeWindows{TimeWindow(5 * MINUTE_MS), TimeWindow(60 * MINUTE_MS), TimeWindow(24 * 60 * MINUTE_MS)}
+    , m_previousTime(0.0)
+    , m_previousRR(0.0)
+    , m_havePrevious(false)
+{
+}
+
+void HrvStatistics::addBeat(double time, double rrInterval)
+{
+    // A successive difference needs the previous interval to end where this one starts
+    const bool hasDifference = m_havePrevious
+        && std::abs((time - rrInterval) - m_previousTime) <= CONTIGUITY_TOLERANCE_MS;
+    const double difference = hasDifference ? rrInterval - m_previousRR : 0.0;
+
+    m_shortTerm.add(rrInterval, hasDifference, difference);
+    for (TimeWindow &window : m_timeWindows) {
+        window.add(time, rrInterval, hasDifference, difference);
+    }
+
+    m_previousTime = time;
+    m_previousRR = rrInterval;
+    m_havePrevious = true;
+}
+
+void HrvStatistics::reset()
+{
+    m_shortTerm.reset();
+    for (TimeWindow &window : m_timeWindows) {
+        window.reset();
+    }
+    m_previousTime = 0.0;
+    m_previousRR = 0.0;
+    m_havePrevious = false;
+}
+
+HrvMetrics HrvStatistics::metrics(Window window) const
+{
+    if (window == ShortTerm) {
+        return m_shortTerm.total().metrics();
+    }
+    return m_timeWindows[window - 1].total().metrics();
+}
+
+std::size_t HrvStatistics::beatCount(Window window) const
+{
+    if (window == ShortTerm) {
+        return std::size_t(m_shortTerm.total().count);
+    }
+    return std::size_t(m_timeWindows[window - 1].total().count);
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Time-domain HRV over several concurrent sliding windows.
+//
+// Every window keeps running sums (count, sum, sum of squares, squared
+// successive differences, NN50 count) so adding a beat and reading the
+// metrics are O(1). The beat-count window stores its beats exactly; time
+// windows aggregate beats into a fixed number of buckets, so a 24 hour
+// window costs the same memory as a 5 minute one and expires in steps of
+// 1/BUCKET_COUNT of its length. Windows end at the most recent beat.
+struct HrvMetrics {
+    std::size_t beats = 0;
+    double meanRR = 0.0; // ms
+    double sdnn = 0.0;   // ms
+    double rmssd = 0.0;  // ms
+    double pnn50 = 0.0;  // Percent of successive differences > 50 ms
+};
+
+class HrvStatistics
+{
+public:
+    enum Window {
+        ShortTerm,  // Last 20 beats
+        FiveMinutes,
+        OneHour,
+        TwentyFourHours,
+        WindowCount
+    };
+
+    HrvStatistics();
+
+    // rrInterval is the NN interval ending at time (both ms). Successive
+    // differences are only formed between back-to-back intervals.
+    void addBeat(double time, double rrInterval);
+    void reset();
+
+    HrvMetrics metrics(Window window) const;
+    std::size_t beatCount(Window window) const;
+
+    static constexpr std::size_t SHORT_TERM_BEATS = 20;
+    static constexpr std::size_t BUCKET_COUNT = 300;
+
+private:
+    struct Accumulator {
+        std::uint64_t count = 0;
+        double sum = 0.0;
+        double sumSquares = 0.0;
+        std::uint64_t differenceCount = 0;
+        double differenceSquares = 0.0;
+        std::uint64_t nn50 = 0;
+
+        void add(double rr, bool hasDifference, double difference);
+        void add(const Accumulator &other);
+        void subtract(const Accumulator &other);
+        HrvMetrics metrics() const;
+    };
+
+    // Exact window over the last N beats
+    class BeatWindow
+    {
+    public:
+        void add(double rr, bool hasDifference, double difference);
+        void reset();
+        const Accumulator &total() const { return m_total; }
+
+    private:
+        struct Entry {
+            double rr = 0.0;
+            bool hasDifference = false;
+            double difference = 0.0;
+        };
+        std::array<Entry, SHORT_TERM_BEATS> m_entries{};
+        std::size_t m_position = 0;
+        std::size_t m_size = 0;
+        Accumulator m_total;
+    };
+
+    // Bucketed window over a duration
+    class TimeWindow
+    {
+    public:
+        explicit TimeWindow(double durationMs = 0.0);
+        void add(double time, double rr, bool hasDifference, double difference);
+        void reset();
+        const Accumulator &total() const { return m_total; }
+
+    private:
+        void advanceTo(std::int64_t bucket);
+        void recomputeTotal();
+
+        double m_bucketWidth;
+        std::vector<Accumulator> m_buckets; // BUCKET_COUNT, allocated once
+        std::int64_t m_headBucket;          // Absolute index of the newest bucket
+        bool m_empty;
+        Accumulator m_total;
+    };
+
+    BeatWindow m_shortTerm;
+    std::array<TimeWindow, WindowCount - 1> m_timeWindows;
+
+    double m_previousTime;
+    double m_previousRR;
+    bool m_havePrevious;
+};
@@ -0,0 +1,118 @@
+#include "latencymonitor.h"
+
+#include <bit>
+
+std::size_t LatencyHistogram::bucketFor(std::uint64_t ns)
+{
+    if (ns < SUB_BUCKETS) {
+        return std::size_t(ns);
+    }
+
+    unsigned exponent = unsigned(std::bit_width(ns)) - 1;
+    if (exponent > MAX_EXPONENT) {
+        return BUCKET_COUNT - 1;
+    }
+    // Top SUB_BUCKET_BITS bits below the leading one pick the sub-bucket
+    std::size_t sub = std::size_t(ns >> (exponent - SUB_BUCKET_BITS)) - SUB_BUCKETS;
+    return SUB_BUCKETS * (exponent - SUB_BUCKET_BITS + 1) + sub;
+}
+
+std::uint64_t LatencyHistogram::bucketUpperBound(std::size_t index)
+{
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+
+    unsigned exponent = unsigned(index / SUB_BUCKETS) + SUB_BUCKET_BITS - 1;
+    std::uint64_t sub = index % SUB_BUCKETS;
+    std::uint64_t width = std::uint64_t(1) << (exponent - SUB_BUCKET_BITS);
+    return ((SUB_BUCKETS + sub) << (exponent - SUB_BUCKET_BITS)) + width - 1;
+}
+
+void LatencyHistogram::record(std::int64_t ns)
+{
+    const std::uint64_t value = ns > 0 ? std::uint64_t(ns) : 0;
+    m_buckets[bucketFor(value)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sumNs.fetch_add(value, std::memory_order_relaxed);
+
+    std::uint64_t max = m_maxNs.load(std::memory_order_relaxed);
+    while (value > max && !m_maxNs.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const
+{
+    // Counters are read one by one while writers continue, so the result is
+    // approximate by at most the samples recorded during the read
+    std::array<std::uint64_t, BUCKET_COUNT> counts;
+    std::uint64_t total = 0;
+    for (std::size_t i = 0; i < BUCKET_COUNT; ++i) {
+        counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    Snapshot snapshot;
+    snapshot.count = total;
+    snapshot.maxNs = m_maxNs.load(std::memory_order_relaxed);
+    if (total == 0) {
+        return snapshot;
+    }
+    snapshot.meanNs = double(m_sumNs.load(std::memory_order_relaxed)) / double(m_count.load(std::memory_order_relaxed));
+
+    const std::uint64_t thresholds[] = {
+        (total * 50 + 99) / 100,
+        (total * 90 + 99) / 100,
+        (total * 99 + 99) / 100,
+        (total * 999 + 999) / 1000,
+    };
+    std::uint64_t *results[] = {&snapshot.p50Ns, &snapshot.p90Ns, &snapshot.p99Ns, &snapshot.p999Ns};
+
+    std::size_t next = 0;
+    std::uint64_t cumulative = 0;
+    for (std::size_t i = 0; i < BUCKET_COUNT && next < 4; ++i) {
+        cumulative += counts[i];
+        while (next < 4 && cumulative >= thresholds[next]) {
+            // A bucket's bound can exceed the largest value actually seen
+            std::uint64_t bound = bucketUpperBound(i);
+            *results[next++] = bound < snapshot.maxNs ? bound : snapshot.maxNs;
+        }
+    }
+    return snapshot;
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto &bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_sumNs.store(0, std::memory_order_relaxed);
+    m_maxNs.store(0, std::memory_order_relaxed);
+}
+
+void LatencyMonitor::reset()
+{
+    for (LatencyHistogram &histogram : m_histograms) {
+        histogram.reset();
+    }
+}
+
+const char *LatencyMonitor::stageName(LatencyStage stage)
+{
+    switch (stage) {
+    case LatencyStage::Ingest:
+        return "ingest";
+    case LatencyStage::Parse:
+        return "parse";
+    case LatencyStage::Detect:
+        return "detect";
+    case LatencyStage::Store:
+        return "store";
+    case LatencyStage::UiDelivery:
+        return "uiDelivery";
+    case LatencyStage::Count:
+        break;
+    }
+    return "unknown";
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Lock-free latency histogram. Buckets are log-linear (eight per power of
+// two, so about 12% resolution) from 1 ns to ~70 min; record() is three
+// relaxed atomic adds and is safe from any number of threads.
+class LatencyHistogram
+{
+public:
+    struct Snapshot {
+        std::uint64_t count = 0;
+        double meanNs = 0.0;
+        std::uint64_t p50Ns = 0;
+        std::uint64_t p90Ns = 0;
+        std::uint64_t p99Ns = 0;
+        std::uint64_t p999Ns = 0;
+        std::uint64_t maxNs = 0;
+    };
+
+    void record(std::int64_t ns);
+    Snapshot snapshot() const;
+    void reset();
+
+    static constexpr unsigned SUB_BUCKET_BITS = 3;
+    static constexpr std::size_t SUB_BUCKETS = std::size_t(1) << SUB_BUCKET_BITS;
+    static constexpr unsigned MAX_EXPONENT = 41;
+    static constexpr std::size_t BUCKET_COUNT = SUB_BUCKETS * (MAX_EXPONENT - SUB_BUCKET_BITS + 2);
+
+    static std::size_t bucketFor(std::uint64_t ns);
+    static std::uint64_t bucketUpperBound(std::size_t index); // Highest value in the bucket
+
+private:
+    std::array<std::atomic<std::uint64_t>, BUCKET_COUNT> m_buckets{};
+    std::atomic<std::uint64_t> m_count{0};
+    std::atomic<std::uint64_t> m_sumNs{0};
+    std::atomic<std::uint64_t> m_maxNs{0};
+};
+
+// Where a sample's time goes between arriving at the acquisition thread and
+// being committed or painted. Every stage except Parse is measured from the
+// sample's arrival stamp (EcgSample::arrivalNs); Parse is the cost of
+// decoding one sample from the device stream.
+enum class LatencyStage {
+    Ingest,     // Arrival until popped from the ring by processing
+    Parse,      // Decoding, per sample
+    Detect,     // Arrival until beat detection has consumed the sample
+    Store,      // Arrival until the storage writer committed it
+    UiDelivery, // Arrival until a frame showing it was painted
+    Count
+};
+
+class LatencyMonitor
+{
+public:
+    void record(LatencyStage stage, std::int64_t ns) { m_histograms[std::size_t(stage)].record(ns); }
+    void recordSince(LatencyStage stage, std::int64_t startNs) { record(stage, nowNs() - startNs); }
+
+    LatencyHistogram::Snapshot snapshot(LatencyStage stage) const { return m_histograms[std::size_t(stage)].snapshot(); }
+    void reset();
+
+    static const char *stageName(LatencyStage stage);
+
+    // Steady clock shared by all stamps
+    static std::int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    std::array<LatencyHistogram, std::size_t(LatencyStage::Count)> m_histograms;
+};
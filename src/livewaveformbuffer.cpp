@@ -0,0 +1,39 @@
+#include "livewaveformbuffer.h"
+
+LiveWaveformBuffer::LiveWaveformBuffer(int capacity, QObject *parent)
+    : QObject(parent)
+    , m_timestamps(qMax(capacity, 1))
+    , m_voltages(qMax(capacity, 1))
+    , m_written(0)
+    , m_notified(false)
+{
+}
+
+void LiveWaveformBuffer::append(const EcgSampleBlock &block)
+{
+    const quint64 size = m_voltages.size();
+    for (qsizetype i = 0; i < block.count; ++i) {
+        const std::size_t slot = std::size_t((m_written + quint64(i)) % size);
+        m_voltages[slot] = float(block.samples[i]);
+        m_timestamps[slot] = block.timeAt(i);
+    }
+    m_written += quint64(block.count);
+    notify();
+}
+
+void LiveWaveformBuffer::append(double voltage, double timestamp)
+{
+    const std::size_t slot = std::size_t(m_written % m_voltages.size());
+    m_voltages[slot] = float(voltage);
+    m_timestamps[slot] = timestamp;
+    ++m_written;
+    notify();
+}
+
+void LiveWaveformBuffer::notify()
+{
+    if (!m_notified) {
+        m_notified = true;
+        emit samplesAppended();
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <QObject>
+#include <vector>
+
+#include "ecgsample.h"
+
+// Live samples on their way to the display. The controller appends whole
+// blocks; views keep their own read cursor and pull everything new once per
+// frame (EcgWaveformItem does so in updatePolish), so neither QML nor the
+// signal system sees individual samples. samplesAppended() is emitted once
+// per batch of appends between reads, to schedule the next frame.
+// GUI thread only.
+class LiveWaveformBuffer : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int capacity READ capacity CONSTANT)
+
+public:
+    explicit LiveWaveformBuffer(int capacity = DEFAULT_CAPACITY, QObject *parent = nullptr);
+
+    void append(const EcgSampleBlock &block);
+    void append(double voltage, double timestamp);
+
+    // Calls fn(voltage, timestamp) for every sample appended since cursor,
+    // oldest first, and advances cursor. A reader more than capacity behind
+    // skips to the oldest sample still held. Returns the samples read.
+    template <typename Fn>
+    qsizetype read(quint64 &cursor, Fn &&fn);
+
+    // Cursor of a reader that wants only samples appended from now on
+    quint64 written() const { return m_written; }
+    int capacity() const { return int(m_voltages.size()); }
+
+    static constexpr int DEFAULT_CAPACITY = 16384; // >16 s at 1000 Hz between frames
+
+signals:
+    void samplesAppended();
+
+private:
+    void notify();
+
+    std::vector<double> m_timestamps;
+    std::vector<float> m_voltages;
+    quint64 m_written; // Samples appended so far; sample n is at n % capacity
+    bool m_notified;
+};
+
+template <typename Fn>
+qsizetype LiveWaveformBuffer::read(quint64 &cursor, Fn &&fn)
+{
+    m_notified = false;
+
+    const quint64 size = m_voltages.size();
+    const quint64 oldest = m_written > size ? m_written - size : 0;
+    if (cursor < oldest || cursor > m_written) {
+        cursor = oldest;
+    }
+
+    const qsizetype count = qsizetype(m_written - cursor);
+    for (; cursor < m_written; ++cursor) {
+        const std::size_t i = std::size_t(cursor % size);
+        fn(double(m_voltages[i]), m_timestamps[i]);
+    }
+    return count;
+}
@@ -3,6 +3,9 @@
 #include "ecgdatamodel.h"
 #include "bluetoothmanager.h"
 #include "arrhythmiadetector.h"
+#include "headlessrunner.h"
+#include "ecgwaveformitem.h"
+#include "livewaveformbuffer.h"
 
 #include <QApplication>
 #include <QQmlApplicationEngine>
@@ -15,6 +18,11 @@
 
 int main(int argc, char *argv[])
 {
+    // Recording servers: no QApplication, QML engine or scene graph
+    if (HeadlessRunner::isRequested(argc, argv)) {
+        return HeadlessRunner::run(argc, argv);
+    }
+
     QApplication app(argc, argv);
     app.setApplicationName("Heart Monitor");
     app.setApplicationVersion("1.0");
@@ -25,6 +33,8 @@ int main(int argc, char *argv[])
     qmlRegisterType<EcgDataModel>("HeartMonitor", 1, 0, "EcgDataModel");
     qmlRegisterType<BluetoothManager>("HeartMonitor", 1, 0, "BluetoothManager");
     qmlRegisterType<ArrhythmiaDetector>("HeartMonitor", 1, 0, "ArrhythmiaDetector");
+    qmlRegisterType<EcgWaveformItem>("HeartMonitor", 1, 0, "EcgWaveform");
+    qmlRegisterUncreatableType<LiveWaveformBuffer>("HeartMonitor", 1, 0, "LiveWaveformBuffer", "Provided by HMController");
 
     HMController hmController;
     int res = 1;
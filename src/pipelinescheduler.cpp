@@ -0,0 +1,136 @@
+#include "pipelinescheduler.h"
+#include "ecgpipeline.h"
+
+#include <algorithm>
+
+namespace {
+// Lets enqueue() recognise its own workers
+thread_local const PipelineScheduler *t_scheduler = nullptr;
+thread_local unsigned t_workerIndex = 0;
+}
+
+PipelineScheduler::PipelineScheduler(unsigned threadCount)
+    : m_nextWorker(0)
+    , m_steals(0)
+    , m_queued(0)
+    , m_outstanding(0)
+    , m_stopping(false)
+{
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    m_workers.reserve(threadCount);
+    for (unsigned i = 0; i < threadCount; ++i) {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+    for (unsigned i = 0; i < threadCount; ++i) {
+        m_workers[i]->thread = std::thread(&PipelineScheduler::workerLoop, this, i);
+    }
+}
+
+PipelineScheduler::~PipelineScheduler()
+{
+    {
+        std::lock_guard<std::mutex> locker(m_sleepMutex);
+        m_stopping = true;
+    }
+    m_wakeup.notify_all();
+
+    for (const auto &worker : m_workers) {
+        worker->thread.join();
+    }
+}
+
+void PipelineScheduler::notify(EcgPipeline *pipeline)
+{
+    if (pipeline->ring().requestWakeup()) {
+        schedule(pipeline);
+    }
+}
+
+void PipelineScheduler::schedule(EcgPipeline *pipeline)
+{
+    if (pipeline->tryClaim()) {
+        enqueue(pipeline);
+    }
+}
+
+void PipelineScheduler::enqueue(EcgPipeline *pipeline)
+{
+    m_outstanding.fetch_add(1);
+    m_queued.fetch_add(1);
+
+    if (t_scheduler == this) {
+        // Our own continuation: run it next on this core
+        Worker &worker = *m_workers[t_workerIndex];
+        std::lock_guard<std::mutex> locker(worker.mutex);
+        worker.queue.push_front(pipeline);
+    } else {
+        Worker &worker = *m_workers[m_nextWorker.fetch_add(1, std::memory_order_relaxed) % m_workers.size()];
+        std::lock_guard<std::mutex> locker(worker.mutex);
+        worker.queue.push_back(pipeline);
+    }
+
+    // Taking the lock orders this with a worker that is about to sleep
+    { std::lock_guard<std::mutex> locker(m_sleepMutex); }
+    m_wakeup.notify_one();
+}
+
+EcgPipeline *PipelineScheduler::take(unsigned index)
+{
+    {
+        Worker &own = *m_workers[index];
+        std::lock_guard<std::mutex> locker(own.mutex);
+        if (!own.queue.empty()) {
+            EcgPipeline *pipeline = own.queue.front();
+            own.queue.pop_front();
+            return pipeline;
+        }
+    }
+
+    // Steal the oldest work of another worker
+    for (std::size_t offset = 1; offset < m_workers.size(); ++offset) {
+        Worker &victim = *m_workers[(index + offset) % m_workers.size()];
+        std::lock_guard<std::mutex> locker(victim.mutex);
+        if (!victim.queue.empty()) {
+            EcgPipeline *pipeline = victim.queue.back();
+            victim.queue.pop_back();
+            m_steals.fetch_add(1, std::memory_order_relaxed);
+            return pipeline;
+        }
+    }
+    return nullptr;
+}
+
+void PipelineScheduler::workerLoop(unsigned index)
+{
+    t_scheduler = this;
+    t_workerIndex = index;
+
+    for (;;) {
+        if (EcgPipeline *pipeline = take(index)) {
+            m_queued.fetch_sub(1);
+            if (pipeline->run()) {
+                enqueue(pipeline);
+            }
+            if (m_outstanding.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> locker(m_sleepMutex);
+                m_idle.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> locker(m_sleepMutex);
+        m_wakeup.wait(locker, [this] { return m_stopping || m_queued.load() > 0; });
+        if (m_stopping && m_queued.load() == 0) {
+            return;
+        }
+    }
+}
+
+void PipelineScheduler::waitForIdle()
+{
+    std::unique_lock<std::mutex> locker(m_sleepMutex);
+    m_idle.wait(locker, [this] { return m_outstanding.load() == 0; });
+}
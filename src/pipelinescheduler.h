@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class EcgPipeline;
+
+// Runs EcgPipelines on a fixed set of worker threads (one per core by
+// default) with work stealing. Each worker has its own deque: work it
+// produces itself (a pipeline that re-claims after a run) goes to the front
+// of its own deque for cache locality, producers spread new work
+// round-robin, and an idle worker steals from the back of the others'
+// deques before sleeping. A pipeline is only ever queued once and runs on
+// one worker at a time, so each stream is processed in order.
+class PipelineScheduler
+{
+public:
+    explicit PipelineScheduler(unsigned threadCount = 0); // 0 = hardware concurrency
+    ~PipelineScheduler();
+
+    PipelineScheduler(const PipelineScheduler &) = delete;
+    PipelineScheduler &operator=(const PipelineScheduler &) = delete;
+
+    // Thread-safe. notify() is for producers after pushing into the
+    // pipeline's ring; schedule() when the ring's wake-up was already taken.
+    void notify(EcgPipeline *pipeline);
+    void schedule(EcgPipeline *pipeline);
+
+    // Blocks until no pipeline is queued or running
+    void waitForIdle();
+
+    unsigned threadCount() const { return unsigned(m_workers.size()); }
+    std::uint64_t stealCount() const { return m_steals.load(std::memory_order_relaxed); }
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<EcgPipeline *> queue;
+        std::thread thread;
+    };
+
+    void enqueue(EcgPipeline *pipeline);
+    EcgPipeline *take(unsigned index);
+    void workerLoop(unsigned index);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic<unsigned> m_nextWorker;
+    std::atomic<std::uint64_t> m_steals;
+
+    // Idle workers sleep on this; m_outstanding counts queued plus running
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeup;
+    std::condition_variable m_idle;
+    std::atomic<std::int64_t> m_queued;
+    std::atomic<std::int64_t> m_outstanding;
+    bool m_stopping;
+};
@@ -0,0 +1,270 @@
+#include "qrsdetector.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr double PI = 3.14159265358979323846;
+constexpr double BUTTERWORTH_Q = 0.70710678118654752440;
+constexpr double LOW_CUTOFF_HZ = 5.0;
+constexpr double HIGH_CUTOFF_HZ = 15.0;
+}
+
+QrsDetector::QrsDetector(double sampleRate)
+{
+    reset(sampleRate);
+}
+
+void QrsDetector::reset(double sampleRate)
+{
+    m_sampleRate = sampleRate > 0.0 ? sampleRate : 250.0;
+    m_sampleIndex = 0;
+
+    m_highPass = highPass(LOW_CUTOFF_HZ, m_sampleRate);
+    m_lowPass = lowPass(std::min(HIGH_CUTOFF_HZ, 0.45 * m_sampleRate), m_sampleRate);
+    m_derivativeHistory.fill(0.0);
+    m_derivativeGain = m_sampleRate / 8.0;
+
+    auto samples = [this](double seconds) {
+        return std::size_t(std::lround(seconds * m_sampleRate));
+    };
+    m_mwiLength = std::clamp<std::size_t>(samples(MWI_WINDOW_SECONDS), 1, MAX_WINDOW / 4);
+    m_mwiWindow.fill(0.0);
+    m_mwiPosition = 0;
+    m_mwiSum = 0.0;
+
+    // The band-pass delays the QRS by a few tens of milliseconds
+    m_filterDelay = std::clamp<std::size_t>(samples(0.04), 1, MAX_WINDOW / 4);
+    m_rSearchLength = m_mwiLength + m_filterDelay;
+    m_inputHistory.fill(0.0);
+    m_filteredHistory.fill(0.0);
+
+    m_previousMwi = 0.0;
+    m_rising = false;
+    m_maxSlope = 0.0;
+
+    m_learningLength = std::max<std::size_t>(1, samples(LEARNING_SECONDS));
+    m_learningMax = 0.0;
+    m_learningSum = 0.0;
+    m_learning = true;
+
+    m_signalLevel = 0.0;
+    m_noiseLevel = 0.0;
+    m_threshold1 = 0.0;
+    m_threshold2 = 0.0;
+
+    m_lastQrs = Peak();
+    m_haveQrs = false;
+    m_searchBackCandidate = Peak();
+    m_haveCandidate = false;
+    m_recentRR.fill(0.0);
+    m_recentRRCount = 0;
+    m_recentRRPosition = 0;
+    m_rrSum = 0.0;
+
+    m_lastBeat = Beat();
+    m_refractorySamples = samples(REFRACTORY_SECONDS);
+    m_tWaveSamples = samples(T_WAVE_SECONDS);
+}
+
+bool QrsDetector::process(double sample)
+{
+    const std::uint64_t index = m_sampleIndex++;
+    const std::size_t slot = index & HISTORY_MASK;
+    bool beat = false;
+
+    // Band-pass and five-point derivative
+    const double filtered = m_lowPass.process(m_highPass.process(sample));
+    const double derivative = m_derivativeGain
+        * (2.0 * filtered + m_derivativeHistory[0] - m_derivativeHistory[2] - 2.0 * m_derivativeHistory[3]);
+    m_derivativeHistory[3] = m_derivativeHistory[2];
+    m_derivativeHistory[2] = m_derivativeHistory[1];
+    m_derivativeHistory[1] = m_derivativeHistory[0];
+    m_derivativeHistory[0] = filtered;
+
+    m_inputHistory[slot] = sample;
+    m_filteredHistory[slot] = filtered;
+
+    // Squaring and moving-window integration
+    const double squared = derivative * derivative;
+    m_mwiSum += squared - m_mwiWindow[m_mwiPosition];
+    m_mwiWindow[m_mwiPosition] = squared;
+    if (++m_mwiPosition == m_mwiLength) {
+        m_mwiPosition = 0;
+    }
+    const double mwi = std::max(0.0, m_mwiSum) / double(m_mwiLength);
+
+    if (m_learning) {
+        m_learningMax = std::max(m_learningMax, mwi);
+        m_learningSum += mwi;
+        if (index + 1 >= m_learningLength) {
+            m_signalLevel = m_learningMax / 3.0;
+            m_noiseLevel = 0.5 * m_learningSum / double(m_learningLength);
+            updateThresholds();
+            m_learning = false;
+            m_lastQrs.index = index; // Reference point for the first search-back
+        }
+    } else {
+        // A peak of the integrated signal is the sample before it starts to fall
+        if (mwi > m_previousMwi) {
+            if (!m_rising) {
+                m_rising = true;
+                m_maxSlope = 0.0;
+            }
+            m_maxSlope = std::max(m_maxSlope, std::abs(derivative));
+        } else if (m_rising && mwi < m_previousMwi) {
+            m_rising = false;
+            Peak peak;
+            peak.index = index - 1;
+            peak.value = m_previousMwi;
+            peak.slope = m_maxSlope;
+            beat = classifyPeak(peak);
+        }
+
+        // Search-back: no QRS for too long, take the best candidate above threshold 2
+        if (!beat && m_haveCandidate) {
+            const double rrAverage = m_recentRRCount > 0 ? m_rrSum / double(m_recentRRCount) : m_sampleRate;
+            if (double(index - m_lastQrs.index) > SEARCH_BACK_FACTOR * rrAverage) {
+                m_signalLevel = 0.25 * m_searchBackCandidate.value + 0.75 * m_signalLevel;
+                acceptBeat(m_searchBackCandidate, m_threshold2, true);
+                beat = true;
+            }
+        }
+    }
+
+    m_previousMwi = mwi;
+    return beat;
+}
+
+std::size_t QrsDetector::processBlock(const double *samples, std::size_t count, Beat *beats, std::size_t maxBeats)
+{
+    std::size_t found = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (process(samples[i]) && found < maxBeats) {
+            beats[found++] = m_lastBeat;
+        }
+    }
+    return found;
+}
+
+bool QrsDetector::classifyPeak(Peak &peak)
+{
+    const std::uint64_t sinceLast = peak.index - m_lastQrs.index;
+    if (m_haveQrs && sinceLast < m_refractorySamples) {
+        return false;
+    }
+
+    if (peak.value > m_threshold1) {
+        // Within 360 ms of the last beat a shallow rise is most likely a T wave
+        bool tWave = m_haveQrs && sinceLast < m_tWaveSamples && peak.slope < 0.5 * m_lastQrs.slope;
+        if (!tWave) {
+            m_signalLevel = 0.125 * peak.value + 0.875 * m_signalLevel;
+            locateRPeak(peak);
+            acceptBeat(peak, m_threshold1, false);
+            return true;
+        }
+    }
+
+    m_noiseLevel = 0.125 * peak.value + 0.875 * m_noiseLevel;
+    updateThresholds();
+
+    if (peak.value > m_threshold2 && (!m_haveCandidate || peak.value > m_searchBackCandidate.value)) {
+        // Locate now, the history may have moved on by the time it is used
+        locateRPeak(peak);
+        m_searchBackCandidate = peak;
+        m_haveCandidate = true;
+    }
+    return false;
+}
+
+void QrsDetector::acceptBeat(const Peak &peak, double threshold, bool searchBack)
+{
+    updateThresholds();
+
+    if (m_haveQrs) {
+        const double rr = double(peak.rIndex - m_lastQrs.rIndex);
+        m_rrSum += rr - m_recentRR[m_recentRRPosition];
+        m_recentRR[m_recentRRPosition] = rr;
+        m_recentRRPosition = (m_recentRRPosition + 1) % RR_HISTORY;
+        m_recentRRCount = std::min(m_recentRRCount + 1, RR_HISTORY);
+    }
+
+    m_lastQrs = peak;
+    m_haveQrs = true;
+    m_haveCandidate = false;
+
+    m_lastBeat.sampleIndex = peak.rIndex;
+    m_lastBeat.amplitude = peak.amplitude;
+    m_lastBeat.peakValue = peak.value;
+    m_lastBeat.threshold = threshold;
+    m_lastBeat.searchBack = searchBack;
+}
+
+void QrsDetector::updateThresholds()
+{
+    m_threshold1 = m_noiseLevel + 0.25 * (m_signalLevel - m_noiseLevel);
+    m_threshold2 = 0.5 * m_threshold1;
+}
+
+void QrsDetector::locateRPeak(Peak &peak) const
+{
+    // The R wave is the largest band-passed excursion inside the integration
+    // window that produced the peak
+    const std::uint64_t first = peak.index >= m_rSearchLength ? peak.index - m_rSearchLength : 0;
+    std::uint64_t best = peak.index;
+    double bestValue = -1.0;
+    for (std::uint64_t i = first; i <= peak.index; ++i) {
+        double value = std::abs(m_filteredHistory[i & HISTORY_MASK]);
+        if (value > bestValue) {
+            bestValue = value;
+            best = i;
+        }
+    }
+
+    // Refine on the input: the largest deviation from the level at the start
+    // of the window, which picks the R wave over a deep S wave in either polarity
+    const double baseline = m_inputHistory[first & HISTORY_MASK];
+    const std::uint64_t refineFirst = best >= m_filterDelay ? best - m_filterDelay : 0;
+    const std::uint64_t refineLast = std::min(best + m_filterDelay, m_sampleIndex - 1);
+    double bestDeviation = -1.0;
+    for (std::uint64_t i = refineFirst; i <= refineLast; ++i) {
+        double deviation = std::abs(m_inputHistory[i & HISTORY_MASK] - baseline);
+        if (deviation > bestDeviation) {
+            bestDeviation = deviation;
+            peak.rIndex = i;
+        }
+    }
+    peak.amplitude = m_inputHistory[peak.rIndex & HISTORY_MASK];
+}
+
+QrsDetector::Biquad QrsDetector::lowPass(double cutoff, double sampleRate)
+{
+    const double w0 = 2.0 * PI * cutoff / sampleRate;
+    const double cosW0 = std::cos(w0);
+    const double alpha = std::sin(w0) / (2.0 * BUTTERWORTH_Q);
+    const double a0 = 1.0 + alpha;
+
+    Biquad filter;
+    filter.b0 = (1.0 - cosW0) / 2.0 / a0;
+    filter.b1 = (1.0 - cosW0) / a0;
+    filter.b2 = filter.b0;
+    filter.a1 = -2.0 * cosW0 / a0;
+    filter.a2 = (1.0 - alpha) / a0;
+    return filter;
+}
+
+QrsDetector::Biquad QrsDetector::highPass(double cutoff, double sampleRate)
+{
+    const double w0 = 2.0 * PI * cutoff / sampleRate;
+    const double cosW0 = std::cos(w0);
+    const double alpha = std::sin(w0) / (2.0 * BUTTERWORTH_Q);
+    const double a0 = 1.0 + alpha;
+
+    Biquad filter;
+    filter.b0 = (1.0 + cosW0) / 2.0 / a0;
+    filter.b1 = -(1.0 + cosW0) / a0;
+    filter.b2 = filter.b0;
+    filter.a1 = -2.0 * cosW0 / a0;
+    filter.a2 = (1.0 - alpha) / a0;
+    return filter;
+}
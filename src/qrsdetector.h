@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Streaming Pan-Tompkins QRS detector.
+//
+// Each sample goes through a 5-15 Hz band-pass (two biquads), a five-point
+// derivative, squaring and a 150 ms moving-window integrator. Peaks of the
+// integrated signal are classified against adaptive signal/noise thresholds,
+// with T-wave rejection and search-back for missed beats. All state lives in
+// fixed-size circular buffers: the per-sample cost is O(1) and nothing is
+// allocated after construction.
+class QrsDetector
+{
+public:
+    struct Beat {
+        std::uint64_t sampleIndex = 0; // Absolute index of the R peak
+        double amplitude = 0.0;        // Input value at the R peak
+        double peakValue = 0.0;        // Integrated-signal peak
+        double threshold = 0.0;        // Threshold the peak was accepted against
+        bool searchBack = false;       // Found by search-back (lower confidence)
+    };
+
+    explicit QrsDetector(double sampleRate = 250.0);
+
+    void reset(double sampleRate);
+    double sampleRate() const { return m_sampleRate; }
+    std::uint64_t sampleCount() const { return m_sampleIndex; }
+
+    // Feeds one sample. Returns true when a beat has been confirmed; the beat
+    // (which lies up to ~0.3 s in the past) is then available from lastBeat().
+    bool process(double sample);
+    const Beat &lastBeat() const { return m_lastBeat; }
+
+    // Feeds a block. Writes up to maxBeats confirmed beats, returns the count.
+    std::size_t processBlock(const double *samples, std::size_t count, Beat *beats, std::size_t maxBeats);
+
+    static constexpr std::size_t MAX_WINDOW = 1024; // History length, supports up to ~4 kHz
+
+private:
+    static constexpr std::size_t HISTORY_MASK = MAX_WINDOW - 1;
+    static constexpr std::size_t RR_HISTORY = 8;         // RR intervals averaged for search-back
+    static constexpr double MWI_WINDOW_SECONDS = 0.150;
+    static constexpr double REFRACTORY_SECONDS = 0.200;  // No second QRS within this
+    static constexpr double T_WAVE_SECONDS = 0.360;      // Slope check below this
+    static constexpr double LEARNING_SECONDS = 2.0;
+    static constexpr double SEARCH_BACK_FACTOR = 1.66;   // Of the average RR interval
+
+    struct Biquad {
+        double b0 = 0, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+        double z1 = 0, z2 = 0;
+        double process(double x)
+        {
+            double y = b0 * x + z1;
+            z1 = b1 * x - a1 * y + z2;
+            z2 = b2 * x - a2 * y;
+            return y;
+        }
+    };
+
+    struct Peak {
+        std::uint64_t index = 0;  // Integrated-signal peak
+        double value = 0.0;
+        double slope = 0.0;       // Steepest derivative on the way up
+        std::uint64_t rIndex = 0; // Located R peak
+        double amplitude = 0.0;
+    };
+
+    static Biquad lowPass(double cutoff, double sampleRate);
+    static Biquad highPass(double cutoff, double sampleRate);
+
+    bool classifyPeak(Peak &peak);
+    void acceptBeat(const Peak &peak, double threshold, bool searchBack);
+    void updateThresholds();
+    void locateRPeak(Peak &peak) const;
+
+    double m_sampleRate = 250.0;
+    std::uint64_t m_sampleIndex = 0;
+
+    // Filter chain
+    Biquad m_highPass;
+    Biquad m_lowPass;
+    std::array<double, 4> m_derivativeHistory{};
+    double m_derivativeGain = 0.0;
+    std::array<double, MAX_WINDOW> m_mwiWindow{};
+    std::size_t m_mwiLength = 0;
+    std::size_t m_mwiPosition = 0;
+    double m_mwiSum = 0.0;
+
+    // Recent input and band-passed values for locating the R peak
+    std::array<double, MAX_WINDOW> m_inputHistory{};
+    std::array<double, MAX_WINDOW> m_filteredHistory{};
+    std::size_t m_rSearchLength = 0;
+
+    // Integrated-signal peak picking
+    double m_previousMwi = 0.0;
+    bool m_rising = false;
+    double m_maxSlope = 0.0;
+
+    // Learning phase (first two seconds)
+    double m_learningMax = 0.0;
+    double m_learningSum = 0.0;
+    bool m_learning = true;
+
+    // Adaptive thresholds
+    double m_signalLevel = 0.0; // SPKI
+    double m_noiseLevel = 0.0;  // NPKI
+    double m_threshold1 = 0.0;
+    double m_threshold2 = 0.0;
+
+    // Beat history
+    Peak m_lastQrs;
+    bool m_haveQrs = false;
+    Peak m_searchBackCandidate;
+    bool m_haveCandidate = false;
+    std::array<double, RR_HISTORY> m_recentRR{};
+    std::size_t m_recentRRCount = 0;
+    std::size_t m_recentRRPosition = 0;
+    double m_rrSum = 0.0;
+
+    Beat m_lastBeat;
+
+    std::size_t m_refractorySamples = 0;
+    std::size_t m_tWaveSamples = 0;
+    std::size_t m_learningLength = 0;
+    std::size_t m_filterDelay = 0;
+};
@@ -0,0 +1,76 @@
+#include "sampleclock.h"
+
+#include <algorithm>
+#include <cmath>
+
+SampleClock::SampleClock(double nominalRate)
+{
+    reset(nominalRate);
+}
+
+void SampleClock::reset(double nominalRate)
+{
+    m_nominalRate = nominalRate > 0.0 ? nominalRate : 250.0;
+    m_nominalPeriodMs = 1000.0 / m_nominalRate;
+    m_periodMs = m_nominalPeriodMs;
+
+    m_anchored = false;
+    m_anchorIndex = 0;
+    m_anchorMs = 0.0;
+
+    m_originIndex = 0;
+    m_originMs = 0.0;
+    m_lastX = 0.0;
+    m_sw = m_sx = m_sy = m_sxx = m_sxy = 0.0;
+    m_spanMs = 0.0;
+}
+
+void SampleClock::observe(std::uint64_t index, double hostMs)
+{
+    if (m_anchored && index < m_anchorIndex) {
+        reset(m_nominalRate);
+    }
+    if (!m_anchored) {
+        // The newest sample cannot be later than its arrival
+        m_anchored = true;
+        m_anchorIndex = index;
+        m_anchorMs = hostMs;
+        m_originIndex = index;
+        m_originMs = hostMs;
+    }
+
+    // Period: decay the fit by the device time since the last observation
+    const double x = double(index - m_originIndex);
+    const double y = hostMs - m_originMs;
+    const double decay = std::exp(-(x - m_lastX) * m_nominalPeriodMs / TIME_CONSTANT_MS);
+    m_sw = m_sw * decay + 1.0;
+    m_sx = m_sx * decay + x;
+    m_sy = m_sy * decay + y;
+    m_sxx = m_sxx * decay + x * x;
+    m_sxy = m_sxy * decay + x * y;
+    m_spanMs += (x - m_lastX) * m_nominalPeriodMs;
+    m_lastX = x;
+
+    const double denominator = m_sw * m_sxx - m_sx * m_sx;
+    if (m_spanMs >= MIN_FIT_SPAN_MS && denominator > 0.0) {
+        const double slope = (m_sw * m_sxy - m_sx * m_sy) / denominator;
+        m_periodMs = std::clamp(slope, m_nominalPeriodMs * (1.0 - MAX_DRIFT), m_nominalPeriodMs * (1.0 + MAX_DRIFT));
+    }
+
+    // Offset: move the anchor to this observation along the lower envelope.
+    // A drop is limited so that the sample after the old anchor still
+    // follows it by at least MIN_STEP periods: stamps never run backwards.
+    const double predicted = timeAt(index);
+    const double residual = hostMs - predicted;
+    const double elapsed = double(index - m_anchorIndex) * m_periodMs;
+    m_anchorMs = residual < 0.0
+        ? std::max(hostMs, predicted - (1.0 - MIN_STEP) * m_periodMs)
+        : predicted + std::min(residual, CREEP * elapsed);
+    m_anchorIndex = index;
+}
+
+double SampleClock::timeAt(std::uint64_t index) const
+{
+    // Signed: samples before the anchor are stamped backwards from it
+    return m_anchorMs + (double(index) - double(m_anchorIndex)) * m_periodMs;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+
+// Maps a device's sample counter to host time. A device samples on its own
+// crystal and the radio hands samples over in bursts, so the arrival time of
+// a sample says little about when it was taken. Instead, every arrival is
+// one observation "samples up to index n had been taken by host time t":
+//
+// - the sample period (the device clock's drift against the host) is the
+//   slope of an exponentially weighted least-squares fit of t on n, and
+// - the offset follows the lower envelope of the observations, since
+//   transport only ever adds delay: the mapping drops towards any arrival
+//   earlier than predicted (a little per observation, so stamps stay
+//   monotonic) and otherwise creeps up slowly, so a rising latency floor or
+//   a residual period error is still tracked.
+//
+// Sample n is then stamped anchorTime + (n - anchorIndex) * period: evenly
+// spaced at the device's true period however the samples were batched.
+class SampleClock
+{
+public:
+    explicit SampleClock(double nominalRate = 250.0);
+
+    // Forgets all observations; the next one anchors the clock
+    void reset(double nominalRate);
+    void reset() { reset(m_nominalRate); }
+
+    // All samples up to and including index arrived by hostMs (ms, any
+    // epoch). A counter that goes backwards (device restart) resets.
+    void observe(std::uint64_t index, double hostMs);
+
+    // Host time of sample index; nominal-rate extrapolation before the first
+    // observation
+    double timeAt(std::uint64_t index) const;
+
+    double samplePeriodMs() const { return m_periodMs; }
+    double nominalRate() const { return m_nominalRate; }
+    double driftPpm() const { return (m_periodMs / m_nominalPeriodMs - 1.0) * 1e6; }
+    bool isAnchored() const { return m_anchored; }
+
+    static constexpr double TIME_CONSTANT_MS = 120000.0; // Weight decays by e every 2 min of device time
+    static constexpr double MIN_FIT_SPAN_MS = 10000.0;   // Nominal period until the fit spans this
+    static constexpr double MAX_DRIFT = 0.02;            // Fitted period within +-2% of nominal
+    static constexpr double CREEP = 1e-3;                // Upward offset correction, ms per ms
+    static constexpr double MIN_STEP = 0.5;              // Periods between consecutive stamps, at least
+
+private:
+    double m_nominalRate;
+    double m_nominalPeriodMs;
+    double m_periodMs;
+
+    bool m_anchored;
+    std::uint64_t m_anchorIndex;
+    double m_anchorMs;
+
+    // Weighted sums for the fit, relative to the first observation
+    std::uint64_t m_originIndex;
+    double m_originMs;
+    double m_lastX;
+    double m_sw;
+    double m_sx;
+    double m_sy;
+    double m_sxx;
+    double m_sxy;
+    double m_spanMs;
+};
@@ -0,0 +1,201 @@
+#include "spectralhrv.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr double PI = 3.14159265358979323846;
+constexpr double LF_LOW_HZ = 0.04;
+constexpr double LF_HIGH_HZ = 0.15;
+constexpr double HF_HIGH_HZ = 0.40;
+constexpr double REBASE_SECONDS = 3600.0;        // Keep ωt small
+constexpr std::size_t REBUILD_INTERVAL = 4096;   // Updates between exact re-sums
+}
+
+SpectralHrv::SpectralHrv(double windowSeconds)
+    : m_windowSeconds(windowSeconds)
+    , m_origin(0.0)
+    , m_beats(MAX_BEATS)
+    , m_head(0)
+    , m_size(0)
+    , m_updatesSinceRebuild(0)
+    , m_ySum(0.0)
+{
+}
+
+void SpectralHrv::reset()
+{
+    m_origin = 0.0;
+    m_head = 0;
+    m_size = 0;
+    m_updatesSinceRebuild = 0;
+    m_cosSum.fill(0.0);
+    m_sinSum.fill(0.0);
+    m_yCosSum.fill(0.0);
+    m_ySinSum.fill(0.0);
+    m_cos2Sum.fill(0.0);
+    m_sin2Sum.fill(0.0);
+    m_ySum = 0.0;
+}
+
+void SpectralHrv::addBeat(double time, double rrInterval)
+{
+    if (m_size == 0) {
+        m_origin = time;
+    }
+
+    double seconds = (time - m_origin) / 1000.0;
+    if (m_size > 0 && seconds < m_beats[(m_head + m_size - 1) % MAX_BEATS].time) {
+        return; // Out of order
+    }
+
+    // Expire beats that have left the window, and make room if full
+    while (m_size > 0 && seconds - m_beats[m_head].time > m_windowSeconds) {
+        removeOldest();
+    }
+    if (m_size == MAX_BEATS) {
+        removeOldest();
+    }
+
+    m_beats[(m_head + m_size) % MAX_BEATS] = Beat{seconds, rrInterval};
+    ++m_size;
+    accumulate(seconds, rrInterval, 1.0);
+
+    // Periodically move the origin forward and re-sum exactly, which bounds
+    // both the phase magnitude and the add/remove rounding drift
+    if (seconds > REBASE_SECONDS || ++m_updatesSinceRebuild >= REBUILD_INTERVAL) {
+        rebuild();
+    }
+}
+
+void SpectralHrv::removeOldest()
+{
+    const Beat &oldest = m_beats[m_head];
+    accumulate(oldest.time, oldest.rr, -1.0);
+    m_head = (m_head + 1) % MAX_BEATS;
+    --m_size;
+    ++m_updatesSinceRebuild;
+}
+
+void SpectralHrv::accumulate(double time, double rr, double sign)
+{
+    // Seed LANES consecutive frequencies directly, then step every lane by
+    // LANES frequency bins with a single rotation
+    alignas(64) std::array<double, LANES> c;
+    alignas(64) std::array<double, LANES> s;
+    for (std::size_t lane = 0; lane < LANES; ++lane) {
+        double phase = 2.0 * PI * FREQUENCY_STEP * double(lane + 1) * time;
+        c[lane] = std::cos(phase);
+        s[lane] = std::sin(phase);
+    }
+    const double stepPhase = 2.0 * PI * FREQUENCY_STEP * double(LANES) * time;
+    const double stepCos = std::cos(stepPhase);
+    const double stepSin = std::sin(stepPhase);
+
+    const double y = sign * rr;
+    for (std::size_t base = 0; base < FREQUENCY_COUNT; base += LANES) {
+        for (std::size_t lane = 0; lane < LANES; ++lane) {
+            const std::size_t k = base + lane;
+            const double cl = c[lane];
+            const double sl = s[lane];
+            m_cosSum[k] += sign * cl;
+            m_sinSum[k] += sign * sl;
+            m_yCosSum[k] += y * cl;
+            m_ySinSum[k] += y * sl;
+            m_cos2Sum[k] += sign * (cl * cl - sl * sl);
+            m_sin2Sum[k] += sign * 2.0 * cl * sl;
+
+            c[lane] = cl * stepCos - sl * stepSin;
+            s[lane] = sl * stepCos + cl * stepSin;
+        }
+    }
+    m_ySum += y;
+}
+
+void SpectralHrv::rebuild()
+{
+    const double shift = m_size > 0 ? m_beats[m_head].time : 0.0;
+    m_origin += shift * 1000.0;
+
+    m_cosSum.fill(0.0);
+    m_sinSum.fill(0.0);
+    m_yCosSum.fill(0.0);
+    m_ySinSum.fill(0.0);
+    m_cos2Sum.fill(0.0);
+    m_sin2Sum.fill(0.0);
+    m_ySum = 0.0;
+
+    for (std::size_t i = 0; i < m_size; ++i) {
+        Beat &beat = m_beats[(m_head + i) % MAX_BEATS];
+        beat.time -= shift;
+        accumulate(beat.time, beat.rr, 1.0);
+    }
+    m_updatesSinceRebuild = 0;
+}
+
+SpectralHrvResult SpectralHrv::compute() const
+{
+    SpectralHrvResult result;
+    result.beats = m_size;
+    if (m_size == 0) {
+        return result;
+    }
+
+    const double first = m_beats[m_head].time;
+    const double last = m_beats[(m_head + m_size - 1) % MAX_BEATS].time;
+    result.spanSeconds = last - first;
+    if (m_size < MIN_BEATS || result.spanSeconds < MIN_SPAN_SECONDS) {
+        return result;
+    }
+
+    const double n = double(m_size);
+    const double mean = m_ySum / n;
+
+    // Scale so band power integrates to variance (ms²): a sinusoid of
+    // amplitude A gives a periodogram peak of N·A²/4 over a ~1/T wide lobe
+    const double scale = 2.0 * result.spanSeconds / n * FREQUENCY_STEP;
+
+    for (std::size_t k = 0; k < FREQUENCY_COUNT; ++k) {
+        // Lomb-Scargle time offset τ from tan 2ωτ = Σ sin 2ωt / Σ cos 2ωt
+        const double c2 = m_cos2Sum[k];
+        const double s2 = m_sin2Sum[k];
+        const double r = std::hypot(c2, s2);
+        double cos2Tau = 1.0;
+        double sin2Tau = 0.0;
+        if (r > 0.0) {
+            cos2Tau = c2 / r;
+            sin2Tau = s2 / r;
+        }
+        const double cosTau = std::sqrt(std::max(0.0, 0.5 * (1.0 + cos2Tau)));
+        const double sinTau = std::copysign(std::sqrt(std::max(0.0, 0.5 * (1.0 - cos2Tau))), sin2Tau);
+
+        // Mean-removed projections onto cos/sin ω(t - τ)
+        const double yc = m_yCosSum[k] - mean * m_cosSum[k];
+        const double ys = m_ySinSum[k] - mean * m_sinSum[k];
+        const double a = yc * cosTau + ys * sinTau;
+        const double b = ys * cosTau - yc * sinTau;
+        const double cosSquares = 0.5 * (n + r);
+        const double sinSquares = 0.5 * (n - r);
+
+        double power = 0.0;
+        if (cosSquares > 1e-9) {
+            power += a * a / cosSquares;
+        }
+        if (sinSquares > 1e-9) {
+            power += b * b / sinSquares;
+        }
+        power *= 0.5 * scale;
+
+        const double frequency = FREQUENCY_STEP * double(k + 1);
+        if (frequency >= LF_LOW_HZ && frequency < LF_HIGH_HZ) {
+            result.lfPower += power;
+        } else if (frequency >= LF_HIGH_HZ && frequency <= HF_HIGH_HZ) {
+            result.hfPower += power;
+        }
+        result.totalPower += power;
+    }
+
+    result.lfHfRatio = result.hfPower > 0.0 ? result.lfPower / result.hfPower : 0.0;
+    result.valid = true;
+    return result;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// Frequency-domain HRV (LF, HF, LF/HF) from the unevenly sampled RR series
+// using the Lomb-Scargle periodogram over a sliding window.
+//
+// The periodogram only needs six sums per frequency (y·cos, y·sin, cos,
+// sin, cos 2ωt, sin 2ωt), so a beat entering or leaving the window updates
+// them in O(frequencies) and reading the spectrum is O(frequencies) too;
+// the window is never rescanned. The per-frequency trigonometry uses a
+// rotation recurrence across LANES interleaved frequencies, which keeps the
+// inner loops free of sin/cos calls and lets the compiler vectorise them.
+struct SpectralHrvResult {
+    bool valid = false;
+    std::size_t beats = 0;
+    double spanSeconds = 0.0;
+    double lfPower = 0.0;  // ms², 0.04-0.15 Hz
+    double hfPower = 0.0;  // ms², 0.15-0.40 Hz
+    double lfHfRatio = 0.0;
+    double totalPower = 0.0; // ms², up to 0.40 Hz
+};
+
+class SpectralHrv
+{
+public:
+    explicit SpectralHrv(double windowSeconds = 300.0);
+
+    // time in ms, rrInterval (an NN interval ending at time) in ms
+    void addBeat(double time, double rrInterval);
+    void reset();
+
+    SpectralHrvResult compute() const;
+    std::size_t beatCount() const { return m_size; }
+
+    static constexpr std::size_t LANES = 8;
+    static constexpr std::size_t FREQUENCY_COUNT = 160;  // 0.0025 Hz resolution up to 0.4 Hz
+    static constexpr double FREQUENCY_STEP = 0.4 / FREQUENCY_COUNT;
+    static constexpr std::size_t MAX_BEATS = 2048;       // 5 min at up to ~400 bpm
+    static constexpr std::size_t MIN_BEATS = 32;
+    static constexpr double MIN_SPAN_SECONDS = 60.0;     // Shorter series cannot resolve LF
+
+    static_assert(FREQUENCY_COUNT % LANES == 0, "Frequencies are processed in whole lane groups");
+
+private:
+    struct Beat {
+        double time; // s since m_origin
+        double rr;   // ms
+    };
+
+    void accumulate(double time, double rr, double sign);
+    void removeOldest();
+    void rebuild();
+
+    double m_windowSeconds;
+    double m_origin; // ms; times are kept relative to it for precision
+
+    std::vector<Beat> m_beats; // Ring of MAX_BEATS, allocated once
+    std::size_t m_head;        // Index of the oldest beat
+    std::size_t m_size;
+    std::size_t m_updatesSinceRebuild;
+
+    // Per-frequency running sums (structure of arrays)
+    std::array<double, FREQUENCY_COUNT> m_cosSum{};
+    std::array<double, FREQUENCY_COUNT> m_sinSum{};
+    std::array<double, FREQUENCY_COUNT> m_yCosSum{};
+    std::array<double, FREQUENCY_COUNT> m_ySinSum{};
+    std::array<double, FREQUENCY_COUNT> m_cos2Sum{};
+    std::array<double, FREQUENCY_COUNT> m_sin2Sum{};
+    double m_ySum;
+};
@@ -0,0 +1,42 @@
+#include "spectralhrvworker.h"
+
+#include <QTimer>
+
+SpectralHrvWorker::SpectralHrvWorker(QObject *parent)
+    : QObject(parent)
+    , m_updateTimer(nullptr)
+    , m_dirty(false)
+{
+    qRegisterMetaType<SpectralHrvResult>("SpectralHrvResult");
+}
+
+void SpectralHrvWorker::start()
+{
+    // Created here so the timer lives on the worker thread
+    m_updateTimer = new QTimer(this);
+    m_updateTimer->setInterval(UPDATE_INTERVAL_MS);
+    connect(m_updateTimer, &QTimer::timeout, this, &SpectralHrvWorker::update);
+    m_updateTimer->start();
+}
+
+void SpectralHrvWorker::addInterval(double time, double rrInterval)
+{
+    m_spectrum.addBeat(time, rrInterval);
+    m_dirty = true;
+}
+
+void SpectralHrvWorker::reset()
+{
+    m_spectrum.reset();
+    m_dirty = false;
+    emit spectrumUpdated(SpectralHrvResult());
+}
+
+void SpectralHrvWorker::update()
+{
+    if (!m_dirty) {
+        return;
+    }
+    m_dirty = false;
+    emit spectrumUpdated(m_spectrum.compute());
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QObject>
+#include <QMetaType>
+
+#include "spectralhrv.h"
+
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+Q_DECLARE_METATYPE(SpectralHrvResult)
+
+// Runs the spectral HRV engine off the GUI thread. Intervals are folded into
+// the running sums as they arrive; the spectrum is re-read on a timer and
+// only when new beats came in since the last update.
+class SpectralHrvWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SpectralHrvWorker(QObject *parent = nullptr);
+
+public slots:
+    void start();
+    void addInterval(double time, double rrInterval);
+    void reset();
+
+signals:
+    void spectrumUpdated(const SpectralHrvResult &result);
+
+private slots:
+    void update();
+
+private:
+    SpectralHrv m_spectrum;
+    QTimer *m_updateTimer;
+    bool m_dirty;
+
+    static constexpr int UPDATE_INTERVAL_MS = 2000;
+};
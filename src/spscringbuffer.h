@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-capacity, lock-free single-producer/single-consumer ring buffer.
+// push() must only be called from one thread and pop() from one other thread.
+// Capacity must be a power of two. Samples that do not fit are dropped and
+// counted; the producer also tracks the highest fill level seen so rings can
+// be sized for a device.
+template <typename T, std::size_t Capacity>
+class SpscRingBuffer
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    // Producer side
+    bool push(const T &item)
+    {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_cachedTail == Capacity) {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (head - m_cachedTail == Capacity) {
+                m_overflowCount.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+
+        m_items[head & MASK] = item;
+        m_head.store(head + 1, std::memory_order_release);
+        updateHighWaterMark(head + 1);
+        return true;
+    }
+
+    // Pushes a block with a single index publish. Items that do not fit are
+    // dropped and counted; returns how many were queued.
+    std::size_t push(const T *items, std::size_t count)
+    {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        std::size_t space = Capacity - (head - m_cachedTail);
+        if (space < count) {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            space = Capacity - (head - m_cachedTail);
+        }
+
+        const std::size_t accepted = count < space ? count : space;
+        for (std::size_t i = 0; i < accepted; ++i) {
+            m_items[(head + i) & MASK] = items[i];
+        }
+        m_head.store(head + accepted, std::memory_order_release);
+        if (accepted < count) {
+            m_overflowCount.fetch_add(count - accepted, std::memory_order_relaxed);
+        }
+        updateHighWaterMark(head + accepted);
+        return accepted;
+    }
+
+    // Producer side: free slots, possibly an underestimate
+    std::size_t freeSpace()
+    {
+        m_cachedTail = m_tail.load(std::memory_order_acquire);
+        return Capacity - (m_head.load(std::memory_order_relaxed) - m_cachedTail);
+    }
+
+    // Consumer side: copies up to maxCount items into out, returns the count
+    std::size_t pop(T *out, std::size_t maxCount)
+    {
+        const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        std::size_t available = m_cachedHead - tail;
+        if (available < maxCount) {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            available = m_cachedHead - tail;
+        }
+
+        const std::size_t count = available < maxCount ? available : maxCount;
+        for (std::size_t i = 0; i < count; ++i) {
+            out[i] = m_items[(tail + i) & MASK];
+        }
+        m_tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // Wake-up handshake: the producer calls requestWakeup() after pushing and
+    // notifies the consumer only when it returns true; the consumer calls
+    // acknowledgeWakeup() before draining. At most one notification is in
+    // flight at a time regardless of the sample rate.
+    // Both sides use read-modify-write so an acknowledge that clears a
+    // request also makes the samples pushed before it visible.
+    bool requestWakeup() { return !m_wakeupPending.exchange(true, std::memory_order_acq_rel); }
+    void acknowledgeWakeup() { m_wakeupPending.exchange(false, std::memory_order_acq_rel); }
+
+    // Statistics, readable from any thread
+    static constexpr std::size_t capacity() { return Capacity; }
+    std::size_t size() const
+    {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+    }
+    std::size_t highWaterMark() const { return m_highWaterMark.load(std::memory_order_relaxed); }
+    std::uint64_t overflowCount() const { return m_overflowCount.load(std::memory_order_relaxed); }
+    void resetStatistics()
+    {
+        m_highWaterMark.store(0, std::memory_order_relaxed);
+        m_overflowCount.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    // The cached tail is only refreshed when the ring looks full, so the
+    // fill measured against it overstates while the consumer keeps up.
+    // A candidate maximum is checked against the real tail, which also
+    // refreshes the cache, so the extra load is rare once the mark settles.
+    void updateHighWaterMark(std::size_t head)
+    {
+        const std::size_t highWaterMark = m_highWaterMark.load(std::memory_order_relaxed);
+        if (head - m_cachedTail <= highWaterMark) {
+            return;
+        }
+        m_cachedTail = m_tail.load(std::memory_order_acquire);
+        const std::size_t fill = head - m_cachedTail;
+        if (fill > highWaterMark) {
+            m_highWaterMark.store(fill, std::memory_order_relaxed);
+        }
+    }
+
+    static constexpr std::size_t MASK = Capacity - 1;
+    static constexpr std::size_t CACHE_LINE = 64;
+
+    // Producer and consumer indices live on separate cache lines
+    alignas(CACHE_LINE) std::atomic<std::size_t> m_head{0};
+    std::size_t m_cachedTail = 0;
+    std::atomic<std::size_t> m_highWaterMark{0};
+    std::atomic<std::uint64_t> m_overflowCount{0};
+
+    alignas(CACHE_LINE) std::atomic<std::size_t> m_tail{0};
+    std::size_t m_cachedHead = 0;
+
+    alignas(CACHE_LINE) std::atomic<bool> m_wakeupPending{false};
+
+    alignas(CACHE_LINE) std::array<T, Capacity> m_items{};
+};